@@ -0,0 +1,40 @@
+#!/bin/sh
+# Time to first frame of a synthetic dialog, from the "first paint" instant
+# of --trace (microseconds since start). The default 5000 rows make a form
+# of 5,000 inputs, a 5,000-row list and a tree:
+#   bench/first_frame.sh <tanto> <tanto_bench> [qt|gtk] [rows] [runs]
+# Qt runs on the offscreen platform, GTK under xvfb-run.
+set -eu
+
+tanto=$1
+bench=$2
+backend=${3:-qt}
+rows=${4:-5000}
+runs=${5:-5}
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT INT TERM
+
+"$bench" --rows="$rows" --dump > "$dir/dialog.json"
+
+case $backend in
+    qt) export QT_QPA_PLATFORM=offscreen; wrap="" ;;
+    gtk) wrap="xvfb-run -a" ;;
+    *) echo "Unknown backend: $backend" >&2; exit 1 ;;
+esac
+
+i=0
+while [ "$i" -lt "$runs" ]; do
+    # The window is closed by an update once it had time to paint
+    { cat "$dir/dialog.json"; sleep 5; echo '{"close": true}'; } |
+        $wrap "$tanto" stdin --backend="$backend" \
+            --trace="$dir/trace.json" > /dev/null
+
+    python3 - "$dir/trace.json" <<'PY'
+import json, sys
+events = json.load(open(sys.argv[1]))["traceEvents"]
+ts = [e["ts"] for e in events if e.get("name") == "first paint"]
+print(f"first paint: {ts[0] / 1000:.1f} ms" if ts else "first paint: none")
+PY
+    i=$((i + 1))
+done
@@ -0,0 +1,315 @@
+#include "../src/events.h"
+#include "../src/tanto.h"
+#include "../src/types.h"
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <functional>
+#include <new>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Microbenchmarks of the non-GUI paths over synthetic dialogs:
+//   tanto_bench [--rows=N] [--depth=D] [--columns=K] [--time=MS] [--json]
+// --dump prints the dialog instead, for first_frame.sh
+
+namespace {
+
+std::atomic<size_t> g_allocs{0}, g_bytes{0};
+volatile size_t g_sink = 0; // Keeps results alive
+
+struct Params {
+    int rows{100}, depth{4}, columns{4}, time{200};
+    bool json{false}, dump{false};
+};
+
+struct Result {
+    std::string name;
+    size_t iterations;
+    double ns, allocs, bytes; // Per operation
+};
+
+class BenchEvents: public Events {
+public:
+    explicit BenchEvents(const tanto::types::Widget& body) {
+        this->set_event_handler([](const std::string& e) { g_sink += e.size(); });
+        this->add_model(body);
+    }
+
+    inline void set_model(bool b) { m_windows[{}].ismodel = b; }
+    void exit() override {}
+    void close(const std::string& /* window */) override {}
+
+    nlohmann::json get_model_data(const tanto::types::Widget& arg,
+                                  const std::any& /* w */) override {
+        if(arg.type == "list")
+            return arg.items.size();
+        return arg.text;
+    }
+
+private:
+    void add_model(const tanto::types::Widget& w) {
+        if(w.has_id())
+            m_windows[w.window].model[w.id] = {w, {}};
+
+        for(const tanto::types::MultiValue& item : w.items) {
+            if(const auto* c = std::get_if<tanto::types::Widget>(&item); c)
+                this->add_model(*c);
+        }
+    }
+};
+
+[[nodiscard]] nlohmann::json make_tree(int depth, int& n) {
+    nlohmann::json node = {{"text", fmt::format("node{}", n++)}};
+    if(depth > 1)
+        node["items"] = {make_tree(depth - 1, n), make_tree(depth - 1, n)};
+    return node;
+}
+
+// A form with one input per row, a list of 'rows' x 'columns' and a binary
+// tree 'depth' levels deep
+[[nodiscard]] nlohmann::json make_dialog(const Params& p) {
+    nlohmann::json header = nlohmann::json::array();
+    nlohmann::json rows = nlohmann::json::array();
+    nlohmann::json form = nlohmann::json::array();
+    int n = 0;
+
+    for(int c = 0; c < p.columns; c++)
+        header.push_back({{"id", fmt::format("col{}", c)},
+                          {"text", fmt::format("Column {}", c)}});
+
+    for(int r = 0; r < p.rows; r++) {
+        nlohmann::json row = {{"id", fmt::format("row{}", r)}};
+        for(int c = 0; c < p.columns; c++)
+            row[fmt::format("col{}", c)] = fmt::format("cell {}x{}", r, c);
+        rows.push_back(row);
+
+        form.push_back({{"id", fmt::format("input{}", r)},
+                        {"type", "input"},
+                        {"label", fmt::format("Input {}", r)},
+                        {"text", "value"}});
+    }
+
+    return {
+        {"type", "window"},
+        {"title", "Benchmark"},
+        {"font", "'DejaVu Sans' 12"},
+        {"body",
+         {{"type", "column"},
+          {"items",
+           {{{"type", "form"}, {"items", form}},
+            {{"id", "list"}, {"type", "list"}, {"header", header}, {"items", rows}},
+            {{"id", "tree"},
+             {"type", "tree"},
+             {"items", {make_tree(p.depth, n)}}}}}}},
+    };
+}
+
+[[nodiscard]] int parse_int(std::string_view arg, int fallback) {
+    int v = fallback;
+    std::from_chars(arg.data(), arg.data() + arg.size(), v);
+    return v;
+}
+
+[[nodiscard]] Params parse_args(int argc, char** argv) {
+    Params p;
+
+    for(int i = 1; i < argc; i++) {
+        std::string_view a = argv[i];
+        std::string_view v = a.substr(std::min(a.find('=') + 1, a.size()));
+
+        if(a.rfind("--rows=", 0) == 0)
+            p.rows = parse_int(v, p.rows);
+        else if(a.rfind("--depth=", 0) == 0)
+            p.depth = parse_int(v, p.depth);
+        else if(a.rfind("--columns=", 0) == 0)
+            p.columns = parse_int(v, p.columns);
+        else if(a.rfind("--time=", 0) == 0)
+            p.time = parse_int(v, p.time);
+        else if(a == "--json")
+            p.json = true;
+        else if(a == "--dump")
+            p.dump = true;
+        else {
+            std::fprintf(stderr,
+                         "Usage: tanto_bench [--rows=N] [--depth=D] "
+                         "[--columns=K] [--time=MS] [--json] [--dump]\n");
+            std::exit(1);
+        }
+    }
+
+    return p;
+}
+
+template<typename Function>
+Result run(const Params& p, std::string name, Function f) {
+    using Clock = std::chrono::steady_clock;
+
+    f(); // Warm up caches and lazy statics
+
+    size_t iterations = 0, batch = 1;
+    size_t allocs = g_allocs, bytes = g_bytes;
+    auto budget = std::chrono::milliseconds{p.time};
+    auto start = Clock::now();
+    Clock::duration elapsed{};
+
+    while(elapsed < budget) {
+        for(size_t i = 0; i < batch; i++)
+            f();
+
+        iterations += batch;
+        batch *= 2; // Keep clock reads out of short operations
+        elapsed = Clock::now() - start;
+    }
+
+    auto n = static_cast<double>(iterations);
+
+    return Result{
+        std::move(name),
+        iterations,
+        std::chrono::duration<double, std::nano>(elapsed).count() / n,
+        static_cast<double>(g_allocs - allocs) / n,
+        static_cast<double>(g_bytes - bytes) / n,
+    };
+}
+
+void report(const Params& p, const std::vector<Result>& results) {
+    if(p.json) {
+        nlohmann::json res = nlohmann::json::array();
+
+        for(const Result& r : results) {
+            res.push_back({{"name", r.name},
+                           {"iterations", r.iterations},
+                           {"ns_per_op", r.ns},
+                           {"allocs_per_op", r.allocs},
+                           {"bytes_per_op", r.bytes}});
+        }
+
+        nlohmann::json out = {
+            {"params",
+             {{"rows", p.rows}, {"depth", p.depth}, {"columns", p.columns}}},
+            {"results", res},
+        };
+
+        std::puts(out.dump(2).c_str());
+        return;
+    }
+
+    std::puts(fmt::format("rows={} depth={} columns={}", p.rows, p.depth,
+                          p.columns)
+                  .c_str());
+
+    std::puts(fmt::format("{:<28}{:>14}{:>14}{:>14}", "benchmark", "ns/op",
+                          "allocs/op", "bytes/op")
+                  .c_str());
+
+    for(const Result& r : results) {
+        std::puts(fmt::format("{:<28}{:>14.1f}{:>14.1f}{:>14.1f}", r.name, r.ns,
+                              r.allocs, r.bytes)
+                      .c_str());
+    }
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if(void* p = std::malloc(size ? size : 1); p)
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) { return ::operator new(size); }
+
+// GCC pairs malloc() with the replaced operator new and warns on free()
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+int main(int argc, char** argv) {
+    Params p = parse_args(argc, argv);
+    nlohmann::json dialog = make_dialog(p);
+    std::string text = dialog.dump();
+
+    if(p.dump) {
+        std::puts(text.c_str());
+        return 0;
+    }
+
+    tanto::types::Window window = *tanto::parse(dialog);
+    const auto& list =
+        std::get<tanto::types::Widget>(window.body.items.at(1));
+    const auto& row = std::get<tanto::types::Widget>(list.items.at(0));
+
+    BenchEvents events{window.body};
+    std::vector<Result> results;
+
+    results.push_back(run(p, "json_parse", [&]() {
+        g_sink += nlohmann::json::parse(text).size();
+    }));
+
+    results.push_back(run(p, "tanto_parse", [&]() {
+        g_sink += tanto::parse(dialog)->body.items.size();
+    }));
+
+    results.push_back(run(p, "to_json", [&]() {
+        nlohmann::json j = window.body;
+        g_sink += j.size();
+    }));
+
+    results.push_back(run(p, "from_json_list", [&]() {
+        auto w = dialog["body"]["items"][1].get<tanto::types::Widget>();
+        g_sink += w.items.size();
+    }));
+
+    std::vector<std::string> keys; // Formatting them isn't measured
+    for(int c = 0; c < p.columns; c++)
+        keys.push_back(fmt::format("col{}", c));
+
+    results.push_back(run(p, "widget_prop", [&]() {
+        for(const std::string& k : keys)
+            g_sink += row.prop<std::string>(k).size();
+    }));
+
+    results.push_back(run(p, "parse_header", [&]() {
+        g_sink += tanto::parse_header(list).size();
+    }));
+
+    results.push_back(run(p, "parse_filter", [&]() {
+        g_sink += tanto::parse_filter("Images | png; jpg; gif | All | *").size();
+    }));
+
+    results.push_back(run(p, "parse_font", [&]() {
+        g_sink += tanto::parse_font(window.font)->second;
+    }));
+
+    results.push_back(run(p, "stringify", [&]() {
+        for(const auto& [k, v] : row.properties)
+            g_sink += tanto::stringify(v).size();
+    }));
+
+    results.push_back(run(p, "create_event", [&]() {
+        events.changed(list, {{"index", 1}, {"id", "row1"}});
+    }));
+
+    events.set_model(true);
+
+    results.push_back(run(p, "create_event_model", [&]() {
+        events.clicked(list);
+    }));
+
+    report(p, results);
+    return 0;
+}
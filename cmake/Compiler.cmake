@@ -1,15 +1,18 @@
-if(CMAKE_CXX_COMPILER_ID STREQUAL "Clang" OR CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
-    include(cmake/compiler/GNU.cmake)
+# Flags of our own targets only, libtanto's consumers don't inherit them
+function(setup_compiler projectname)
+    if(CMAKE_CXX_COMPILER_ID STREQUAL "Clang" OR CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+        include(cmake/compiler/GNU.cmake)
 
-    if(CMAKE_BUILD_TYPE STREQUAL "Debug")
-        include(cmake/sanitizer/GNU.cmake)
-    endif()
-elseif(CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
-    include(cmake/compiler/MSVC.cmake)
+        if(CMAKE_BUILD_TYPE STREQUAL "Debug")
+            include(cmake/sanitizer/GNU.cmake)
+        endif()
+    elseif(CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
+        include(cmake/compiler/MSVC.cmake)
 
-    if(CMAKE_BUILD_TYPE STREQUAL "Debug")
-        include(cmake/sanitizer/MSVC.cmake)
+        if(CMAKE_BUILD_TYPE STREQUAL "Debug")
+            include(cmake/sanitizer/MSVC.cmake)
+        endif()
+    else()
+        message(FATAL_ERROR "Unsupported compiler flags: '${CMAKE_CXX_COMPILER_ID}'")
     endif()
-else()
-    message(FATAL_ERROR "Unsupported compiler flags: '${CMAKE_CXX_COMPILER_ID}'")
-endif()
+endfunction()
@@ -1,5 +1,5 @@
-target_compile_options(${PROJECT_NAME}
-    PUBLIC
+target_compile_options(${projectname}
+    PRIVATE
         "-Wall"                     # essential
         "-Wextra"                   # essential
         "-Werror"                   # essential
@@ -37,7 +37,7 @@ target_compile_options(${PROJECT_NAME}
         "-Wno-error=unused-but-set-variable"
 )
 
-target_link_options(${PROJECT_NAME}
-    PUBLIC
+target_link_options(${projectname}
+    PRIVATE
         "-fno-rtti"
 )
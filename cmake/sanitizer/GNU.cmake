@@ -1,11 +1,11 @@
-target_compile_options(${PROJECT_NAME}
-    PUBLIC
+target_compile_options(${projectname}
+    PRIVATE
         "-fsanitize=address,undefined"  # sanitizers
         "-fno-omit-frame-pointer"       # address sanitizer flags
 )
 
-target_link_options(${PROJECT_NAME}
-    PUBLIC
+target_link_options(${projectname}
+    PRIVATE
         "-fsanitize=address,undefined"
         "-fno-omit-frame-pointer"
 )
@@ -0,0 +1,73 @@
+#ifndef TANTO_H
+#define TANTO_H
+
+/*
+ * C API of libtanto: dialogs run in-process, without spawning 'tanto'.
+ *
+ *   tanto_backend* b = tanto_backend_new(NULL);
+ *   tanto_show_json(b, "{\"type\": \"window\", ...}", on_event, NULL);
+ *   tanto_backend_free(b);
+ *
+ * A backend is created once and reused for every dialog; Qt allows only one
+ * per process. tanto_show_*() blocks until the dialog is closed, events are
+ * delivered as JSON strings (same as 'tanto' stdout) to the callback.
+ */
+
+#if defined(_WIN32) && defined(TANTO_SHARED)
+    #if defined(TANTO_BUILDING)
+        #define TANTO_API __declspec(dllexport)
+    #else
+        #define TANTO_API __declspec(dllimport)
+    #endif
+#elif defined(__GNUC__)
+    #define TANTO_API __attribute__((visibility("default")))
+#else
+    #define TANTO_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tanto_backend tanto_backend;
+typedef struct tanto_node tanto_node;
+
+/* 'event' is only valid during the call */
+typedef void (*tanto_event_callback)(const char* event, void* userdata);
+
+/* NULL picks $TANTO_BACKEND or the first available one */
+TANTO_API tanto_backend* tanto_backend_new(const char* name);
+TANTO_API void tanto_backend_free(tanto_backend* backend);
+TANTO_API const char* tanto_backend_name(const tanto_backend* backend);
+
+/*
+ * 'json' is a window or an array of windows (events carry their "window").
+ * Return -1 if the request is invalid or fails (the error is logged), the
+ * backend's exit code otherwise.
+ */
+TANTO_API int tanto_show_json(tanto_backend* backend, const char* json,
+                              tanto_event_callback cb, void* userdata);
+TANTO_API int tanto_show_node(tanto_backend* backend, const tanto_node* window,
+                              tanto_event_callback cb, void* userdata);
+
+/*
+ * Pre-built trees, they skip writing and parsing JSON text: keys are the
+ * same of the JSON format. Appending to a "window" node sets its body, appending
+ * to a widget adds an item: the child is copied and can be freed.
+ */
+TANTO_API tanto_node* tanto_node_new(const char* type);
+TANTO_API void tanto_node_free(tanto_node* node);
+TANTO_API void tanto_node_set_string(tanto_node* node, const char* key,
+                                     const char* value);
+TANTO_API void tanto_node_set_int(tanto_node* node, const char* key,
+                                  int value);
+TANTO_API void tanto_node_set_bool(tanto_node* node, const char* key,
+                                   int value);
+TANTO_API void tanto_node_append(tanto_node* node, const tanto_node* child);
+TANTO_API void tanto_node_append_string(tanto_node* node, const char* item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TANTO_H */
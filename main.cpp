@@ -1,24 +1,26 @@
 #include "src/backend.h"
+#include "src/backends.h"
 #include "src/error.h"
+#include "src/picker.h"
+#include "src/progress.h"
 #include "src/tanto.h"
+#include "src/trace.h"
 #include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <cl/cl.h>
+#include <cstdio>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <thread>
 #include <vector>
 
-#if defined(BACKEND_QT)
-    #include "src/backends/qt/backendimpl.h"
-#endif
-
-#if defined(BACKEND_GTK)
-    #include "src/backends/gtk/backendimpl.h"
-#endif
-
 #if !defined(NDEBUG)
 extern "C" const char* __lsan_default_options() { // NOLINT
     return "suppressions=leak.supp:print_suppressions=0";
@@ -27,54 +29,81 @@ extern "C" const char* __lsan_default_options() { // NOLINT
 
 namespace {
 
-const std::vector<std::pair<std::string_view, std::string_view>> BACKENDS {
-#if defined(BACKEND_GTK)
-    {"gtk", BackendGtkImpl::version()},
-#endif
-#if defined(BACKEND_QT)
-        {"qt", BackendQtImpl::version()},
-#endif
-};
-
-std::string selectedbackend;
-
-using BackendPtr = std::unique_ptr<Backend>;
-
-[[nodiscard]] BackendPtr new_backend(const std::string& name, int argc,
-                                     char** argv) {
-#if defined(BACKEND_GTK)
-    if(name == "gtk")
-        return std::make_unique<BackendGtkImpl>(argc, argv);
-#endif // defined(BACKEND_GTK)
-
-#if defined(BACKEND_QT)
-    if(name == "qt")
-        return std::make_unique<BackendQtImpl>(argc, argv);
-#endif // defined(BACKEND_QT)
-
-    except("Backend '{}' not found", name);
-}
-
-bool has_backend(std::string_view n) {
-    return std::find_if(BACKENDS.begin(), BACKENDS.end(), [n](const auto& x) {
-               return x.first == n;
-           }) != BACKENDS.end();
-}
+using BackendPtr = tanto::BackendPtr;
 
 tanto::FilterList parse_filter(const cl::Arg& arg) {
     return tanto::parse_filter(arg ? arg.to_stringview() : std::string_view{});
 }
 
-std::string read_stdin() {
-    std::string input, line;
-
-    while(std::getline(std::cin, line)) {
-        if(!input.empty())
-            input += "\n";
-        input += line;
+// The bytes of the first JSON value only, what follows is read by
+// read_updates(). Brackets are matched outside of strings, a top level
+// scalar ends at the first whitespace.
+std::string read_first_value() {
+    tanto::trace::Span span{"read stdin", "io"};
+    std::streambuf* buf = std::cin.rdbuf();
+    std::string s;
+    int depth = 0;
+    bool instring = false, escaped = false;
+
+    for(int c = buf->sgetc(); c != std::char_traits<char>::eof();
+        c = buf->sgetc()) {
+        auto ch = static_cast<char>(c);
+        bool space = std::isspace(static_cast<unsigned char>(ch));
+
+        if(space && !instring && depth == 0 && !s.empty())
+            break; // After a scalar, left to read_updates()
+
+        buf->sbumpc();
+        if(space && s.empty())
+            continue;
+
+        s.push_back(ch);
+
+        if(instring) {
+            if(escaped)
+                escaped = false;
+            else if(ch == '\\')
+                escaped = true;
+            else if(ch == '"') {
+                instring = false;
+                if(depth == 0)
+                    break;
+            }
+        }
+        else if(ch == '"')
+            instring = true;
+        else if(ch == '{' || ch == '[')
+            depth++;
+        else if((ch == '}' || ch == ']') && --depth <= 0)
+            break;
     }
 
-    return input;
+    return s;
+}
+
+nlohmann::json read_stdin() {
+    std::string s = read_first_value();
+    tanto::trace::Span span{"json parse", "parse"};
+    return nlohmann::json::parse(s);
+}
+
+// One update per line, applied while the dialog is shown
+void read_updates(std::shared_ptr<tanto::UpdateQueue> updates) {
+    std::thread{[updates = std::move(updates)]() {
+        std::string line;
+
+        while(std::getline(std::cin, line)) {
+            if(line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+
+            try {
+                updates->push(nlohmann::json::parse(line));
+            }
+            catch(nlohmann::json::exception& e) {
+                spdlog::warn("Invalid update: {}", e.what());
+            }
+        }
+    }}.detach(); // Blocked in read() until EOF
 }
 
 int execute_mode(const BackendPtr& backend, cl::Args& args) {
@@ -128,17 +157,95 @@ int execute_mode(const BackendPtr& backend, cl::Args& args) {
     return 0;
 }
 
+// Closes itself at EOF, otherwise the user cancelled it (exit code 1)
+int execute_progress(const BackendPtr& backend, cl::Args& args) {
+    auto outcome = std::make_shared<tanto::ProgressOutcome>();
+
+    backend->set_event_handler([outcome](const std::string& e) {
+        // A click after EOF is too late
+        if(outcome->settle(tanto::ProgressOutcome::CANCELLED))
+            std::puts(e.c_str());
+    });
+
+    backend->process(tanto::progress_window(
+        std::string{args["title"].to_string()},
+        args["text"] ? std::string{args["text"].to_string()} : std::string{}));
+
+    tanto::read_progress(0, backend->updates(), outcome);
+    backend->run();
+    backend->set_event_handler(nullptr);
+
+    // Closed by the window manager, report it the same way
+    if(outcome->settle(tanto::ProgressOutcome::CANCELLED))
+        std::puts(R"({"from":"cancel","type":"clicked"})");
+
+    if(outcome->result() == tanto::ProgressOutcome::FINISHED)
+        return 0;
+
+    std::fflush(stdout);
+    return 1;
+}
+
+// Chosen lines go to stdout, exit code 1 if none was
+int execute_pick(const BackendPtr& backend, cl::Args& args) {
+    auto picker = std::make_shared<tanto::Picker>(backend->updates());
+    bool multi = args["multi"].to_bool();
+    size_t chosen = 0;
+
+    auto choose = [&chosen](const std::string& line) {
+        std::puts(line.c_str());
+        std::fflush(stdout);
+        chosen++;
+    };
+
+    backend->set_event_handler([&](const std::string& e) {
+        nlohmann::json event = nlohmann::json::parse(e);
+        std::string from = event.value("from", std::string{});
+
+        if(from == "results") { // A row activated
+            choose(event["detail"]["id"].get<std::string>());
+
+            if(!multi) // No id: it's for the window itself
+                backend->updates()->push(
+                    tanto::UpdateQueue::Update{{}, {}, "close", true});
+        }
+        else if(from == "ok" && !chosen) { // The current row or the best
+            nlohmann::json current = backend->value_of({}, "results");
+
+            if(current.is_string())
+                choose(current.get<std::string>());
+            else if(std::optional<std::string> best = picker->best(); best)
+                choose(*best);
+        }
+    });
+
+    backend->watch("query", [picker](const nlohmann::json& value) {
+        picker->set_query(value.is_string() ? value.get<std::string>()
+                                            : std::string{});
+    });
+
+    backend->process(tanto::pick_window(
+        args["title"] ? std::string{args["title"].to_string()} : "Pick"));
+
+    tanto::read_candidates(0, picker);
+    backend->run();
+    backend->set_event_handler(nullptr);
+    return chosen ? 0 : 1;
+}
+
 bool needs_json(cl::Args& args) {
     return args["stdin"].to_bool() || args["load"].to_bool();
 }
 
-int execute_json(const BackendPtr& backend, cl::Args& args) {
+int execute_json(const BackendPtr& backend, cl::Args& args,
+                 bool updates) {
     nlohmann::json jsonreq;
 
     try {
         if(args["stdin"].to_bool())
-            jsonreq = nlohmann::json::parse(read_stdin());
+            jsonreq = read_stdin();
         else if(args["load"].to_bool()) {
+            tanto::trace::Span span{"json parse", "parse"};
             std::ifstream f{std::string{args["filename"].to_string()}};
             jsonreq = nlohmann::json::parse(f);
         }
@@ -149,10 +256,36 @@ int execute_json(const BackendPtr& backend, cl::Args& args) {
         spdlog::critical(e.what());
     }
 
-    auto window = tanto::parse(jsonreq);
-    if(window)
-        backend->process(*window);
-    return backend->run();
+    std::vector<tanto::types::Window> windows;
+
+    try {
+        windows = tanto::parse_windows(jsonreq);
+    }
+    catch(tanto::ParseError& e) {
+        spdlog::critical(e.what());
+        return 1;
+    }
+    catch(nlohmann::json::exception& e) { // Like values of the wrong type
+        spdlog::critical(e.what());
+        return 1;
+    }
+
+    // An array shows several windows, each one closes on its own
+    for(const tanto::types::Window& w : windows)
+        backend->process(w);
+
+    if(updates && args["stdin"].to_bool())
+        read_updates(backend->updates());
+
+    int res = backend->run();
+
+    if(tanto::UpdateQueue::Stats s = backend->updates()->stats(); s.received) {
+        spdlog::debug(
+            "Updates: {} received, {} applied, {} merged, {} dropped",
+            s.received, s.applied, s.merged, s.dropped);
+    }
+
+    return res;
 }
 
 } // namespace
@@ -169,59 +302,87 @@ int main(int argc, char** argv) {
     cl::Options{
         cl::opt("d", "debug", "Debug mode"),
         cl::opt("b", "backend"_arg, "Select backend"),
+        cl::opt("t", "trace"_arg, "Write a Chrome trace to file"),
+        cl::opt("s", "spill"_arg, "Write event values over ARG bytes to files"),
+        cl::opt("m", "multi", "Choose several lines"),
     };
 
     cl::Usage{
-        cl::cmd("stdin", *--"debug"__, *--"backend"__),
-        cl::cmd("load", "filename", *--"debug"__, *--"backend"__),
-        cl::cmd("message", "title", "text", *cl::one("info", "question", "warning", "error"), *--"debug"__, *--"backend"__),
-        cl::cmd("confirm", "title", "text", *cl::one("info", "question", "warning", "error"), *--"debug"__, *--"backend"__),
-        cl::cmd("input", "title", *"text"__, *"value"__, *--"debug"__, *--"backend"__),
-        cl::cmd("password", "title", *"text"__, *--"debug"__, *--"backend"__),
-        cl::cmd("selectdir", *"title"__, *"dir"__, *--"debug"__, *--"backend"__),
-        cl::cmd("loadfile", *"title"__, *"filter"__, *"dir"__, *--"debug"__, *--"backend"__),
-        cl::cmd("savefile", *"title"__, *"filter"__, *"dir"__, *--"debug"__, *--"backend"__),
+        cl::cmd("stdin", *--"debug"__, *--"backend"__, *--"trace"__, *--"spill"__),
+        cl::cmd("load", "filename", *--"debug"__, *--"backend"__, *--"trace"__, *--"spill"__),
+        cl::cmd("message", "title", "text", *cl::one("info", "question", "warning", "error"), *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("confirm", "title", "text", *cl::one("info", "question", "warning", "error"), *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("input", "title", *"text"__, *"value"__, *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("password", "title", *"text"__, *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("selectdir", *"title"__, *"dir"__, *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("loadfile", *"title"__, *"filter"__, *"dir"__, *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("savefile", *"title"__, *"filter"__, *"dir"__, *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("progress", "title", *"text"__, *--"debug"__, *--"backend"__, *--"trace"__),
+        cl::cmd("pick", *"title"__, *--"multi"__, *--"debug"__, *--"backend"__, *--"trace"__),
         cl::cmd("list", *--"debug"__),
     };
     // clang-format on
 
-    if(BACKENDS.empty()) {
+    if(tanto::backends().empty()) {
         fmt::println("ERROR: No backends available");
         return 2;
     }
 
-    selectedbackend = BACKENDS.begin()->first;
-
     auto args = cl::parse(argc, argv);
 
     if(args["debug"].to_bool()) {
+        spdlog::set_level(spdlog::level::debug);
+
         for(const auto& arg : args)
             fmt::println("{} - {}", arg.first, arg.second.dump());
     }
 
+    if(args["trace"]) {
+        std::string tracefile{args["trace"].to_string()};
+
+        if(!tanto::trace::start(tracefile)) {
+            fmt::println("ERROR: Cannot write trace file '{}'", tracefile);
+            return 1;
+        }
+    }
+
     if(args["list"].to_bool()) {
-        for(const auto& [name, version] : BACKENDS)
+        for(const auto& [name, version] : tanto::backends())
             fmt::println("{}: {}", name, version);
 
         return 0;
     }
 
-    if(!args["backend"]) {
-        char* envbackend = std::getenv("TANTO_BACKEND");
-        if(envbackend)
-            selectedbackend = envbackend;
-    }
-    else
-        selectedbackend = args["backend"].to_string();
+    std::string selectedbackend = args["backend"]
+                                      ? std::string{args["backend"].to_string()}
+                                      : tanto::default_backend();
 
-    if(!has_backend(selectedbackend)) {
+    if(!tanto::has_backend(selectedbackend)) {
         fmt::println("ERROR: Unsupported backend '{}'", selectedbackend);
         return 1;
     }
 
-    BackendPtr backend = new_backend(selectedbackend, argc, argv);
+    BackendPtr backend = tanto::new_backend(selectedbackend, argc, argv);
+
+    if(args["spill"]) {
+        std::string_view s = args["spill"].to_stringview();
+        size_t threshold = 0;
+        auto res = std::from_chars(s.data(), s.data() + s.size(), threshold);
+
+        if(res.ec != std::errc{} || !threshold) {
+            fmt::println("ERROR: Invalid spill threshold '{}'", s);
+            return 1;
+        }
+
+        backend->set_spill_threshold(threshold);
+    }
 
+    // The headless backend reads its script from stdin
     if(needs_json(args))
-        return execute_json(backend, args);
+        return execute_json(backend, args, selectedbackend != "headless");
+    if(args["progress"].to_bool())
+        return execute_progress(backend, args);
+    if(args["pick"].to_bool())
+        return execute_pick(backend, args);
     return execute_mode(backend, args);
 }
@@ -1,12 +1,129 @@
 #include "backend.h"
+#include "datasource.h"
+#include "dirlist.h"
 #include "error.h"
+#include "trace.h"
 #include "utils.h"
+#include "workerpool.h"
+#include <algorithm>
+#include <unordered_set>
 
 Backend::Backend(int& argc, char** argv): Events{} {
     (void)argc;
     (void)argv;
 }
-void Backend::processed() {}
+namespace {
+
+constexpr size_t NO_PAGE = static_cast<size_t>(-1);
+constexpr size_t SCROLL_PAGE_ROWS = 20; // Until the viewport is known
+constexpr size_t SCROLL_OVERSCAN = 8;   // Rows built above and below it
+
+[[nodiscard]] bool is_layout(const std::string& type) {
+    return type == "row" || type == "column" || type == "grid" ||
+           type == "form";
+}
+
+// Calls 'f' on every widget built with 'arg', list rows excluded
+template<typename W, typename Function>
+void each_child(W& arg, Function&& f) {
+    for(auto& item : arg.items) {
+        auto* w = std::get_if<tanto::types::Widget>(&item);
+        if(!w)
+            continue;
+
+        f(*w);
+        if(is_layout(w->type) || w->type == "tabs" || w->type == "scroll")
+            each_child(*w, f);
+    }
+}
+
+// The property holding what get_model_data() returns, if it can be set
+[[nodiscard]] std::string_view value_property(const std::string& type) {
+    if(type == "input")
+        return "text";
+    if(type == "number")
+        return "value";
+    if(type == "check")
+        return "checked";
+    return {};
+}
+
+// Whether 'item' is what get_model_data() reports as 'current': its id, or
+// its row in lists with a header
+[[nodiscard]] bool is_current(const tanto::types::MultiValue& item,
+                              const nlohmann::json& current,
+                              const tanto::Header& header) {
+    const auto* a = std::get_if<tanto::types::Widget>(&item);
+
+    if(const auto* id = current.get_ptr<const std::string*>(); id)
+        return (a ? a->get_id() : std::get<std::string>(item)) == *id;
+
+    if(!a || !current.is_object() || header.empty())
+        return false;
+
+    for(const tanto::HeaderItem& h : header) {
+        auto it = current.find(h.id);
+        if(it == current.end() ? a->has_prop(h.id)
+                               : a->prop<nlohmann::json>(h.id) != *it)
+            return false;
+    }
+
+    return true;
+}
+
+// Marks the current item "selected", and only that one, so that a rebuilt
+// widget selects it again
+void save_selection(tanto::types::MultiValueList& items,
+                    const nlohmann::json& current,
+                    const tanto::Header& header, bool& found) {
+    for(tanto::types::MultiValue& item : items) {
+        bool selected =
+            !found && !current.is_null() && is_current(item, current, header);
+        found |= selected;
+
+        if(auto* a = std::get_if<tanto::types::Widget>(&item); a) {
+            if(selected)
+                a->properties["selected"] = true;
+            else
+                a->properties.erase("selected");
+
+            save_selection(a->items, current, header, found);
+        }
+        else if(selected) { // Only objects have properties
+            tanto::types::Widget w;
+            w.text = std::get<std::string>(item);
+            w.properties["selected"] = true;
+            item = std::move(w);
+        }
+    }
+}
+
+// Keeps a widget that isn't built in sync with updates and edits
+void update_description(tanto::types::Widget& arg, std::string_view property,
+                        const nlohmann::json& value) {
+    if(property == "text")
+        arg.text = tanto::stringify(value);
+    else if(property == "value")
+        arg.value = value.get<int>();
+    else if(property == "enabled")
+        arg.enabled = value.get<bool>();
+    else
+        arg.properties[std::string{property}] = value;
+}
+
+void set_window(tanto::types::Widget& arg, const std::string& window) {
+    arg.window = window;
+
+    for(tanto::types::MultiValue& item : arg.items) {
+        if(auto* w = std::get_if<tanto::types::Widget>(&item); w)
+            set_window(*w, window);
+    }
+}
+
+} // namespace
+
+void Backend::processed(const std::any& window) { (void)window; }
+void Backend::page_processed(const std::any& page) { (void)page; }
 void Backend::widget_processed(const tanto::types::Widget& arg,
                                const std::any& widget) {
     (void)arg;
@@ -15,11 +132,123 @@ void Backend::widget_processed(const tanto::types::Widget& arg,
 std::string_view Backend::version() { unreachable; }
 
 void Backend::process(const tanto::types::Window& arg) {
-    m_ismodel = arg.model;
+    tanto::trace::Span span{"build", "backend"};
+
+    if(m_windows.count(arg.id))
+        except("Duplicate window: '{}'", arg.id);
+
+    m_windows[arg.id].ismodel = arg.model;
+    m_windowdata[arg.id].bindings = arg.bindings; // Needed by observed()
+    m_windowdata[arg.id].rules = arg.rules;
+    // Start downloads before building widgets
+    m_windowdata[arg.id].fdreads = tanto::prefetch(arg);
     std::any window = this->new_window(arg);
-    if(arg.body)
+
+    if(arg.body && arg.id.empty())
         this->process(arg.body, window);
-    this->processed();
+    else if(arg.body) { // Events need to know where they come from
+        tanto::types::Widget body = arg.body;
+        set_window(body, arg.id);
+        this->process(body, window);
+    }
+
+    this->processed(window);
+
+    if(arg.bindings) { // Once shown: GTK's show_all() would undo "visible"
+        for(const tanto::Binding& b : arg.bindings->bindings())
+            this->apply_binding(arg.id, b);
+    }
+}
+
+void Backend::close(const std::string& window) {
+    auto it = m_windows.find(window);
+    if(it == m_windows.end()) // Already closed
+        return;
+
+    std::string id = window; // 'window' may belong to a destroyed widget
+    m_windows.erase(it);
+    m_windowdata.erase(id);
+    this->destroy_window(id);
+
+    if(m_windows.empty())
+        this->exit();
+}
+
+void Backend::apply_updates() {
+    std::vector<tanto::UpdateQueue::Update> updates = m_updates->take();
+    if(updates.empty())
+        return;
+
+    tanto::trace::Span span{"updates", "backend"};
+
+    for(const tanto::UpdateQueue::Update& u : updates) {
+        auto wit = m_windows.find(u.window);
+        if(wit == m_windows.end())
+            continue; // Closed in the meantime
+
+        if(u.id.empty()) {
+            if(u.property == "close" && u.value == true)
+                this->close(u.window);
+            else
+                spdlog::warn("Update: invalid window property '{}'",
+                             u.property);
+            continue;
+        }
+
+        auto it = wit->second.widgets.find(u.id);
+
+        if(it == wit->second.widgets.end()) { // In a page not built yet?
+            const auto& deferred = m_windowdata[u.window].deferred;
+            if(auto d = deferred.find(u.id); d != deferred.end()) {
+                this->build_page(u.window, d->second.page);
+                it = wit->second.widgets.find(u.id);
+            }
+        }
+
+        if(it == wit->second.widgets.end()) { // In a row out of view?
+            auto& rows = m_windowdata[u.window].rowwidgets;
+            if(auto r = rows.find(u.id); r != rows.end()) {
+                update_description(*r->second.arg, u.property, u.value);
+                if(wit->second.ismodel)
+                    wit->second.model[u.id] = {*r->second.arg, std::any{}};
+                continue;
+            }
+        }
+
+        if(it == wit->second.widgets.end()) {
+            spdlog::warn("Update: widget '{}' not found", u.id);
+            continue;
+        }
+
+        // A new descriptor is read once, while the window is open
+        if(const auto* text = u.value.get_ptr<const std::string*>();
+           it->second.first == "image" && u.property == "text" && text &&
+           tanto::utils::starts_with(*text, "fd:"))
+            m_windowdata[u.window].fdreads.push_back(
+                tanto::read_fd_source(*text));
+
+        try {
+            this->update_widget(it->second.first, it->second.second,
+                                u.property, u.value);
+        }
+        catch(nlohmann::json::exception& e) {
+            spdlog::warn("Update: invalid '{}' for '{}': {}", u.property, u.id,
+                         e.what());
+        }
+        catch(tanto::ParseError& e) { // Like "items" of unknown types
+            spdlog::warn("Update: invalid '{}' for '{}': {}", u.property, u.id,
+                         e.what());
+        }
+    }
+}
+
+void Backend::close_all() {
+    auto windows = std::move(m_windows);
+    m_windows.clear();
+    m_windowdata.clear();
+
+    for(const auto& [id, wm] : windows)
+        this->destroy_window(id);
 }
 
 std::any Backend::process(const tanto::types::Widget& arg,
@@ -30,12 +259,14 @@ std::any Backend::process(const tanto::types::Widget& arg,
     {
         tanto::types::Widget t{"text"};
         t.text = arg.title;
+        t.window = arg.window;
 
         tanto::types::Widget w = arg; // Copy & Clear title
         w.fill = true;
         w.title.clear();
 
         tanto::types::Widget l{"column"};
+        l.window = arg.window;
         l.fill = arg.fill; // Propagate "fill" status
         l.items.emplace_back(t);
         l.items.emplace_back(w);
@@ -43,6 +274,16 @@ std::any Backend::process(const tanto::types::Widget& arg,
         return this->process(l, parent);
     }
 
+    // Rules are objects, buttons use "validate": false to skip them
+    if(tanto::find_rule(arg) &&
+       !m_windowdata[arg.window].fields.count(arg.id))
+        return this->process_field(arg, parent);
+
+    tanto::trace::Span span{"process", "backend"};
+    span.arg("type", arg.type);
+    if(arg.has_id())
+        span.arg("id", arg.id);
+
     std::any widget;
 
     switch(tanto::utils::fnv1a_32(arg.type)) {
@@ -53,10 +294,27 @@ std::any Backend::process(const tanto::types::Widget& arg,
         case "image"_fnv1a_32: widget = this->new_image(arg, parent); break;
         case "button"_fnv1a_32: widget = this->new_button(arg, parent); break;
         case "check"_fnv1a_32: widget = this->new_check(arg, parent); break;
+        case "progress"_fnv1a_32:
+            widget = this->new_progress(arg, parent);
+            break;
+        case "log"_fnv1a_32:
+            widget = this->new_log(arg, parent);
+            this->follow_log(arg);
+            break;
         case "list"_fnv1a_32: widget = this->new_list(arg, parent); break;
         case "tree"_fnv1a_32: widget = this->new_tree(arg, parent); break;
-        case "tabs"_fnv1a_32:
-            widget = this->process_container(this->new_tabs(arg, parent), arg);
+        case "gallery"_fnv1a_32:
+            widget = this->new_gallery(arg, parent);
+            break;
+        case "files"_fnv1a_32:
+            if(!arg.has_id()) // Listings are routed by id
+                except("Files '{}' needs an id", tanto::files_root(arg));
+            widget = this->new_files(arg, parent);
+            this->expanded(arg, tanto::files_root(arg));
+            break;
+        case "tabs"_fnv1a_32: widget = this->process_tabs(arg, parent); break;
+        case "scroll"_fnv1a_32:
+            widget = this->process_scroll(arg, parent);
             break;
         case "row"_fnv1a_32:
             widget = this->process_layout(
@@ -85,31 +343,493 @@ std::any Backend::process(const tanto::types::Widget& arg,
 
     assume(widget.has_value());
 
-    if(m_ismodel && arg.has_id()) {
-        if(m_model.count(arg.id))
-            except("Duplicate id: '{}'", arg.id);
-        m_model[arg.id] = {arg, widget};
+    if(arg.has_id()) {
+        WindowModel& wm = m_windows.at(arg.window);
+        wm.widgets[arg.id] = {arg.type, widget};
+
+        if(arg.has_prop("header")) { // Rows are reported by value_of() too
+            tanto::types::Widget h{arg.type};
+            h.properties.emplace("header", arg.prop<nlohmann::json>("header"));
+            m_windowdata[arg.window].headers[arg.id] = std::move(h);
+        }
+
+        if(wm.ismodel) {
+            if(wm.model.count(arg.id))
+                except("Duplicate id: '{}'", arg.id);
+            wm.model[arg.id] = {arg, widget};
+        }
     }
 
     this->widget_processed(arg, widget);
     return widget;
 }
 
+bool Backend::observed(const tanto::types::Widget& arg) const {
+    if(tanto::find_rule(arg))
+        return true;
+
+    if(m_watchers.count(arg.id))
+        return true;
+
+    auto it = m_windowdata.find(arg.window);
+    return it != m_windowdata.end() && it->second.bindings &&
+           it->second.bindings->observed(arg.id);
+}
+
+void Backend::value_changed(const tanto::types::Widget& arg) {
+    this->validate(arg);
+
+    if(auto w = m_watchers.find(arg.id); w != m_watchers.end())
+        w->second(this->value_of(arg.window, arg.id));
+
+    auto it = m_windowdata.find(arg.window);
+    if(it == m_windowdata.end() || !it->second.bindings)
+        return;
+
+    std::shared_ptr<const tanto::BindingGraph> graph = it->second.bindings;
+    for(size_t idx : graph->dependents(arg.id))
+        this->apply_binding(arg.window, graph->bindings()[idx]);
+}
+
+void Backend::expanded(const tanto::types::Widget& arg,
+                       const std::string& dir) {
+    std::string key = arg.id + '\x1f' + dir;
+    if(!m_windowdata[arg.window].listed.insert(key).second)
+        return; // Listed, or being listed
+
+    auto filter = tanto::parse_filter(arg.prop<std::string>("filter"));
+    bool hidden = arg.prop<bool>("hidden");
+
+    auto list = [updates = m_updates, window = arg.window, id = arg.id, dir,
+                 filter, hidden]() {
+        tanto::trace::Span span{"list", "files"};
+
+        tanto::list_dir(
+            dir, filter, hidden,
+            [&](std::vector<tanto::DirEntry> entries, bool done) {
+                nlohmann::json batch = nlohmann::json::array();
+                for(const tanto::DirEntry& e : entries) // [name, isdir]
+                    batch.push_back(nlohmann::json::array({e.name, e.isdir}));
+
+                nlohmann::json listing = nlohmann::json::object();
+                listing[dir] = {{"entries", std::move(batch)}, {"done", done}};
+                updates->push(tanto::UpdateQueue::Update{
+                    window, id, "entries", std::move(listing)});
+            });
+    };
+
+    if(!tanto::WorkerPool::instance().push(list)) // Stopped, retried later
+        m_windowdata[arg.window].listed.erase(key);
+}
+
+bool Backend::validate(const tanto::types::Widget& arg) {
+    auto wit = m_windowdata.find(arg.window);
+    if(wit == m_windowdata.end())
+        return true;
+
+    auto& fields = wit->second.fields;
+    auto it = fields.find(arg.id);
+    if(it == fields.end())
+        return true;
+
+    it->second.touched = true;
+    bool valid = this->check_field(it->second);
+
+    for(auto& [id, f] : fields) { // Fields that must match this one
+        if(f.touched && f.rule->equals == arg.id)
+            this->check_field(f);
+    }
+
+    return valid;
+}
+
+bool Backend::can_submit(const tanto::types::Widget& w) {
+    if(!w.prop<bool>("validate", true)) // Like "Cancel" buttons
+        return true;
+
+    auto wit = m_windowdata.find(w.window);
+    if(wit == m_windowdata.end())
+        return true;
+
+    bool valid = true;
+
+    for(auto& [id, f] : wit->second.fields) { // Show every error at once
+        f.touched = true;
+        valid &= this->check_field(f);
+    }
+
+    return valid;
+}
+
+nlohmann::json Backend::value_of(const std::string& window,
+                                 const std::string& id) {
+    const auto& widgets = m_windows.at(window).widgets;
+    auto it = widgets.find(id);
+
+    if(it == widgets.end()) {
+        const auto& deferred = m_windowdata[window].deferred;
+        if(auto d = deferred.find(id); d != deferred.end())
+            return tanto::default_value(*d->second.arg);
+
+        const auto& rows = m_windowdata[window].rowwidgets;
+        if(auto r = rows.find(id); r != rows.end())
+            return tanto::default_value(*r->second.arg);
+
+        except("Widget '{}' not found", id);
+    }
+
+    const auto& headers = m_windowdata[window].headers;
+    if(auto h = headers.find(id); h != headers.end())
+        return this->get_model_data(h->second, it->second.second);
+
+    return this->get_model_data(tanto::types::Widget{it->second.first},
+                                it->second.second);
+}
+
+bool Backend::check_field(Field& f) {
+    nlohmann::json value = this->get_model_data(f.arg, f.widget), other;
+    if(!f.rule->equals.empty())
+        other = this->value_of(f.arg.window, f.rule->equals);
+
+    std::string error = tanto::check_rule(*f.rule, value, other);
+    this->update_widget("text", f.error, "text", error);
+    return error.empty();
+}
+
+void Backend::apply_binding(const std::string& window,
+                            const tanto::Binding& b) {
+    const auto& widgets = m_windows.at(window).widgets;
+    auto it = widgets.find(b.id);
+    if(it == widgets.end())
+        return;
+
+    bool value = b.expr.eval(
+        [&](const std::string& id) { return this->value_of(window, id); });
+
+    this->update_widget(it->second.first, it->second.second, b.property,
+                        value);
+}
+
+void Backend::follow_log(const tanto::types::Widget& arg) {
+    if(!arg.has_prop("source")) // Fed by "append" updates only
+        return;
+
+    auto source = arg.prop<std::string>("source");
+    if(!arg.has_id()) // Appended text is routed by id
+        except("Log '{}' needs an id", source);
+
+    m_windowdata[arg.window].logs.push_back(std::make_unique<tanto::LogTail>(
+        source, arg.prop<size_t>("lines", tanto::LOG_MAX_LINES),
+        [updates = m_updates, window = arg.window,
+         id = arg.id](std::string text) { // From the log's thread
+            updates->push(tanto::UpdateQueue::Update{window, id, "append",
+                                                     std::move(text)});
+        }));
+}
+
+std::any Backend::process_field(const tanto::types::Widget& arg,
+                                const std::any& parent) {
+    if(!arg.has_id()) // Cross checks and changes refer to it
+        except("Validated '{}' needs an id", arg.type);
+
+    // Parsed once, before the widget: it won't be wrapped again
+    Field& f = m_windowdata[arg.window].fields[arg.id];
+    f.arg = arg;
+    const auto& rules = m_windowdata[arg.window].rules;
+    if(auto r = rules.find(arg.id); r != rules.end())
+        f.rule = r->second;
+    else // Not from tanto::parse
+        f.rule = std::make_shared<const tanto::ValidationRule>(
+            tanto::parse_rule(*tanto::find_rule(arg)));
+
+    tanto::types::Widget l{"column"};
+    l.window = arg.window;
+    l.fill = arg.fill;
+
+    tanto::types::Widget e{"text"};
+    e.window = arg.window;
+
+    std::any layout = this->process(l, parent);
+    f.widget = this->process(arg, layout);
+    f.error = this->process(e, layout);
+    return layout;
+}
+
+void Backend::process_item(const tanto::types::MultiValue& item,
+                           const std::any& container,
+                           const std::string& window) {
+    std::visit(tanto::utils::Overload{
+                   [&](const tanto::types::Widget& a) {
+                       this->process(a, container);
+                   },
+                   [&](const std::string& a) { // Convert in 'text' widgets
+                       tanto::types::Widget w{"text"};
+                       w.text = a;
+                       w.window = window;
+                       this->process(w, container);
+                   }},
+               item);
+}
+
 std::any Backend::process_container(const std::any& container,
                                     const tanto::types::Widget& arg) {
-    for(auto item : arg.items) {
-        std::visit(
-            tanto::utils::Overload{
-                [&](tanto::types::Widget& a) { this->process(a, container); },
-                [&](std::string& a) { // Convert strings in 'text' widgets
-                    tanto::types::Widget w{"text"};
-                    w.text = a;
-                    this->process(w, container);
-                },
-                [](auto&) {} // Ignore everything else
-            },
-            item);
-    }
+    for(const tanto::types::MultiValue& item : arg.items)
+        this->process_item(item, container, arg.window);
 
     return container;
 }
+
+std::any Backend::process_tabs(const tanto::types::Widget& arg,
+                               const std::any& parent) {
+    std::any tabs = this->new_tabs(arg, parent);
+    std::vector<size_t> pages; // By tab, in WindowData::pages
+    bool deferred = false;
+
+    for(size_t i = 0; i < arg.items.size(); i++) {
+        const auto* w = std::get_if<tanto::types::Widget>(&arg.items[i]);
+
+        if(i && w && this->defer_page(*w, tabs)) { // The first one is shown
+            pages.push_back(m_windowdata[arg.window].pages.size() - 1);
+            deferred = true;
+        }
+        else {
+            pages.push_back(NO_PAGE);
+            this->process_item(arg.items[i], tabs, arg.window);
+        }
+    }
+
+    if(deferred) {
+        this->connect_tabs(
+            tabs, [this, window = arg.window, pages](int index) {
+                if(index >= 0 && static_cast<size_t>(index) < pages.size() &&
+                   pages[index] != NO_PAGE)
+                    this->build_page(window, pages[index]);
+            });
+    }
+
+    return tabs;
+}
+
+bool Backend::defer_page(const tanto::types::Widget& arg,
+                         const std::any& tabs) {
+    if(!is_layout(arg.type) || !arg.title.empty() || arg.prop<bool>("eager"))
+        return false;
+
+    bool validated = tanto::find_rule(arg) != nullptr;
+    each_child(arg, [&](const tanto::types::Widget& w) {
+        validated |= tanto::find_rule(w) != nullptr;
+    });
+
+    if(validated) // Rules are checked on submit, they need their widgets
+        return false;
+
+    WindowData& wd = m_windowdata[arg.window];
+    size_t idx = wd.pages.size();
+    Page& page = wd.pages.emplace_back();
+    page.arg = arg;
+
+    // Only the (empty) layout for now, so the tab shows up
+    tanto::types::MultiValueList items = std::move(page.arg.items);
+    page.arg.items.clear();
+    page.layout = this->process(page.arg, tabs);
+    page.arg.items = std::move(items);
+
+    WindowModel& wm = m_windows.at(arg.window);
+
+    each_child(page.arg, [&](const tanto::types::Widget& w) {
+        if(!w.has_id())
+            return;
+
+        wd.deferred[w.id] = Deferred{idx, &w};
+
+        if(wm.ismodel) { // Reported with its default value until built
+            if(wm.model.count(w.id))
+                except("Duplicate id: '{}'", w.id);
+            wm.model[w.id] = {w, std::any{}};
+        }
+    });
+
+    return true;
+}
+
+void Backend::build_page(const std::string& window, size_t idx) {
+    auto it = m_windowdata.find(window);
+    if(it == m_windowdata.end()) // Closed
+        return;
+
+    Page& page = it->second.pages.at(idx);
+    if(page.built)
+        return;
+
+    tanto::trace::Span span{"page", "backend"};
+    page.built = true;
+    WindowModel& wm = m_windows.at(window);
+
+    each_child(page.arg, [&](const tanto::types::Widget& w) {
+        if(!w.has_id())
+            return;
+
+        it->second.deferred.erase(w.id);
+        if(wm.ismodel)
+            wm.model.erase(w.id);
+    });
+
+    this->process_container(page.layout, page.arg);
+    this->page_processed(page.layout);
+
+    if(std::shared_ptr<const tanto::BindingGraph> graph =
+           it->second.bindings) { // Its widgets may be bound
+        for(const tanto::Binding& b : graph->bindings())
+            this->apply_binding(window, b);
+    }
+}
+
+std::any Backend::process_scroll(const tanto::types::Widget& arg,
+                                 const std::any& parent) {
+    WindowData& wd = m_windowdata[arg.window];
+    size_t idx = wd.scrolls.size();
+    ScrollArea& sa = wd.scrolls.emplace_back();
+    sa.arg = arg;
+
+    for(tanto::types::MultiValue& item : sa.arg.items) {
+        if(auto* s = std::get_if<std::string>(&item); s) { // Like containers
+            tanto::types::Widget w{"text"};
+            w.text = std::move(*s);
+            w.window = arg.window;
+            item = std::move(w);
+        }
+    }
+
+    WindowModel& wm = m_windows.at(arg.window);
+
+    for(size_t r = 0; r < sa.arg.items.size(); r++) {
+        auto& row = std::get<tanto::types::Widget>(sa.arg.items[r]);
+
+        auto add = [&](tanto::types::Widget& w) {
+            // Rows come and go: nothing may outlive them
+            if(w.type == "log" || w.type == "files" || w.type == "tabs" ||
+               w.type == "scroll" ||
+               tanto::find_rule(w))
+                except("'{}' is not supported in scroll rows", w.type);
+
+            if(!w.has_id())
+                return;
+
+            wd.rowwidgets[w.id] = RowWidget{idx, r, &w};
+
+            if(wm.ismodel) { // Reported from the description until built
+                if(wm.model.count(w.id))
+                    except("Duplicate id: '{}'", w.id);
+                wm.model[w.id] = {w, std::any{}};
+            }
+        };
+
+        add(row);
+        each_child(row, add);
+    }
+
+    sa.widget = this->new_scroll(sa.arg, parent);
+
+    this->connect_scroll(sa.widget, [this, window = arg.window,
+                                     idx](size_t first, size_t count) {
+        this->scroll_rows(window, idx, first, count);
+    });
+
+    auto height = static_cast<size_t>(std::max(arg.height, 0));
+    auto rowheight = arg.prop<size_t>("rowheight", tanto::SCROLL_ROW_HEIGHT);
+    size_t count = height && rowheight ? height / rowheight + 1
+                                       : SCROLL_PAGE_ROWS;
+
+    this->scroll_rows(arg.window, idx, 0, count);
+    return sa.widget;
+}
+
+void Backend::scroll_rows(const std::string& window, size_t idx, size_t first,
+                          size_t count) {
+    auto it = m_windowdata.find(window);
+    if(it == m_windowdata.end()) // Closed
+        return;
+
+    ScrollArea& sa = it->second.scrolls.at(idx);
+    size_t begin = first > SCROLL_OVERSCAN ? first - SCROLL_OVERSCAN : 0;
+    size_t end = std::min(sa.arg.items.size(), first + count + SCROLL_OVERSCAN);
+
+    for(auto r = sa.rows.begin(); r != sa.rows.end();) {
+        if(r->first >= begin && r->first < end) {
+            ++r;
+            continue;
+        }
+
+        this->unrealize_row(window, sa, r->first, r->second);
+        r = sa.rows.erase(r);
+    }
+
+    std::unordered_set<std::string> realized; // Ids, for bindings
+
+    for(size_t r = begin; r < end; r++) {
+        if(sa.rows.count(r))
+            continue;
+
+        tanto::trace::Span span{"row", "backend"};
+        auto& row = std::get<tanto::types::Widget>(sa.arg.items[r]);
+        WindowModel& wm = m_windows.at(window);
+
+        auto add = [&](const tanto::types::Widget& w) {
+            if(!w.has_id())
+                return;
+            realized.insert(w.id);
+            if(wm.ismodel) // Registered again with its widget
+                wm.model.erase(w.id);
+        };
+
+        add(row);
+        each_child(row, add);
+
+        std::any container = this->new_scroll_row(sa.widget, r);
+        this->process(row, container);
+        this->page_processed(container);
+        sa.rows[r] = container;
+    }
+
+    std::shared_ptr<const tanto::BindingGraph> graph = it->second.bindings;
+    if(!graph || realized.empty())
+        return;
+
+    for(const tanto::Binding& b : graph->bindings()) {
+        if(realized.count(b.id))
+            this->apply_binding(window, b);
+    }
+}
+
+void Backend::unrealize_row(const std::string& window, ScrollArea& sa,
+                            size_t r, const std::any& container) {
+    auto& row = std::get<tanto::types::Widget>(sa.arg.items[r]);
+    WindowModel& wm = m_windows.at(window);
+
+    auto save = [&](tanto::types::Widget& w) { // Edits outlive the widgets
+        if(!w.has_id())
+            return;
+
+        if(auto it = wm.widgets.find(w.id); it != wm.widgets.end()) {
+            if(std::string_view p = value_property(w.type); !p.empty())
+                update_description(
+                    w, p, this->get_model_data(w, it->second.second));
+            else if(w.type == "list" || w.type == "tree" ||
+                    w.type == "gallery") {
+                bool found = false;
+                save_selection(w.items,
+                               this->get_model_data(w, it->second.second),
+                               tanto::parse_header(w), found);
+            }
+
+            wm.widgets.erase(it);
+        }
+
+        if(wm.ismodel)
+            wm.model[w.id] = {w, std::any{}};
+    };
+
+    save(row);
+    each_child(row, save);
+    this->destroy_scroll_row(container);
+}
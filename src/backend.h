@@ -1,10 +1,22 @@
 #pragma once
 
+#include "bindings.h"
 #include "events.h"
+#include "logtail.h"
 #include "tanto.h"
 #include "types.h"
+#include "updates.h"
+#include "validation.h"
 #include <any>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 class Backend: public Events {
 public:
@@ -14,10 +26,14 @@ public:
 
     enum class InputType { NORMAL = 0, PASSWORD };
 
+    using ValueHandler = std::function<void(const nlohmann::json&)>;
+
 public:
     Backend(int& argc, char** argv);
     virtual ~Backend() = default;
-    virtual int run() const = 0;
+    virtual int run() = 0;
+    void close(const std::string& window) override;
+    void close_all(); // Without exiting, like when run() returns
     void process(const tanto::types::Window& arg);
     virtual void message(const std::string& title, const std::string& text,
                          MessageType mt, MessageIcon icon) = 0;
@@ -33,8 +49,38 @@ public:
                             const std::string& startdir) = 0;
     static std::string_view version();
 
+    // Widgets whose changes must be reported with value_changed()
+    [[nodiscard]] bool observed(const tanto::types::Widget& arg) const;
+    void value_changed(const tanto::types::Widget& arg);
+
+    // Lists a directory of a "files" widget, unless it's listed already
+    void expanded(const tanto::types::Widget& arg, const std::string& dir);
+
+    // Value of a widget, like events report it (built or not)
+    [[nodiscard]] nlohmann::json value_of(const std::string& window,
+                                          const std::string& id);
+
+    // Calls 'h' with the new value on each change of 'id' (GUI thread)
+    inline void watch(const std::string& id, ValueHandler h) {
+        m_watchers[id] = std::move(h);
+    }
+
+    bool can_submit(const tanto::types::Widget& w) override;
+
+    [[nodiscard]] inline const std::shared_ptr<tanto::UpdateQueue>&
+    updates() const {
+        return m_updates;
+    }
+
+protected:
+    void apply_updates();
+
 private:
     virtual std::any new_window(const tanto::types::Window& arg) = 0;
+    virtual void destroy_window(const std::string& window) = 0;
+    virtual void update_widget(const std::string& type, const std::any& widget,
+                               std::string_view property,
+                               const nlohmann::json& value) = 0;
     virtual std::any new_space(const tanto::types::Widget& arg,
                                const std::any& parent) = 0;
     virtual std::any new_text(const tanto::types::Widget& arg,
@@ -49,10 +95,18 @@ private:
                                 const std::any& parent) = 0;
     virtual std::any new_check(const tanto::types::Widget& arg,
                                const std::any& parent) = 0;
+    virtual std::any new_progress(const tanto::types::Widget& arg,
+                                  const std::any& parent) = 0;
+    virtual std::any new_log(const tanto::types::Widget& arg,
+                             const std::any& parent) = 0;
     virtual std::any new_list(const tanto::types::Widget& arg,
                               const std::any& parent) = 0;
     virtual std::any new_tree(const tanto::types::Widget& arg,
                               const std::any& parent) = 0;
+    virtual std::any new_gallery(const tanto::types::Widget& arg,
+                                 const std::any& parent) = 0;
+    virtual std::any new_files(const tanto::types::Widget& arg,
+                               const std::any& parent) = 0;
     virtual std::any new_tabs(const tanto::types::Widget& arg,
                               const std::any& parent) = 0;
     virtual std::any new_row(const tanto::types::Widget& arg,
@@ -65,11 +119,30 @@ private:
                               const std::any& parent) = 0;
     virtual std::any new_group(const tanto::types::Widget& arg,
                                const std::any& parent) = 0;
+    virtual void connect_tabs(const std::any& tabs,
+                              std::function<void(int)> activated) = 0;
+    virtual std::any new_scroll(const tanto::types::Widget& arg,
+                                const std::any& parent) = 0;
+    virtual std::any new_scroll_row(const std::any& scroll, size_t row) = 0;
+    virtual void destroy_scroll_row(const std::any& row) = 0;
+    virtual void connect_scroll(
+        const std::any& scroll,
+        std::function<void(size_t first, size_t count)> scrolled) = 0;
+    virtual void page_processed(const std::any& page);
     virtual void widget_processed(const tanto::types::Widget& arg,
                                   const std::any& widget);
-    virtual void processed();
+    virtual void processed(const std::any& window);
+    void follow_log(const tanto::types::Widget& arg);
+    std::any process_field(const tanto::types::Widget& arg,
+                           const std::any& parent);
+    void process_item(const tanto::types::MultiValue& item,
+                      const std::any& container, const std::string& window);
     std::any process_container(const std::any& layout,
                                const tanto::types::Widget& arg);
+    std::any process_tabs(const tanto::types::Widget& arg,
+                          const std::any& parent);
+    std::any process_scroll(const tanto::types::Widget& arg,
+                            const std::any& parent);
     std::any process(const tanto::types::Widget& req, const std::any& parent);
 
     template<typename Function>
@@ -78,9 +151,75 @@ private:
         if(arg.has_group()) {
             tanto::types::Widget w{"group"};
             w.text = arg.group;
+            w.window = arg.window;
             return this->process_container(f(this->new_group(w, parent)), arg);
         }
 
         return this->process_container(f(parent), arg);
     }
+
+private:
+    struct Field { // A widget with "validate" rules
+        tanto::types::Widget arg;
+        std::any widget, error; // Error label below the widget
+        std::shared_ptr<const tanto::ValidationRule> rule;
+        bool touched{false}; // Errors are shown once changed or submitted
+    };
+
+    struct Page { // A "tabs" page built when first activated
+        tanto::types::Widget arg;
+        std::any layout;
+        bool built{false};
+    };
+
+    struct Deferred { // A widget with an id in a page not built yet
+        size_t page;
+        const tanto::types::Widget* arg; // In Page::arg
+    };
+
+    struct ScrollArea { // Rows are built only near the viewport
+        tanto::types::Widget arg; // Rows keep their edits when destroyed
+        std::any widget;
+        std::map<size_t, std::any> rows; // Built ones: index -> container
+    };
+
+    struct RowWidget { // A widget with an id in a scroll row
+        size_t scroll, row;
+        tanto::types::Widget* arg; // In ScrollArea::arg
+    };
+
+    // What a window owns besides its model, dropped when it's closed
+    struct WindowData {
+        std::deque<Page> pages; // Stable: pages can be nested
+        std::unordered_map<std::string, Deferred> deferred; // By id
+        std::deque<ScrollArea> scrolls;
+        std::unordered_map<std::string, RowWidget> rowwidgets; // By id
+        std::unordered_set<std::string> listed; // "files": id '\x1f' dir
+        std::vector<std::unique_ptr<tanto::LogTail>> logs;
+        std::unordered_map<std::string, Field> fields; // By id
+        std::unordered_map<std::string,
+                           std::shared_ptr<const tanto::ValidationRule>>
+            rules; // By id, from tanto::parse
+        std::unordered_map<std::string, tanto::types::Widget> headers; // By id
+        std::shared_ptr<const tanto::BindingGraph> bindings;
+        std::vector<std::shared_ptr<tanto::FdRead>> fdreads; // "fd:N" images
+    };
+
+    bool validate(const tanto::types::Widget& arg);
+    bool check_field(Field& f);
+    void apply_binding(const std::string& window, const tanto::Binding& b);
+    bool defer_page(const tanto::types::Widget& arg, const std::any& tabs);
+    void build_page(const std::string& window, size_t page);
+    void scroll_rows(const std::string& window, size_t scroll, size_t first,
+                     size_t count);
+    void unrealize_row(const std::string& window, ScrollArea& sa, size_t row,
+                       const std::any& container);
+
+private:
+    // Shared with producer threads, which may outlive the backend
+    std::shared_ptr<tanto::UpdateQueue> m_updates{
+        std::make_shared<tanto::UpdateQueue>()};
+
+    std::unordered_map<std::string, WindowData> m_windowdata;
+    std::unordered_map<std::string, ValueHandler> m_watchers; // By id
 };
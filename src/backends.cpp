@@ -0,0 +1,73 @@
+#include "backends.h"
+#include "error.h"
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(BACKEND_QT)
+    #include "backends/qt/backendimpl.h"
+#endif
+
+#if defined(BACKEND_GTK)
+    #include "backends/gtk/backendimpl.h"
+#endif
+
+#if defined(BACKEND_HEADLESS)
+    #include "backends/headless/backendimpl.h"
+#endif
+
+namespace tanto {
+
+const BackendList& backends() {
+    static const BackendList BACKENDS {
+#if defined(BACKEND_GTK)
+        {"gtk", BackendGtkImpl::version()},
+#endif
+#if defined(BACKEND_QT)
+            {"qt", BackendQtImpl::version()},
+#endif
+#if defined(BACKEND_HEADLESS)
+            {"headless", BackendHeadlessImpl::version()},
+#endif
+    };
+
+    return BACKENDS;
+}
+
+bool has_backend(std::string_view name) {
+    const BackendList& b = backends();
+
+    return std::find_if(b.begin(), b.end(), [name](const auto& x) {
+               return x.first == name;
+           }) != b.end();
+}
+
+std::string default_backend() {
+    if(const char* envbackend = std::getenv("TANTO_BACKEND"); envbackend)
+        return envbackend;
+    if(backends().empty())
+        return std::string{};
+    return std::string{backends().begin()->first};
+}
+
+BackendPtr new_backend(const std::string& name, int& argc, char** argv) {
+#if defined(BACKEND_GTK)
+    if(name == "gtk")
+        return std::make_unique<BackendGtkImpl>(argc, argv);
+#endif // defined(BACKEND_GTK)
+
+#if defined(BACKEND_QT)
+    if(name == "qt")
+        return std::make_unique<BackendQtImpl>(argc, argv);
+#endif // defined(BACKEND_QT)
+
+#if defined(BACKEND_HEADLESS)
+    if(name == "headless")
+        return std::make_unique<BackendHeadlessImpl>(argc, argv);
+#endif // defined(BACKEND_HEADLESS)
+
+    (void)argc;
+    (void)argv;
+    except("Backend '{}' not found", name);
+}
+
+} // namespace tanto
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "backend.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace tanto {
+
+using BackendPtr = std::unique_ptr<Backend>;
+using BackendList = std::vector<std::pair<std::string_view, std::string_view>>;
+
+const BackendList& backends(); // Name and toolkit version
+bool has_backend(std::string_view name);
+std::string default_backend();
+
+// 'argc' must outlive the backend (Qt keeps a reference to it)
+BackendPtr new_backend(const std::string& name, int& argc, char** argv);
+
+} // namespace tanto
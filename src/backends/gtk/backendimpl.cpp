@@ -1,20 +1,65 @@
 #include "backendimpl.h"
+#include "../../dirlist.h"
 #include "../../error.h"
+#include "../../httpcache.h"
+#include "../../imagecache.h"
 #include "../../tanto.h"
+#include "../../thumbnails.h"
+#include "../../trace.h"
 #include "../../utils.h"
+#include "../../workerpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <fmt/core.h>
+#include <functional>
+#include <optional>
+#include <utility>
 
 namespace {
 
 const std::string FORM_WIDGET = "__tanto_form_widget__";
 const std::string SPACE_WIDGET = "__tanto_space_widget__";
 constexpr guint DEFAULT_SPACING = 5;
+constexpr int IMAGE_DECODE_STEP = 256;
+constexpr int IMAGE_PREVIEW_INTERVAL = 100; // ms
+constexpr int GALLERY_SPACING = 8;
+
+enum GalleryColumn { GALLERY_PIXBUF = 0, GALLERY_LABEL, GALLERY_SOURCE };
+enum FilesColumn { FILES_ICON = 0, FILES_NAME, FILES_PATH, FILES_ISDIR };
+
+using PixbufCache = tanto::ImageCache<GdkPixbuf>;
 
 struct ImageInfo {
     tanto::types::Widget twidget;
-    GdkPixbuf* pixbuf;
+    PixbufCache::Ptr pixbuf;
     GtkWidget* widget;
     std::string filepath;
+    std::shared_ptr<const std::string> data; // Body, when not on disk
+    int target{0}, generation{0};            // Decoded width when not fixed
+};
+
+// Decodes the image while it's downloading, shared by the images showing
+// the same URL at the same size
+struct ImageStream {
+    GdkPixbufLoader* loader;
+    std::vector<std::pair<GtkWidget*, int>> viewers; // And their generation
+    std::chrono::steady_clock::time_point preview{};
+    bool fed{false}, failed{false}, closed{false};
+
+    ~ImageStream() {
+        if(!closed)
+            gdk_pixbuf_loader_close(loader, nullptr);
+        g_object_unref(loader);
+    }
+};
+
+struct GalleryInfo {
+    tanto::types::MultiValueList values;
+    std::vector<std::string> sources;
+    std::vector<bool> requested; // Thumbnails are loaded once visible
 };
 
 struct WidgetInfo {
@@ -23,6 +68,17 @@ struct WidgetInfo {
     tanto::Header header;
 };
 
+struct ScrollInfo { // A "scroll": a GtkLayout with the visible rows only
+    std::function<void(size_t, size_t)> scrolled;
+    int rowheight;
+    guint idle{0}; // Pending update, once per main loop iteration
+};
+
+struct FilesInfo { // Directories are listed when first expanded
+    std::string root;
+    std::unordered_map<std::string, GtkTreeIter> dirs; // Root excluded
+};
+
 struct TreeViewInfo {
     nlohmann::json row;
     std::string value;
@@ -33,8 +89,23 @@ using TreePathMap = std::unordered_map<std::string, TreeViewInfo>;
 std::unordered_map<GtkTreeStore*, TreePathMap> g_treepath;
 std::unordered_map<GtkWidget*, WidgetInfo> g_widgets;
 std::unordered_map<GtkWidget*, ImageInfo> g_images;
+std::unordered_map<std::string, std::weak_ptr<ImageStream>> g_streams;
+std::unordered_map<GtkWidget*, GalleryInfo> g_galleries;
+std::unordered_map<GtkWidget*, FilesInfo> g_files;
 std::unordered_map<GtkWidget*, int> g_ngridrows;
 
+template<typename Function>
+void gtkinvoke(Function f) { // Run 'f' in the GUI thread
+    g_idle_add(
+        +[](gpointer userdata) -> gboolean {
+            auto* fn = static_cast<std::function<void()>*>(userdata);
+            (*fn)();
+            delete fn;
+            return G_SOURCE_REMOVE;
+        },
+        new std::function<void()>(std::move(f)));
+}
+
 [[nodiscard]] GtkWidget* gtkcreate_label(const std::string& text,
                                          gfloat xalign = 0.0) {
     GtkWidget* w = gtk_label_new(text.c_str());
@@ -96,21 +167,32 @@ GtkWidget* setup_widget(GtkWidget* w, const tanto::types::Widget& arg,
     return w;
 }
 
+[[nodiscard]] const std::string& image_filepath(GtkWidget* w) {
+    ImageInfo& imageinfo = g_images.at(w);
+    if(imageinfo.filepath.empty() && imageinfo.data) // Write it when asked
+        imageinfo.filepath = tanto::save_temp(*imageinfo.data);
+    return imageinfo.filepath;
+}
+
 void destroy_image(GtkWidget* widget, gpointer) {
     assume(g_images.count(widget));
-    const ImageInfo& imageinfo = g_images[widget];
-
-    g_object_unref(imageinfo.pixbuf);
     g_images.erase(widget);
+    PixbufCache::instance().trim();
 }
 
+void load_image(GtkWidget* w);
+
 gboolean resize_image(GtkWidget* widget, GdkRectangle* allocation,
                       gpointer /* userdata */) {
     assume(g_images.count(widget));
 
-    const ImageInfo& imageinfo = g_images[widget];
-    double ratio = gdk_pixbuf_get_height(imageinfo.pixbuf) /
-                   static_cast<double>(gdk_pixbuf_get_width(imageinfo.pixbuf));
+    ImageInfo& imageinfo = g_images[widget];
+    if(!imageinfo.pixbuf) // Still loading
+        return false;
+
+    GdkPixbuf* pixbuf = imageinfo.pixbuf.get();
+    double ratio = gdk_pixbuf_get_height(pixbuf) /
+                   static_cast<double>(gdk_pixbuf_get_width(pixbuf));
     int w{}, h{};
 
     if(imageinfo.twidget.width) {
@@ -124,16 +206,247 @@ gboolean resize_image(GtkWidget* widget, GdkRectangle* allocation,
     else {
         w = allocation->width;
         h = std::ceil(allocation->width * ratio);
+
+        if(w > imageinfo.target) { // Grown past the decoded size
+            imageinfo.target = (w / IMAGE_DECODE_STEP + 1) * IMAGE_DECODE_STEP;
+            load_image(widget);
+        }
     }
 
+    tanto::trace::Span span{"scale", "image"};
     GdkPixbuf* pxbscaled =
-        gdk_pixbuf_scale_simple(imageinfo.pixbuf, w, h, GDK_INTERP_BILINEAR);
+        gdk_pixbuf_scale_simple(pixbuf, w, h, GDK_INTERP_BILINEAR);
 
     gtk_image_set_from_pixbuf(GTK_IMAGE(widget), pxbscaled);
     g_object_unref(pxbscaled);
     return false;
 }
 
+[[nodiscard]] GdkPixbufLoader* gtkloader_new(int w, int h) {
+    GdkPixbufLoader* loader = gdk_pixbuf_loader_new();
+    if(!w && !h)
+        return loader;
+
+    g_object_set_data(G_OBJECT(loader), "width", GINT_TO_POINTER(w));
+    g_object_set_data(G_OBJECT(loader), "height", GINT_TO_POINTER(h));
+
+    // Let the loader scale down (JPEG uses DCT scaling) when size is known
+    g_signal_connect(
+        loader, "size-prepared",
+        G_CALLBACK(+[](GdkPixbufLoader* self, gint sw, gint sh, gpointer) {
+            int w = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(self), "width"));
+            int h =
+                GPOINTER_TO_INT(g_object_get_data(G_OBJECT(self), "height"));
+
+            if(w && w < sw)
+                gdk_pixbuf_loader_set_size(
+                    self, w, std::ceil(w * sh / static_cast<double>(sw)));
+            else if(!w && h < sh)
+                gdk_pixbuf_loader_set_size(
+                    self, std::ceil(h * sw / static_cast<double>(sh)), h);
+        }),
+        nullptr);
+
+    return loader;
+}
+
+[[nodiscard]] GdkPixbuf* gtkloader_finish(GdkPixbufLoader* loader) {
+    if(!gdk_pixbuf_loader_close(loader, nullptr))
+        return nullptr;
+
+    GdkPixbuf* p = gdk_pixbuf_loader_get_pixbuf(loader);
+    return p ? GDK_PIXBUF(g_object_ref(p)) : nullptr;
+}
+
+[[nodiscard]] GdkPixbuf* read_image(const std::string& filepath, int w = 0,
+                                   int h = 0) {
+    int sw = 0, sh = 0;
+
+    // Let the loader scale down (JPEG uses DCT scaling) when size is known
+    if((w || h) && gdk_pixbuf_get_file_info(filepath.c_str(), &sw, &sh) &&
+       (w ? w < sw : h < sh))
+        return gdk_pixbuf_new_from_file_at_scale(
+            filepath.c_str(), w ? w : -1, h && !w ? h : -1, true, nullptr);
+
+    return gdk_pixbuf_new_from_file(filepath.c_str(), nullptr);
+}
+
+[[nodiscard]] GdkPixbuf* read_image(std::string_view data, int w, int h) {
+    GdkPixbufLoader* loader = gtkloader_new(w, h);
+    GdkPixbuf* p = nullptr;
+
+    if(gdk_pixbuf_loader_write(loader,
+                               reinterpret_cast<const guchar*>(data.data()),
+                               data.size(), nullptr))
+        p = gtkloader_finish(loader);
+    else
+        gdk_pixbuf_loader_close(loader, nullptr);
+
+    g_object_unref(loader);
+    return p;
+}
+
+[[nodiscard]] PixbufCache::Ptr decode_image(const tanto::Download& d,
+                                            const std::string& source, int w,
+                                            int h, bool persist,
+                                            ImageStream* stream) {
+    std::string key = d.filepath.empty() && d.data
+                          ? tanto::image_key(source, *d.data)
+                          : tanto::image_key(d.filepath);
+
+    if(!key.empty() && (w || h))
+        key += "@" + std::to_string(w) + "x" + std::to_string(h);
+
+    // Remote images with a fixed size keep a scaled copy in the HTTP cache
+    std::string variant =
+        persist ? tanto::HttpCache::instance().variant_path(d.filepath, w, h)
+                : std::string{};
+
+    return PixbufCache::instance().load(key, [&]() {
+        tanto::trace::Span span{"decode", "image"};
+        span.arg("source", source);
+        GdkPixbuf* p = nullptr;
+
+        if(!variant.empty())
+            p = read_image(variant);
+
+        if(!p) {
+            if(stream && stream->fed && !stream->failed &&
+               !stream->closed) { // Already decoded
+                stream->closed = true;
+                p = gtkloader_finish(stream->loader);
+            }
+
+            if(!p && d.filepath.empty() && d.data)
+                p = read_image(*d.data, w, h);
+            else if(!p)
+                p = read_image(d.filepath, w, h);
+
+            if(p && !variant.empty() &&
+               gdk_pixbuf_save(p, variant.c_str(), "png", nullptr, nullptr))
+                tanto::HttpCache::instance().add_variant(variant);
+        }
+
+        if(!p)
+            return std::make_pair(PixbufCache::Ptr{}, size_t{0});
+
+        return std::make_pair(
+            PixbufCache::Ptr{p, g_object_unref},
+            static_cast<size_t>(gdk_pixbuf_get_byte_length(p)));
+    });
+}
+
+void load_image(GtkWidget* w) {
+    ImageInfo& imageinfo = g_images.at(w);
+    const tanto::types::Widget& arg = imageinfo.twidget;
+    bool persist = arg.width || arg.height;
+    int width = persist ? arg.width : imageinfo.target;
+    int height = persist ? arg.height : 0;
+    int generation = ++imageinfo.generation;
+
+    g_object_ref(w); // Keep it alive until decoding completes
+    auto start = std::chrono::steady_clock::now();
+    std::string streamkey = fmt::format("{}@{}x{}", arg.text, width, height);
+    std::shared_ptr<ImageStream> stream = g_streams[streamkey].lock();
+    bool joined = stream != nullptr; // The first image feeds it
+
+    if(!joined) {
+        stream = std::make_shared<ImageStream>();
+        stream->loader = gtkloader_new(width, height);
+        g_streams[streamkey] = stream;
+    }
+
+    stream->viewers.emplace_back(w, generation);
+
+    // Runs in the downloader thread: show what's decoded so far
+    auto chunk = [stream](std::string_view data) {
+        if(stream->failed)
+            return;
+
+        stream->fed = true;
+        stream->failed = !gdk_pixbuf_loader_write(
+            stream->loader, reinterpret_cast<const guchar*>(data.data()),
+            data.size(), nullptr);
+
+        auto now = std::chrono::steady_clock::now();
+        auto interval = std::chrono::milliseconds{IMAGE_PREVIEW_INTERVAL};
+        if(stream->failed || now - stream->preview < interval)
+            return;
+
+        GdkPixbuf* p = gdk_pixbuf_loader_get_pixbuf(stream->loader);
+        if(!p)
+            return;
+
+        stream->preview = now;
+        PixbufCache::Ptr preview{gdk_pixbuf_copy(p), g_object_unref};
+
+        gtkinvoke([stream, preview]() {
+            for(const auto& [w, generation] : stream->viewers) {
+                auto it = g_images.find(w);
+                if(it == g_images.end() || it->second.generation != generation)
+                    continue;
+
+                it->second.pixbuf = preview;
+
+                GtkAllocation allocation;
+                gtk_widget_get_allocation(w, &allocation);
+                resize_image(w, &allocation, nullptr);
+            }
+        });
+    };
+
+    tanto::download_file(
+        arg.text,
+        [w, imagepath = arg.text, width, height, persist, generation, start,
+         stream, streamkey](const tanto::Download& d) {
+            auto decode = [w, imagepath, d, width, height, persist,
+                           generation, start, stream, streamkey]() {
+                PixbufCache::Ptr pixbuf =
+                    d.ok() ? decode_image(d, imagepath, width, height, persist,
+                                          stream.get())
+                           : nullptr;
+
+                gtkinvoke([w, imagepath, d, pixbuf, generation, start, stream,
+                           streamkey]() {
+                    // Downloaded: later images don't join it
+                    if(auto s = g_streams.find(streamkey);
+                       s != g_streams.end() && s->second.lock() == stream)
+                        g_streams.erase(s);
+
+                    // Skip it if the widget is gone or a larger decode is
+                    // pending
+                    if(auto it = g_images.find(w);
+                       it != g_images.end() &&
+                       it->second.generation == generation) {
+                        it->second.filepath = d.filepath;
+                        it->second.data = d.data;
+                        it->second.pixbuf = pixbuf;
+
+                        GtkAllocation allocation;
+                        gtk_widget_get_allocation(w, &allocation);
+                        resize_image(w, &allocation, nullptr);
+
+                        if(!pixbuf)
+                            spdlog::error("Cannot load image '{}'", imagepath);
+
+                        spdlog::debug(
+                            "image_loaded: '{}' in {}ms", imagepath,
+                            std::chrono::duration_cast<
+                                std::chrono::milliseconds>(
+                                std::chrono::steady_clock::now() - start)
+                                .count());
+                    }
+
+                    g_object_unref(w);
+                });
+            };
+
+            if(!tanto::WorkerPool::instance().push(decode)) // Stopped
+                gtkinvoke([w]() { g_object_unref(w); });
+        },
+        joined ? tanto::DownloadChunk{} : chunk);
+}
+
 [[nodiscard]] std::string gtktree_createpath(const std::string& lhs,
                                              size_t rhs) {
     if(lhs.empty())
@@ -227,6 +540,31 @@ gtktree_gettreeviewinfo(GtkWidget* w, gint* index = nullptr) {
     return std::nullopt;
 }
 
+// Makes the first row showing 'value' the current one
+void gtktree_select_value(GtkWidget* w, GtkTreeStore* model,
+                          const std::string& value) {
+    GtkTreePath* first = nullptr;
+
+    for(const auto& [path, tvi] : g_treepath[model]) {
+        if(tvi.value != value)
+            continue;
+
+        GtkTreePath* p = gtk_tree_path_new_from_string(path.c_str());
+
+        if(!first || gtk_tree_path_compare(p, first) < 0)
+            std::swap(p, first);
+        if(p)
+            gtk_tree_path_free(p);
+    }
+
+    if(!first)
+        return;
+
+    gtk_tree_view_expand_to_path(GTK_TREE_VIEW(w), first);
+    gtk_tree_view_set_cursor(GTK_TREE_VIEW(w), first, nullptr, false);
+    gtk_tree_path_free(first);
+}
+
 [[nodiscard]] GtkWidget* gtktree_new(Backend* self,
                                      const tanto::types::Widget& arg,
                                      const std::any& parent,
@@ -306,36 +644,436 @@ gtktree_gettreeviewinfo(GtkWidget* w, gint* index = nullptr) {
     return setup_widget(scroll, arg, parent);
 }
 
+// Listed entry of a row, std::nullopt for the placeholder
+[[nodiscard]] std::optional<tanto::DirEntry>
+gtkfiles_entry(GtkTreeModel* model, GtkTreeIter* iter) {
+    gchar* name = nullptr;
+    gchar* path = nullptr;
+    gboolean isdir = false;
+    gtk_tree_model_get(model, iter, FILES_NAME, &name, FILES_PATH, &path,
+                       FILES_ISDIR, &isdir, -1);
+
+    std::optional<tanto::DirEntry> e;
+    if(path)
+        e = tanto::DirEntry{name ? name : "", static_cast<bool>(isdir)};
+
+    g_free(name);
+    g_free(path);
+    return e;
+}
+
+// Unlisted directories have an empty child, for the expander: it's removed
+// by their first entries. Batches are sorted, but not with each other:
+// they're merged with the rows in a single walk.
+void gtkfiles_add(GtkWidget* w, const nlohmann::json& listings) {
+    FilesInfo& fi = g_files.at(w);
+    GtkTreeModel* model = gtk_tree_view_get_model(GTK_TREE_VIEW(w));
+    GtkTreeStore* store = GTK_TREE_STORE(model);
+
+    for(const auto& [dir, listing] : listings.items()) {
+        GtkTreeIter* parent = nullptr;
+
+        if(dir != fi.root) {
+            auto it = fi.dirs.find(dir);
+            if(it == fi.dirs.end())
+                continue;
+            parent = &it->second;
+        }
+
+        GtkTreeIter placeholder;
+        bool hasplaceholder = false;
+
+        if(parent &&
+           gtk_tree_model_iter_children(model, &placeholder, parent)) {
+            gchar* path = nullptr;
+            gtk_tree_model_get(model, &placeholder, FILES_PATH, &path, -1);
+            hasplaceholder = !path;
+            g_free(path);
+        }
+
+        GtkTreeIter next; // First row after the inserted ones
+        bool hasnext = gtk_tree_model_iter_children(model, &next, parent);
+        std::optional<tanto::DirEntry> nextentry;
+        if(hasnext)
+            nextentry = gtkfiles_entry(model, &next);
+
+        for(const nlohmann::json& e : listing.at("entries")) {
+            tanto::DirEntry entry{e[0].get<std::string>(), e[1].get<bool>()};
+
+            while(hasnext &&
+                  (!nextentry || !tanto::less_entry(entry, *nextentry))) {
+                hasnext = gtk_tree_model_iter_next(model, &next);
+                nextentry = hasnext ? gtkfiles_entry(model, &next)
+                                    : std::nullopt;
+            }
+
+            std::string path = tanto::join_path(dir, entry.name);
+
+            GtkTreeIter iter;
+            gtk_tree_store_insert_before(store, &iter, parent,
+                                         hasnext ? &next : nullptr);
+            gtk_tree_store_set(store, &iter, FILES_ICON,
+                               entry.isdir ? "folder" : "text-x-generic",
+                               FILES_NAME, entry.name.c_str(), FILES_PATH,
+                               path.c_str(), FILES_ISDIR, entry.isdir, -1);
+
+            if(entry.isdir) {
+                GtkTreeIter child;
+                gtk_tree_store_append(store, &child, &iter);
+                fi.dirs[path] = iter; // Tree stores' iterators persist
+            }
+        }
+
+        // After the entries, an expanded row would collapse otherwise
+        if(hasplaceholder)
+            gtk_tree_store_remove(store, &placeholder);
+    }
+}
+
+[[nodiscard]] nlohmann::json gtkfiles_current(GtkWidget* w) {
+    GtkTreeSelection* treeselection =
+        gtk_tree_view_get_selection(GTK_TREE_VIEW(w));
+    GtkTreeModel* model = nullptr;
+    GtkTreeIter iter;
+
+    if(!gtk_tree_selection_get_selected(treeselection, &model, &iter))
+        return nullptr;
+
+    gchar* path = nullptr;
+    gtk_tree_model_get(model, &iter, FILES_PATH, &path, -1);
+    if(!path)
+        return nullptr;
+
+    std::string res = path;
+    g_free(path);
+    return res;
+}
+
+[[nodiscard]] std::string gtkthumbnail_path(const std::string& uri) {
+    if(uri.empty())
+        return std::string{};
+
+    gchar* md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, uri.c_str(), -1);
+    std::string path = tanto::thumbnail_path(md5);
+    g_free(md5);
+    return path;
+}
+
+[[nodiscard]] GdkPixbuf* gtkthumbnail_load(const std::string& path,
+                                           int64_t mtime) {
+    if(path.empty() || !mtime || !std::filesystem::exists(path))
+        return nullptr;
+
+    GdkPixbuf* p = gdk_pixbuf_new_from_file(path.c_str(), nullptr);
+    if(!p)
+        return nullptr;
+
+    const gchar* thumbmtime = gdk_pixbuf_get_option(p, "tEXt::Thumb::MTime");
+    if(thumbmtime && thumbmtime == std::to_string(mtime))
+        return p;
+
+    g_object_unref(p);
+    return nullptr;
+}
+
+[[nodiscard]] GdkPixbuf* gtkthumbnail_create(const tanto::Download& d,
+                                             const std::string& uri,
+                                             const std::string& path,
+                                             int64_t mtime) {
+    constexpr int SIZE = tanto::THUMBNAIL_SIZE;
+    GdkPixbuf* p = nullptr;
+    int sw = 0, sh = 0;
+
+    if(d.filepath.empty() && d.data)
+        p = read_image(*d.data, 0, 0);
+    else if(gdk_pixbuf_get_file_info(d.filepath.c_str(), &sw, &sh) &&
+            (sw > SIZE || sh > SIZE)) // Let the loader scale it down
+        p = gdk_pixbuf_new_from_file_at_size(d.filepath.c_str(), SIZE, SIZE,
+                                             nullptr);
+    else
+        p = gdk_pixbuf_new_from_file(d.filepath.c_str(), nullptr);
+
+    if(!p)
+        return nullptr;
+
+    if(GdkPixbuf* oriented = gdk_pixbuf_apply_embedded_orientation(p);
+       oriented) {
+        g_object_unref(p);
+        p = oriented;
+    }
+
+    if(int w = gdk_pixbuf_get_width(p), h = gdk_pixbuf_get_height(p);
+       w > SIZE || h > SIZE) {
+        double ratio = std::min(SIZE / static_cast<double>(w),
+                                SIZE / static_cast<double>(h));
+        GdkPixbuf* scaled = gdk_pixbuf_scale_simple(
+            p, std::max(1, static_cast<int>(w * ratio)),
+            std::max(1, static_cast<int>(h * ratio)), GDK_INTERP_BILINEAR);
+        g_object_unref(p);
+        p = scaled;
+    }
+
+    if(path.empty() || !mtime) // Can't be checked later without one
+        return p;
+
+    // Other readers never see partial files, the spec wants them private
+    std::string tmppath = path + ".XXXXXX";
+    int fd = g_mkstemp(tmppath.data()); // Created as 0600
+    if(fd == -1)
+        return p;
+    g_close(fd, nullptr);
+
+    std::string thumbmtime = std::to_string(mtime);
+    gboolean saved = gdk_pixbuf_save(
+        p, tmppath.c_str(), "png", nullptr, "tEXt::Thumb::URI", uri.c_str(),
+        "tEXt::Thumb::MTime", thumbmtime.c_str(), nullptr);
+
+    if(!saved || std::rename(tmppath.c_str(), path.c_str()))
+        std::remove(tmppath.c_str());
+
+    return p;
+}
+
+void gtkgallery_set(GtkWidget* w, int row, GdkPixbuf* pixbuf) {
+    gtkinvoke([w, row, pixbuf]() {
+        if(pixbuf && g_galleries.count(w)) {
+            GtkTreeModel* model = gtk_icon_view_get_model(GTK_ICON_VIEW(w));
+            GtkTreeIter iter;
+
+            if(gtk_tree_model_iter_nth_child(model, &iter, nullptr, row))
+                gtk_list_store_set(GTK_LIST_STORE(model), &iter,
+                                   GALLERY_PIXBUF, pixbuf, -1);
+        }
+
+        if(pixbuf)
+            g_object_unref(pixbuf);
+        g_object_unref(w);
+    });
+}
+
+void gtkgallery_request(GtkWidget* w, int row) {
+    GalleryInfo& galleryinfo = g_galleries.at(w);
+    if(galleryinfo.requested[row])
+        return;
+
+    galleryinfo.requested[row] = true;
+    g_object_ref(w); // Keep it alive until the thumbnail is ready
+
+    auto load = [w, row, source = galleryinfo.sources[row]]() {
+        std::string uri = tanto::thumbnail_uri(source);
+        std::string path = gtkthumbnail_path(uri);
+        int64_t mtime = tanto::thumbnail_mtime(source); // 0 if remote
+
+        if(GdkPixbuf* p = gtkthumbnail_load(path, mtime); p) {
+            gtkgallery_set(w, row, p);
+            return;
+        }
+
+        tanto::download_file(source, [w, row, uri, path,
+                                      mtime](const tanto::Download& d) {
+            auto create = [w, row, d, uri, path, mtime]() {
+                if(!d.ok() || mtime) {
+                    gtkgallery_set(
+                        w, row,
+                        d.ok() ? gtkthumbnail_create(d, uri, path, mtime)
+                               : nullptr);
+                    return;
+                }
+
+                // Remote ones are valid while HttpCache keeps the same body
+                int64_t bodymtime = d.filepath.empty()
+                                        ? 0
+                                        : tanto::thumbnail_mtime(d.filepath);
+                GdkPixbuf* p = gtkthumbnail_load(path, bodymtime);
+                gtkgallery_set(
+                    w, row,
+                    p ? p : gtkthumbnail_create(d, uri, path, bodymtime));
+            };
+
+            if(!tanto::WorkerPool::instance().push(create)) // Stopped
+                gtkgallery_set(w, row, nullptr);
+        });
+    };
+
+    if(!tanto::WorkerPool::instance().push(load)) // Stopped
+        g_object_unref(w);
+}
+
+gboolean gtkgallery_draw(GtkWidget* w, cairo_t* /* cr */,
+                         gpointer /* userdata */) {
+    GtkTreePath *start = nullptr, *end = nullptr;
+    if(!gtk_icon_view_get_visible_range(GTK_ICON_VIEW(w), &start, &end))
+        return false;
+
+    int first = gtk_tree_path_get_indices(start)[0];
+    int last = gtk_tree_path_get_indices(end)[0];
+    gtk_tree_path_free(start);
+    gtk_tree_path_free(end);
+
+    for(int i = first; i <= last; i++)
+        gtkgallery_request(w, i);
+
+    return false;
+}
+
+[[nodiscard]] std::string gtkgallery_label(const std::string& source) {
+    std::string_view s = source;
+    if(size_t idx = s.find_first_of("?#"); idx != std::string_view::npos)
+        s = s.substr(0, idx); // Strip URL query and fragment
+
+    return std::filesystem::path{s}.filename().string();
+}
+
+// Connected (swapped) to the change signal of observed widgets
+void gtkvalue_changed(GtkWidget* w) {
+    const WidgetInfo& wi = g_widgets.at(w);
+    wi.self->value_changed(wi.twidget);
+}
+
+// Trims the buffer to the "lines" cap and follows the end unless scrolled back
+void gtklog_append(GtkWidget* w, const std::string& text) {
+    if(text.empty())
+        return;
+
+    GtkTextView* tv = GTK_TEXT_VIEW(w);
+    GtkTextBuffer* b = gtk_text_view_get_buffer(tv);
+    GtkAdjustment* adj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(tv));
+    bool follow = gtk_adjustment_get_value(adj) >=
+                  gtk_adjustment_get_upper(adj) -
+                      gtk_adjustment_get_page_size(adj) - 1;
+
+    gchar* valid = g_utf8_make_valid(text.c_str(), text.size());
+    GtkTextIter end;
+    gtk_text_buffer_get_end_iter(b, &end);
+    gtk_text_buffer_insert(b, &end, valid, -1);
+    g_free(valid);
+
+    int maxlines = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(w), "lines"));
+    if(int excess = gtk_text_buffer_get_line_count(b) - maxlines; excess > 0) {
+        GtkTextIter start, cut;
+        gtk_text_buffer_get_start_iter(b, &start);
+        gtk_text_buffer_get_iter_at_line(b, &cut, excess);
+        gtk_text_buffer_delete(b, &start, &cut);
+    }
+
+    if(follow) // Only the lines around the mark need to be laid out
+        gtk_text_view_scroll_mark_onscreen(tv,
+                                           gtk_text_buffer_get_mark(b, "tail"));
+}
+
+// Resizing rows while allocating would queue another allocation
+void gtkscroll_schedule(GtkWidget* layout) {
+    auto* si = static_cast<ScrollInfo*>(
+        g_object_get_data(G_OBJECT(layout), "scroll"));
+    if(!si || si->idle)
+        return;
+
+    si->idle = g_idle_add(
+        +[](gpointer userdata) -> gboolean {
+            auto* layout = static_cast<GtkWidget*>(userdata);
+            auto* si = static_cast<ScrollInfo*>(
+                g_object_get_data(G_OBJECT(layout), "scroll"));
+            si->idle = 0;
+
+            int width = gtk_widget_get_allocated_width(layout);
+            GList* rows = gtk_container_get_children(GTK_CONTAINER(layout));
+            for(GList* r = rows; r; r = r->next)
+                gtk_widget_set_size_request(GTK_WIDGET(r->data), width,
+                                            si->rowheight);
+            g_list_free(rows);
+
+            GtkAdjustment* adj =
+                gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(layout));
+            auto h = static_cast<size_t>(si->rowheight);
+            si->scrolled(
+                static_cast<size_t>(gtk_adjustment_get_value(adj)) / h,
+                static_cast<size_t>(gtk_adjustment_get_page_size(adj)) / h +
+                    1);
+            return G_SOURCE_REMOVE;
+        },
+        layout);
+}
+
+void gtkprogress_update(GtkWidget* w) {
+    int value = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(w), "value"));
+    int max = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(w), "max"));
+
+    if(max > 0) {
+        gtk_progress_bar_set_fraction(
+            GTK_PROGRESS_BAR(w),
+            std::clamp(value / static_cast<double>(max), 0.0, 1.0));
+    }
+    else // Indeterminate, move on each update
+        gtk_progress_bar_pulse(GTK_PROGRESS_BAR(w));
+}
+
 } // namespace
 
 BackendGtkImpl::BackendGtkImpl(int& argc, char** argv): Backend{argc, argv} {
     gtk_init(&argc, &argv);
+
+    this->updates()->set_notify([this, alive = this->alive()]() {
+        // From the producer's thread, the idle may run after we're gone
+        gtkinvoke([this, alive]() {
+            if(!alive.expired())
+                this->schedule_updates();
+        });
+    });
 }
 
+BackendGtkImpl::~BackendGtkImpl() {
+    this->updates()->set_notify(nullptr);
+    m_alive.reset(); // Queued idles and tick callbacks become no-ops
+}
+
+std::weak_ptr<bool> BackendGtkImpl::alive() const { return m_alive; }
+
 std::string_view BackendGtkImpl::version() {
     static const std::string VERSION = fmt::format(
         "{}.{}.{}", GTK_MAJOR_VERSION, GTK_MINOR_VERSION, GTK_MICRO_VERSION);
     return VERSION;
 }
 
-int BackendGtkImpl::run() const {
+int BackendGtkImpl::run() {
     gtk_main();
+    this->close_all(); // Don't leave them around when embedded
     return 0;
 }
 
-void BackendGtkImpl::exit() {
-    g_object_unref(G_OBJECT(m_mainwindow));
-    gtk_main_quit();
-}
+void BackendGtkImpl::exit() { gtk_main_quit(); }
 
 nlohmann::json BackendGtkImpl::get_model_data(const tanto::types::Widget& arg,
                                               const std::any& w) {
+    if(arg.type == "log") // Output, not a value
+        return nullptr;
+
     auto* gtkw = std::any_cast<GtkWidget*>(w);
 
     if(GTK_IS_SCROLLED_WINDOW(gtkw)) {
         GtkWidget* gtkw2 = gtk_bin_get_child(GTK_BIN(gtkw));
         assume(gtkw2);
 
+        if(GTK_IS_ICON_VIEW(gtkw2)) {
+            GList* selected =
+                gtk_icon_view_get_selected_items(GTK_ICON_VIEW(gtkw2));
+            if(!selected)
+                return nullptr;
+
+            auto* path = static_cast<GtkTreePath*>(selected->data);
+            int index = gtk_tree_path_get_indices(path)[0];
+            g_list_free_full(
+                selected, reinterpret_cast<GDestroyNotify>(gtk_tree_path_free));
+
+            return std::visit(
+                tanto::utils::Overload{
+                    [&](tanto::types::Widget& a) { return a.get_id(); },
+                    [&](std::string& a) { return a; }},
+                g_galleries.at(gtkw2).values.at(index));
+        }
+
+        if(arg.type == "files")
+            return gtkfiles_current(gtkw2);
+
         if(GTK_IS_TREE_VIEW(gtkw2)) {
             gint index = 0;
             auto tvi = gtktree_gettreeviewinfo(gtkw2, &index);
@@ -353,7 +1091,7 @@ nlohmann::json BackendGtkImpl::get_model_data(const tanto::types::Widget& arg,
 
         if(GTK_IS_IMAGE(gtkw2)) {
             assume(g_images.count(gtkw2));
-            return g_images[gtkw2].filepath;
+            return image_filepath(gtkw2);
         }
     }
     else if(GTK_IS_TEXT_VIEW(gtkw)) {
@@ -376,18 +1114,209 @@ nlohmann::json BackendGtkImpl::get_model_data(const tanto::types::Widget& arg,
             gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(gtkw)));
     else if(GTK_IS_SPIN_BUTTON(gtkw))
         return gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(gtkw));
+    else if(GTK_IS_PROGRESS_BAR(gtkw))
+        return GPOINTER_TO_INT(g_object_get_data(G_OBJECT(gtkw), "value"));
 
     return nullptr;
 }
 
+void BackendGtkImpl::schedule_updates() {
+    if(m_ticking)
+        return;
+
+    if(m_toplevels.empty()) { // Nothing to paint
+        this->apply_updates();
+        return;
+    }
+
+    // Tick callbacks run once per frame, before painting
+    m_ticking = true;
+
+    using Tick = std::pair<BackendGtkImpl*, std::weak_ptr<bool>>;
+
+    gtk_widget_add_tick_callback(
+        m_toplevels.begin()->second,
+        +[](GtkWidget*, GdkFrameClock*, gpointer userdata) -> gboolean {
+            auto* tick = static_cast<Tick*>(userdata);
+            if(!tick->second.expired())
+                tick->first->apply_updates();
+            return G_SOURCE_REMOVE;
+        },
+        new Tick{this, this->alive()},
+        +[](gpointer userdata) { // Even when the window is destroyed first
+            std::unique_ptr<Tick> tick{static_cast<Tick*>(userdata)};
+            if(tick->second.expired())
+                return;
+
+            BackendGtkImpl* backend = tick->first;
+            backend->m_ticking = false;
+
+            if(!backend->updates()->empty()) {
+                gtkinvoke([backend, alive = tick->second]() {
+                    if(!alive.expired())
+                        backend->schedule_updates();
+                });
+            }
+        });
+}
+
+void BackendGtkImpl::update_widget(const std::string& type,
+                                   const std::any& widget,
+                                   std::string_view property,
+                                   const nlohmann::json& value) {
+    using namespace tanto::utils::string_literals;
+
+    auto* w = std::any_cast<GtkWidget*>(widget);
+    // The view, not its scrolled window
+    if(type == "log" || type == "files" || type == "list" || type == "tree")
+        w = gtk_bin_get_child(GTK_BIN(w));
+
+    switch(tanto::utils::fnv1a_32(property)) {
+        case "text"_fnv1a_32: {
+            std::string text = tanto::stringify(value);
+
+            if(GTK_IS_LABEL(w))
+                gtk_label_set_text(GTK_LABEL(w), text.c_str());
+            else if(GTK_IS_SPIN_BUTTON(w))
+                break;
+            else if(GTK_IS_ENTRY(w))
+                gtk_entry_set_text(GTK_ENTRY(w), text.c_str());
+            else if(GTK_IS_TEXT_VIEW(w)) {
+                gtk_text_buffer_set_text(
+                    gtk_text_view_get_buffer(GTK_TEXT_VIEW(w)), text.c_str(),
+                    text.size());
+            }
+            else if(GTK_IS_BUTTON(w))
+                gtk_button_set_label(GTK_BUTTON(w), text.c_str());
+            else if(GTK_IS_PROGRESS_BAR(w)) {
+                gtk_progress_bar_set_text(GTK_PROGRESS_BAR(w),
+                                          text.empty() ? nullptr
+                                                       : text.c_str());
+            }
+            else
+                break;
+            return;
+        }
+
+        case "value"_fnv1a_32:
+            if(GTK_IS_SPIN_BUTTON(w))
+                gtk_spin_button_set_value(GTK_SPIN_BUTTON(w), value.get<int>());
+            else if(GTK_IS_PROGRESS_BAR(w)) {
+                g_object_set_data(G_OBJECT(w), "value",
+                                  GINT_TO_POINTER(value.get<int>()));
+                gtkprogress_update(w);
+            }
+            else
+                break;
+            return;
+
+        case "max"_fnv1a_32:
+            if(GTK_IS_SPIN_BUTTON(w)) {
+                double min = 0;
+                gtk_spin_button_get_range(GTK_SPIN_BUTTON(w), &min, nullptr);
+                gtk_spin_button_set_range(GTK_SPIN_BUTTON(w), min,
+                                          value.get<int>());
+            }
+            else if(GTK_IS_PROGRESS_BAR(w)) {
+                g_object_set_data(G_OBJECT(w), "max",
+                                  GINT_TO_POINTER(value.get<int>()));
+                gtkprogress_update(w);
+            }
+            else
+                break;
+            return;
+
+        case "append"_fnv1a_32:
+            if(type == "log") {
+                gtklog_append(w, value.get<std::string>());
+                return;
+            }
+            break;
+
+        case "items"_fnv1a_32:
+            if((type == "list" || type == "tree") &&
+               g_widgets.at(w).header.empty()) { // Rows without a header only
+                auto* model = GTK_TREE_STORE(
+                    gtk_tree_view_get_model(GTK_TREE_VIEW(w)));
+                tanto::types::MultiValueList items =
+                    tanto::types::items_from_json(value);
+                std::vector<std::string> selections;
+
+                // The current row stays current, if it's still there
+                std::optional<TreeViewInfo> current =
+                    gtktree_gettreeviewinfo(w);
+
+                g_treepath[model].clear();
+                gtk_tree_store_clear(model);
+                gtktree_add(model, items, selections, {}, nullptr, {},
+                            type == "tree");
+
+                if(current)
+                    gtktree_select_value(w, model, current->value);
+                return;
+            }
+            break;
+
+        case "entries"_fnv1a_32:
+            if(type == "files") {
+                gtkfiles_add(w, value);
+                return;
+            }
+            break;
+
+        case "checked"_fnv1a_32:
+            if(GTK_IS_TOGGLE_BUTTON(w)) { // Not an user action, no events
+                g_signal_handlers_block_matched(w, G_SIGNAL_MATCH_DATA, 0, 0,
+                                                nullptr, nullptr, this);
+                gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(w),
+                                             value.get<bool>());
+                g_signal_handlers_unblock_matched(w, G_SIGNAL_MATCH_DATA, 0, 0,
+                                                  nullptr, nullptr, this);
+                return;
+            }
+            break;
+
+        case "enabled"_fnv1a_32:
+            gtk_widget_set_sensitive(w, value.get<bool>());
+            return;
+
+        case "visible"_fnv1a_32: {
+            // The scrolled window of logs, the frame of groups
+            auto* top = std::any_cast<GtkWidget*>(widget);
+            if(GtkWidget* p = gtk_widget_get_parent(top); p && GTK_IS_FRAME(p))
+                top = p;
+
+            gtk_widget_set_visible(top, value.get<bool>());
+            return;
+        }
+
+        default: break;
+    }
+
+    spdlog::warn("Update: unsupported property '{}' for '{}'", property, type);
+}
+
 void BackendGtkImpl::widget_processed(const tanto::types::Widget& arg,
                                       const std::any& widget) {
     if(!arg.has_id())
         return;
-    g_widgets[std::any_cast<GtkWidget*>(widget)] = {this, arg, {}};
+
+    auto* w = std::any_cast<GtkWidget*>(widget);
+    if(!g_widgets.insert_or_assign(w, WidgetInfo{this, arg, {}}).second)
+        return;
+
+    // Scroll rows come and go
+    g_signal_connect(
+        w, "destroy",
+        G_CALLBACK(+[](GtkWidget* self, gpointer) { g_widgets.erase(self); }),
+        nullptr);
 }
 
-void BackendGtkImpl::processed() { gtk_widget_show_all(m_mainwindow); }
+void BackendGtkImpl::processed(const std::any& window) {
+    GtkWidget* w = std::any_cast<GtkWidget*>(window);
+    gtk_widget_show_all(w);
+    gtk_window_present(GTK_WINDOW(w));
+}
 
 void BackendGtkImpl::filechooser_show(GtkFileChooserAction action,
                                       const std::string& title,
@@ -426,21 +1355,56 @@ void BackendGtkImpl::filechooser_show(GtkFileChooserAction action,
 }
 
 std::any BackendGtkImpl::new_window(const tanto::types::Window& arg) {
-    m_mainwindow = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-    g_signal_connect(G_OBJECT(m_mainwindow), "destroy", gtk_main_quit, nullptr);
-
-    gtk_window_set_title(GTK_WINDOW(m_mainwindow), arg.title.c_str());
-    gtk_window_set_default_size(GTK_WINDOW(m_mainwindow), arg.width,
-                                arg.height);
-    gtk_window_set_resizable(GTK_WINDOW(m_mainwindow), !arg.fixed);
+    GtkWidget* w = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    g_object_set_data_full(G_OBJECT(w), "window", g_strdup(arg.id.c_str()),
+                           g_free);
+
+    // Closed by the user, forget it before the backend closes it again
+    g_signal_connect(
+        G_OBJECT(w), "destroy",
+        G_CALLBACK(+[](GtkWidget* self, BackendGtkImpl* backend) {
+            std::string id = static_cast<const char*>(
+                g_object_get_data(G_OBJECT(self), "window"));
+
+            backend->m_toplevels.erase(id);
+            backend->close(id);
+        }),
+        this);
+
+    gtk_window_set_title(GTK_WINDOW(w), arg.title.c_str());
+    gtk_window_set_default_size(GTK_WINDOW(w), arg.width, arg.height);
+    gtk_window_set_resizable(GTK_WINDOW(w), !arg.fixed);
 
     if(!arg.x && !arg.y)
-        gtk_window_set_position(GTK_WINDOW(m_mainwindow), GTK_WIN_POS_CENTER);
+        gtk_window_set_position(GTK_WINDOW(w), GTK_WIN_POS_CENTER);
     else
-        gtk_window_move(GTK_WINDOW(m_mainwindow), arg.x, arg.y);
+        gtk_window_move(GTK_WINDOW(w), arg.x, arg.y);
+
+    if(tanto::trace::enabled()) {
+        g_signal_connect_after(
+            G_OBJECT(w), "draw",
+            G_CALLBACK(+[](GtkWidget* self, cairo_t*, gpointer) -> gboolean {
+                tanto::trace::instant("first paint", "backend");
+                g_signal_handlers_disconnect_matched(
+                    self, G_SIGNAL_MATCH_DATA, 0, 0, nullptr, nullptr,
+                    GINT_TO_POINTER(1));
+                return false;
+            }),
+            GINT_TO_POINTER(1));
+    }
+
+    m_toplevels[arg.id] = w; // Presented by processed(), once it's complete
+    return w;
+}
+
+void BackendGtkImpl::destroy_window(const std::string& window) {
+    auto it = m_toplevels.find(window);
+    if(it == m_toplevels.end()) // Already destroyed
+        return;
 
-    gtk_window_present(GTK_WINDOW(m_mainwindow));
-    return m_mainwindow;
+    GtkWidget* w = it->second;
+    m_toplevels.erase(it);
+    gtk_widget_destroy(w);
 }
 
 void BackendGtkImpl::message(const std::string& title, const std::string& text,
@@ -572,6 +1536,10 @@ std::any BackendGtkImpl::new_input(const tanto::types::Widget& arg,
         GtkTextBuffer* b = gtk_text_view_get_buffer(GTK_TEXT_VIEW(w));
         assume(b);
         gtk_text_buffer_set_text(b, arg.text.c_str(), arg.text.size());
+
+        if(this->observed(arg))
+            g_signal_connect_swapped(b, "changed",
+                                     G_CALLBACK(gtkvalue_changed), w);
     }
     else {
         w = gtk_entry_new();
@@ -580,11 +1548,39 @@ std::any BackendGtkImpl::new_input(const tanto::types::Widget& arg,
                 GTK_ENTRY(w), arg.prop<std::string>("placeholder").c_str());
         if(!arg.text.empty())
             gtk_entry_set_text(GTK_ENTRY(w), arg.text.c_str());
+
+        if(this->observed(arg))
+            g_signal_connect_swapped(w, "changed",
+                                     G_CALLBACK(gtkvalue_changed), w);
     }
 
     return setup_widget(w, arg, parent);
 }
 
+std::any BackendGtkImpl::new_log(const tanto::types::Widget& arg,
+                                 const std::any& parent) {
+    GtkWidget* w = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(w), false);
+    gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(w), false);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(w), true);
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(w), GTK_WRAP_NONE);
+    g_object_set_data(
+        G_OBJECT(w), "lines",
+        GINT_TO_POINTER(arg.prop<int>("lines", tanto::LOG_MAX_LINES)));
+
+    GtkTextBuffer* b = gtk_text_view_get_buffer(GTK_TEXT_VIEW(w));
+    GtkTextIter end;
+    gtk_text_buffer_get_end_iter(b, &end);
+    gtk_text_buffer_create_mark(b, "tail", &end, false); // Stays at the end
+    gtklog_append(w, arg.text);
+
+    GtkWidget* scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_container_add(GTK_CONTAINER(scroll), w);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    return setup_widget(scroll, arg, parent);
+}
+
 std::any BackendGtkImpl::new_number(const tanto::types::Widget& arg,
                                     const std::any& parent) {
     GtkWidget* w = gtk_spin_button_new_with_range(
@@ -592,18 +1588,34 @@ std::any BackendGtkImpl::new_number(const tanto::types::Widget& arg,
         arg.prop<int>("max", tanto::NUMBER_MAX), arg.prop<int>("step", 1));
 
     gtk_spin_button_set_value(GTK_SPIN_BUTTON(w), arg.value);
+
+    if(this->observed(arg))
+        g_signal_connect_swapped(w, "value-changed",
+                                 G_CALLBACK(gtkvalue_changed), w);
+
     setup_widget(w, arg, parent);
     return w;
 }
 
 std::any BackendGtkImpl::new_image(const tanto::types::Widget& arg,
                                    const std::any& parent) {
-    std::string filepath = tanto::download_file(arg.text);
-    GdkPixbuf* pixbuf = gdk_pixbuf_new_from_file(filepath.c_str(), nullptr);
-    assume(pixbuf);
+    GtkWidget* w = gtk_image_new(); // Placeholder, sized by setup_widget()
+    g_images[w] = ImageInfo{arg, nullptr, w, {}};
+
+    if(!arg.width && !arg.height) { // It can't be wider than the screen
+        GdkDisplay* display = gdk_display_get_default();
+        GdkMonitor* monitor = gdk_display_get_primary_monitor(display);
+        if(!monitor)
+            monitor = gdk_display_get_monitor(display, 0);
+
+        GdkRectangle geometry{};
+        if(monitor)
+            gdk_monitor_get_geometry(monitor, &geometry);
+        g_images[w].target = geometry.width;
+    }
 
-    GtkWidget* w = gtk_image_new();
-    g_images[w] = ImageInfo{arg, pixbuf, w, filepath};
+    if(!arg.text.empty())
+        load_image(w);
 
     GtkWidget* eventbox = gtk_event_box_new();
     gtk_container_add(GTK_CONTAINER(eventbox), w);
@@ -622,7 +1634,7 @@ std::any BackendGtkImpl::new_image(const tanto::types::Widget& arg,
                 GtkWidget* image = gtk_bin_get_child(GTK_BIN(sender));
                 if(event->type == GDK_2BUTTON_PRESS)
                     self->double_clicked(g_widgets.at(sender).twidget,
-                                         g_images.at(image).filepath);
+                                         image_filepath(image));
             }),
             this);
     }
@@ -653,6 +1665,9 @@ std::any BackendGtkImpl::new_check(const tanto::types::Widget& arg,
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(w),
                                  arg.prop<bool>("checked"));
 
+    if(this->observed(arg))
+        g_signal_connect_swapped(w, "toggled", G_CALLBACK(gtkvalue_changed), w);
+
     if(arg.has_id()) {
         g_signal_connect(
             w, "clicked",
@@ -667,6 +1682,20 @@ std::any BackendGtkImpl::new_check(const tanto::types::Widget& arg,
     return setup_widget(w, arg, parent);
 }
 
+std::any BackendGtkImpl::new_progress(const tanto::types::Widget& arg,
+                                      const std::any& parent) {
+    GtkWidget* w = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(w), true);
+    if(!arg.text.empty())
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(w), arg.text.c_str());
+
+    int max = arg.prop<int>("max", tanto::PROGRESS_MAX);
+    g_object_set_data(G_OBJECT(w), "value", GINT_TO_POINTER(arg.value));
+    g_object_set_data(G_OBJECT(w), "max", GINT_TO_POINTER(max));
+    gtkprogress_update(w);
+    return setup_widget(w, arg, parent);
+}
+
 std::any BackendGtkImpl::new_list(const tanto::types::Widget& arg,
                                   const std::any& parent) {
     return gtktree_new(this, arg, parent, false);
@@ -675,6 +1704,156 @@ std::any BackendGtkImpl::new_tree(const tanto::types::Widget& arg,
                                   const std::any& parent) {
     return gtktree_new(this, arg, parent);
 }
+std::any BackendGtkImpl::new_gallery(const tanto::types::Widget& arg,
+                                     const std::any& parent) {
+    GtkListStore* model = gtk_list_store_new(3, GDK_TYPE_PIXBUF, G_TYPE_STRING,
+                                             G_TYPE_STRING);
+    GdkPixbuf* placeholder =
+        gdk_pixbuf_new(GDK_COLORSPACE_RGB, true, 8, tanto::THUMBNAIL_SIZE,
+                       tanto::THUMBNAIL_SIZE);
+    gdk_pixbuf_fill(placeholder, 0);
+
+    GtkWidget* w = gtk_icon_view_new_with_model(GTK_TREE_MODEL(model));
+    GalleryInfo& galleryinfo = g_galleries[w];
+    galleryinfo.values = arg.items;
+
+    for(const tanto::types::MultiValue& item : arg.items) {
+        const std::string& source = std::visit(
+            tanto::utils::Overload{
+                [](const tanto::types::Widget& a) -> const std::string& {
+                    return a.text;
+                },
+                [](const std::string& a) -> const std::string& { return a; }},
+            item);
+
+        gtk_list_store_insert_with_values(
+            model, nullptr, -1, GALLERY_PIXBUF, placeholder, GALLERY_LABEL,
+            gtkgallery_label(source).c_str(), GALLERY_SOURCE, source.c_str(),
+            -1);
+
+        galleryinfo.sources.push_back(source);
+    }
+
+    galleryinfo.requested.resize(galleryinfo.sources.size());
+    g_object_unref(placeholder);
+    g_object_unref(model);
+
+    gtk_icon_view_set_pixbuf_column(GTK_ICON_VIEW(w), GALLERY_PIXBUF);
+    gtk_icon_view_set_text_column(GTK_ICON_VIEW(w), GALLERY_LABEL);
+    gtk_icon_view_set_tooltip_column(GTK_ICON_VIEW(w), GALLERY_SOURCE);
+    gtk_icon_view_set_selection_mode(GTK_ICON_VIEW(w), GTK_SELECTION_SINGLE);
+    gtk_icon_view_set_item_width(GTK_ICON_VIEW(w), tanto::THUMBNAIL_SIZE);
+    gtk_icon_view_set_spacing(GTK_ICON_VIEW(w), GALLERY_SPACING);
+
+    g_widgets[w] = WidgetInfo{this, arg, {}}; // Create internal entry too
+
+    // Thumbnails are requested when their cell is painted
+    g_signal_connect(w, "draw", G_CALLBACK(gtkgallery_draw), nullptr);
+    g_signal_connect(w, "destroy", G_CALLBACK(+[](GtkWidget* sender, gpointer) {
+                         g_galleries.erase(sender);
+                     }),
+                     nullptr);
+
+    if(arg.has_id()) {
+        g_signal_connect(
+            w, "item-activated",
+            G_CALLBACK(+[](GtkIconView* sender, GtkTreePath* path,
+                           BackendGtkImpl* self) {
+                auto* iconview = GTK_WIDGET(sender);
+                int index = gtk_tree_path_get_indices(path)[0];
+                self->selected(g_widgets.at(iconview).twidget, index,
+                               g_galleries.at(iconview).values.at(index));
+            }),
+            this);
+    }
+
+    GtkWidget* scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_container_add(GTK_CONTAINER(scroll), w);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    return setup_widget(scroll, arg, parent);
+}
+
+std::any BackendGtkImpl::new_files(const tanto::types::Widget& arg,
+                                   const std::any& parent) {
+    GtkTreeStore* model = gtk_tree_store_new(4, G_TYPE_STRING, G_TYPE_STRING,
+                                             G_TYPE_STRING, G_TYPE_BOOLEAN);
+    GtkWidget* w = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+    g_object_unref(model);
+
+    GtkTreeViewColumn* column = gtk_tree_view_column_new();
+    GtkCellRenderer* icon = gtk_cell_renderer_pixbuf_new();
+    GtkCellRenderer* name = gtk_cell_renderer_text_new();
+    gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_pack_start(column, icon, false);
+    gtk_tree_view_column_add_attribute(column, icon, "icon-name", FILES_ICON);
+    gtk_tree_view_column_pack_start(column, name, true);
+    gtk_tree_view_column_add_attribute(column, name, "text", FILES_NAME);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(w), column);
+    gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(w), false);
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(w), true);
+
+    g_widgets[w] = WidgetInfo{this, arg, {}}; // Create internal entry too
+    g_files[w] = FilesInfo{tanto::files_root(arg), {}};
+
+    g_signal_connect(w, "destroy", G_CALLBACK(+[](GtkWidget* sender, gpointer) {
+                         g_files.erase(sender);
+                     }),
+                     nullptr);
+
+    g_signal_connect(
+        w, "test-expand-row",
+        G_CALLBACK(+[](GtkTreeView* sender, GtkTreeIter* iter, GtkTreePath*,
+                       BackendGtkImpl* self) -> gboolean {
+            gchar* path = nullptr;
+            gtk_tree_model_get(gtk_tree_view_get_model(sender), iter,
+                               FILES_PATH, &path, -1);
+
+            if(path) {
+                self->expanded(g_widgets.at(GTK_WIDGET(sender)).twidget, path);
+                g_free(path);
+            }
+
+            return false; // Entries arrive later
+        }),
+        this);
+
+    g_signal_connect(
+        w, "row-activated",
+        G_CALLBACK(+[](GtkTreeView* sender, GtkTreePath* treepath,
+                       GtkTreeViewColumn*, BackendGtkImpl* self) {
+            GtkTreeModel* model = gtk_tree_view_get_model(sender);
+            GtkTreeIter iter;
+            if(!gtk_tree_model_get_iter(model, &iter, treepath))
+                return;
+
+            gchar* path = nullptr;
+            gboolean isdir = false;
+            gtk_tree_model_get(model, &iter, FILES_PATH, &path, FILES_ISDIR,
+                               &isdir, -1);
+            if(!path) // A placeholder
+                return;
+
+            if(!isdir) {
+                self->selected(g_widgets.at(GTK_WIDGET(sender)).twidget,
+                               std::string{path});
+            }
+            else if(gtk_tree_view_row_expanded(sender, treepath))
+                gtk_tree_view_collapse_row(sender, treepath);
+            else
+                gtk_tree_view_expand_row(sender, treepath, false);
+
+            g_free(path);
+        }),
+        this);
+
+    GtkWidget* scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_container_add(GTK_CONTAINER(scroll), w);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    return setup_widget(scroll, arg, parent);
+}
+
 std::any BackendGtkImpl::new_tabs(const tanto::types::Widget& arg,
                                   const std::any& parent) {
     return setup_widget(gtk_notebook_new(), arg, parent);
@@ -708,3 +1887,91 @@ std::any BackendGtkImpl::new_group(const tanto::types::Widget& arg,
                                    const std::any& parent) {
     return setup_widget(gtk_frame_new(arg.text.c_str()), arg, parent);
 }
+
+std::any BackendGtkImpl::new_scroll(const tanto::types::Widget& arg,
+                                    const std::any& parent) {
+    int rowheight = arg.prop<int>("rowheight", tanto::SCROLL_ROW_HEIGHT);
+
+    GtkWidget* w = gtk_layout_new(nullptr, nullptr);
+    gtk_layout_set_size(
+        GTK_LAYOUT(w), 1,
+        static_cast<guint>(std::min<int64_t>(
+            static_cast<int64_t>(rowheight) * arg.items.size(), G_MAXINT)));
+    g_object_set_data(G_OBJECT(w), "rowheight", GINT_TO_POINTER(rowheight));
+
+    GtkWidget* scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_container_add(GTK_CONTAINER(scroll), w);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    return setup_widget(scroll, arg, parent);
+}
+
+std::any BackendGtkImpl::new_scroll_row(const std::any& scroll, size_t row) {
+    GtkWidget* layout =
+        gtk_bin_get_child(GTK_BIN(std::any_cast<GtkWidget*>(scroll)));
+    int rowheight =
+        GPOINTER_TO_INT(g_object_get_data(G_OBJECT(layout), "rowheight"));
+
+    GtkWidget* w = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_widget_set_size_request(w, gtk_widget_get_allocated_width(layout),
+                                rowheight);
+    gtk_layout_put(GTK_LAYOUT(layout), w, 0, static_cast<int>(row) * rowheight);
+    return w;
+}
+
+void BackendGtkImpl::destroy_scroll_row(const std::any& row) {
+    gtk_widget_destroy(std::any_cast<GtkWidget*>(row));
+}
+
+void BackendGtkImpl::connect_scroll(
+    const std::any& scroll,
+    std::function<void(size_t first, size_t count)> scrolled) {
+    GtkWidget* layout =
+        gtk_bin_get_child(GTK_BIN(std::any_cast<GtkWidget*>(scroll)));
+
+    g_object_set_data_full(
+        G_OBJECT(layout), "scroll",
+        new ScrollInfo{std::move(scrolled),
+                       GPOINTER_TO_INT(
+                           g_object_get_data(G_OBJECT(layout), "rowheight"))},
+        +[](gpointer data) {
+            auto* si = static_cast<ScrollInfo*>(data);
+            if(si->idle)
+                g_source_remove(si->idle);
+            delete si;
+        });
+
+    auto schedule = G_CALLBACK(+[](gpointer, gpointer layout) {
+        gtkscroll_schedule(static_cast<GtkWidget*>(layout));
+    });
+
+    // The page size changes when the viewport is resized
+    GtkAdjustment* adj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(layout));
+    g_signal_connect_object(adj, "value-changed", schedule, layout,
+                            GConnectFlags{});
+    g_signal_connect_object(adj, "changed", schedule, layout,
+                            GConnectFlags{});
+    g_signal_connect(layout, "size-allocate",
+                     G_CALLBACK(+[](GtkWidget* w, GdkRectangle*, gpointer) {
+                         gtkscroll_schedule(w);
+                     }),
+                     nullptr);
+}
+
+void BackendGtkImpl::connect_tabs(const std::any& tabs,
+                                  std::function<void(int)> activated) {
+    using Activated = std::function<void(int)>;
+
+    g_signal_connect_data(
+        std::any_cast<GtkWidget*>(tabs), "switch-page",
+        G_CALLBACK(+[](GtkNotebook*, GtkWidget*, guint index, gpointer data) {
+            (*static_cast<Activated*>(data))(static_cast<int>(index));
+        }),
+        new Activated{std::move(activated)},
+        +[](gpointer data, GClosure*) { delete static_cast<Activated*>(data); },
+        GConnectFlags{});
+}
+
+void BackendGtkImpl::page_processed(const std::any& page) {
+    gtk_widget_show_all(std::any_cast<GtkWidget*>(page));
+}
@@ -2,11 +2,15 @@
 
 #include "../../backend.h"
 #include <gtk/gtk.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 class BackendGtkImpl: public Backend {
 public:
     BackendGtkImpl(int& argc, char** argv);
-    int run() const override;
+    ~BackendGtkImpl() override;
+    int run() override;
     void exit() override;
     nlohmann::json get_model_data(const tanto::types::Widget& arg,
                                   const std::any& w) override;
@@ -27,6 +31,12 @@ private:
                           const tanto::FilterList& filter,
                           const std::string& startdir);
     std::any new_window(const tanto::types::Window& arg) override;
+    void destroy_window(const std::string& window) override;
+    [[nodiscard]] std::weak_ptr<bool> alive() const;
+    void schedule_updates();
+    void update_widget(const std::string& type, const std::any& widget,
+                       std::string_view property,
+                       const nlohmann::json& value) override;
     std::any new_space(const tanto::types::Widget& arg,
                        const std::any& parent) override;
     std::any new_text(const tanto::types::Widget& arg,
@@ -41,10 +51,18 @@ private:
                         const std::any& parent) override;
     std::any new_check(const tanto::types::Widget& arg,
                        const std::any& parent) override;
+    std::any new_progress(const tanto::types::Widget& arg,
+                          const std::any& parent) override;
+    std::any new_log(const tanto::types::Widget& arg,
+                     const std::any& parent) override;
     std::any new_list(const tanto::types::Widget& arg,
                       const std::any& parent) override;
     std::any new_tree(const tanto::types::Widget& arg,
                       const std::any& parent) override;
+    std::any new_gallery(const tanto::types::Widget& arg,
+                         const std::any& parent) override;
+    std::any new_files(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
     std::any new_tabs(const tanto::types::Widget& arg,
                       const std::any& parent) override;
     std::any new_row(const tanto::types::Widget& arg,
@@ -57,10 +75,22 @@ private:
                       const std::any& parent) override;
     std::any new_group(const tanto::types::Widget& arg,
                        const std::any& parent) override;
+    void connect_tabs(const std::any& tabs,
+                      std::function<void(int)> activated) override;
+    std::any new_scroll(const tanto::types::Widget& arg,
+                        const std::any& parent) override;
+    std::any new_scroll_row(const std::any& scroll, size_t row) override;
+    void destroy_scroll_row(const std::any& row) override;
+    void connect_scroll(
+        const std::any& scroll,
+        std::function<void(size_t first, size_t count)> scrolled) override;
+    void page_processed(const std::any& page) override;
     void widget_processed(const tanto::types::Widget& arg,
                           const std::any& widget) override;
-    void processed() override;
+    void processed(const std::any& window) override;
 
 private:
-    GtkWidget* m_mainwindow;
+    std::unordered_map<std::string, GtkWidget*> m_toplevels;
+    std::shared_ptr<bool> m_alive{std::make_shared<bool>(true)};
+    bool m_ticking{false}; // Updates are waiting for the next frame
 };
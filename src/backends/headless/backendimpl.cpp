@@ -0,0 +1,769 @@
+#include "backendimpl.h"
+#include "../../dirlist.h"
+#include "../../error.h"
+#include "../../utils.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <thread>
+
+namespace {
+
+constexpr int SCRIPT_ERROR = 2; // Exit code of run()
+
+// Mistakes in the script, reported with their line
+class ScriptError: public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+template<typename... Args>
+[[noreturn]] void script_error(fmt::format_string<Args...> f, Args&&... args) {
+    throw ScriptError{fmt::format(f, std::forward<Args>(args)...)};
+}
+
+[[nodiscard]] std::string_view next_token(std::string_view& s) {
+    size_t start = s.find_first_not_of(' ');
+    if(start == std::string_view::npos) {
+        s = {};
+        return {};
+    }
+
+    s.remove_prefix(start);
+    size_t end = s.find(' ');
+    std::string_view token = s.substr(0, end);
+    s.remove_prefix(end == std::string_view::npos ? s.size() : end + 1);
+    return token;
+}
+
+[[nodiscard]] std::string widget_key(const tanto::types::Widget& arg) {
+    return arg.window.empty() ? arg.id : arg.window + "/" + arg.id;
+}
+
+[[nodiscard]] std::vector<int> parse_path(std::string_view s) {
+    std::vector<int> path;
+
+    while(!s.empty()) {
+        int idx = 0;
+        auto res = std::from_chars(s.data(), s.data() + s.size(), idx);
+        if(res.ec != std::errc{} || idx < 0)
+            script_error("Invalid row: '{}'", s);
+
+        path.push_back(idx);
+        s.remove_prefix(res.ptr - s.data());
+        if(!s.empty() && s.front() == ':')
+            s.remove_prefix(1);
+    }
+
+    return path;
+}
+
+[[nodiscard]] const tanto::types::MultiValue*
+find_item(const tanto::types::Widget& arg, const std::vector<int>& path) {
+    const tanto::types::MultiValueList* items = &arg.items;
+    const tanto::types::MultiValue* item = nullptr;
+
+    for(int idx : path) {
+        if(!items || static_cast<size_t>(idx) >= items->size())
+            return nullptr;
+
+        item = &items->at(idx);
+        const auto* w = std::get_if<tanto::types::Widget>(item);
+        items = w ? &w->items : nullptr;
+    }
+
+    return item;
+}
+
+[[nodiscard]] std::string item_id(const tanto::types::MultiValue& item) {
+    return std::visit(tanto::utils::Overload{
+                          [](const tanto::types::Widget& a) {
+                              return a.get_id();
+                          },
+                          [](const std::string& a) { return a; }},
+                      item);
+}
+
+[[nodiscard]] nlohmann::json item_row(const tanto::types::MultiValue& item,
+                                      const tanto::Header& header) {
+    nlohmann::json row = nlohmann::json::object();
+
+    if(const auto* a = std::get_if<tanto::types::Widget>(&item); a) {
+        for(const tanto::HeaderItem& h : header) {
+            if(a->has_prop(h.id))
+                row[h.id] = a->prop<nlohmann::json>(h.id);
+        }
+    }
+
+    return row;
+}
+
+// Path of the first item with 'id', in depth first order
+bool find_path(const tanto::types::MultiValueList& items,
+               const std::string& id, std::vector<int>& path) {
+    for(size_t i = 0; i < items.size(); i++) {
+        path.push_back(i);
+        if(item_id(items[i]) == id)
+            return true;
+
+        const auto* a = std::get_if<tanto::types::Widget>(&items[i]);
+        if(a && find_path(a->items, id, path))
+            return true;
+        path.pop_back();
+    }
+
+    return false;
+}
+
+// The last "selected" item becomes the current one, like GTK does
+void find_selected(const tanto::types::MultiValueList& items,
+                   std::vector<int>& path, std::vector<int>& selected,
+                   bool recursive) {
+    for(size_t i = 0; i < items.size(); i++) {
+        const auto* a = std::get_if<tanto::types::Widget>(&items[i]);
+        if(!a)
+            continue;
+
+        path.push_back(i);
+        if(a->prop<bool>("selected"))
+            selected = path;
+        if(recursive)
+            find_selected(a->items, path, selected, recursive);
+        path.pop_back();
+    }
+}
+
+// Drops the oldest lines, like the GUI backends' log widgets
+void keep_last_lines(std::string& text, size_t maxlines) {
+    size_t lines = 0;
+
+    for(size_t i = text.size(); i-- > 0;) {
+        if(text[i] != '\n' || i + 1 == text.size())
+            continue;
+
+        if(++lines == maxlines) {
+            text.erase(0, i + 1);
+            return;
+        }
+    }
+}
+
+} // namespace
+
+BackendHeadlessImpl::BackendHeadlessImpl(int& argc, char** argv)
+    : Backend{argc, argv}, m_script{&std::cin} {
+    const char* script = std::getenv("TANTO_SCRIPT");
+
+    if(script && *script && std::string_view{script} != "-") {
+        m_file.open(script);
+        if(!m_file) // run() ends at once
+            spdlog::error("Cannot open script '{}'", script);
+        m_script = &m_file;
+    }
+}
+
+std::string_view BackendHeadlessImpl::version() { return "1.0"; }
+
+int BackendHeadlessImpl::run() {
+    std::string line;
+    int res = 0;
+    m_running = true;
+
+    while(m_running && this->next_action(line)) {
+        try {
+            this->execute(line);
+        }
+        catch(ScriptError& e) {
+            spdlog::error("Script line {}: {}", m_line, e.what());
+            res = SCRIPT_ERROR;
+            break;
+        }
+        catch(nlohmann::json::exception& e) { // Like "update" arguments
+            spdlog::error("Script line {}: {}", m_line, e.what());
+            res = SCRIPT_ERROR;
+            break;
+        }
+    }
+
+    m_running = false;
+    this->close_all(); // Whatever the script left open
+    return res;
+}
+
+void BackendHeadlessImpl::exit() { m_running = false; }
+
+bool BackendHeadlessImpl::next_action(std::string& line) {
+    while(std::getline(*m_script, line)) {
+        m_line++;
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if(!line.empty() && line.front() != '#')
+            return true;
+    }
+
+    return false;
+}
+
+BackendHeadlessImpl::Widget*
+BackendHeadlessImpl::find(std::string_view id) const {
+    auto it = m_ids.find(std::string{id});
+    if(it == m_ids.end())
+        script_error("Widget '{}' not found", id);
+    return it->second;
+}
+
+// Disabled or hidden containers affect their children too
+bool BackendHeadlessImpl::is_active(const Widget* w) {
+    for(; w; w = w->parent) {
+        if(!w->arg.enabled || !w->visible)
+            return false;
+    }
+
+    return true;
+}
+
+void BackendHeadlessImpl::execute(std::string_view line) {
+    using namespace tanto::utils::string_literals;
+
+    std::string_view action = next_token(line);
+
+    if(action == "update") {
+        this->updates()->push(nlohmann::json::parse(line));
+        return;
+    }
+
+    this->apply_updates();
+
+    if(action == "close") {
+        if(std::string_view window = next_token(line); !window.empty())
+            this->close(std::string{window});
+        else {
+            this->close_all();
+            this->exit();
+        }
+        return;
+    }
+
+    Widget* w = this->find(next_token(line));
+    if(!is_active(w)) {
+        spdlog::warn("Ignoring '{}' on disabled or hidden widget '{}'", action,
+                     w->arg.id);
+        return;
+    }
+
+    switch(tanto::utils::fnv1a_32(action)) {
+        case "click"_fnv1a_32:
+            if(w->arg.type == "check") {
+                w->checked = !w->checked;
+                this->value_changed(w->arg);
+                this->changed(w->arg, w->checked);
+            }
+            else
+                this->clicked(w->arg);
+            break;
+
+        case "dblclick"_fnv1a_32:
+            this->double_clicked(w->arg, w->arg.text);
+            break;
+
+        case "set"_fnv1a_32: {
+            if(w->arg.type == "number") {
+                int v = 0;
+                const char* end = line.data() + line.size();
+                auto res = std::from_chars(line.data(), end, v);
+                if(res.ec != std::errc{} || res.ptr != end)
+                    script_error("Invalid number for '{}'", w->arg.id);
+
+                w->value = std::clamp(
+                    v, w->arg.prop<int>("min", tanto::NUMBER_MIN),
+                    w->arg.prop<int>("max", tanto::NUMBER_MAX));
+            }
+            else if(w->arg.type == "check") {
+                bool checked = line == "true" || line == "1";
+                if(checked != w->checked) {
+                    w->checked = checked;
+                    this->value_changed(w->arg);
+                    this->changed(w->arg, w->checked);
+                }
+                break;
+            }
+            else
+                w->text = line;
+
+            this->value_changed(w->arg);
+            break;
+        }
+
+        case "expand"_fnv1a_32: {
+            std::string dir{line};
+            w->dirs.emplace(dir, false);
+            this->expanded(w->arg, dir);
+            this->wait_listing(w, dir);
+            break;
+        }
+
+        case "select"_fnv1a_32:
+        case "activate"_fnv1a_32: {
+            if(w->arg.type == "files") {
+                this->activate_file(w, action, std::string{line});
+                break;
+            }
+
+            if(!line.empty())
+                w->current = parse_path(line);
+
+            const tanto::types::MultiValue* item =
+                find_item(w->arg, w->current);
+
+            if(!item)
+                script_error("Invalid row for '{}'", w->arg.id);
+            if(action == "select")
+                break;
+
+            if(!w->header.empty())
+                this->selected(w->arg, item_row(*item, w->header));
+            else
+                this->selected(w->arg, w->current.back(), *item);
+            break;
+        }
+
+        case "tab"_fnv1a_32: {
+            int index = 0;
+            auto res =
+                std::from_chars(line.data(), line.data() + line.size(), index);
+            if(res.ec != std::errc{} || index < 0 ||
+               static_cast<size_t>(index) >= w->arg.items.size())
+                script_error("Invalid tab for '{}'", w->arg.id);
+
+            w->value = index;
+            if(w->activated)
+                w->activated(index);
+            break;
+        }
+
+        case "scroll"_fnv1a_32: {
+            size_t row = 0;
+            auto res =
+                std::from_chars(line.data(), line.data() + line.size(), row);
+            if(res.ec != std::errc{} || row >= w->arg.items.size())
+                script_error("Invalid row for '{}'", w->arg.id);
+
+            if(w->scrolled)
+                w->scrolled(row, 1);
+            break;
+        }
+
+        default: script_error("Unknown action: '{}'", action);
+    }
+}
+
+// Listings come from worker threads, as updates
+void BackendHeadlessImpl::wait_listing(Widget* w, const std::string& dir) {
+    for(auto it = w->dirs.find(dir); it != w->dirs.end() && !it->second;
+        it = w->dirs.find(dir)) {
+        this->apply_updates();
+        if(!w->dirs[dir])
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+}
+
+void BackendHeadlessImpl::activate_file(Widget* w, std::string_view action,
+                                        const std::string& path) {
+    size_t slash = path.rfind('/');
+    this->wait_listing(w, slash ? path.substr(0, slash) : "/");
+
+    auto it = w->files.find(path);
+    if(it == w->files.end())
+        script_error("File '{}' not found in '{}'", path, w->arg.id);
+
+    if(action == "select")
+        w->text = path;
+    else if(it->second) { // Directories are expanded
+        w->dirs.emplace(path, false);
+        this->expanded(w->arg, path);
+        this->wait_listing(w, path);
+    }
+    else {
+        w->text = path;
+        this->selected(w->arg, path);
+    }
+}
+
+void BackendHeadlessImpl::answer() {
+    std::string line;
+    this->send_event(this->next_action(line) ? line : std::string{});
+}
+
+nlohmann::json
+BackendHeadlessImpl::get_model_data(const tanto::types::Widget& arg,
+                                    const std::any& w) {
+    using namespace tanto::utils::string_literals;
+
+    const auto* hw = std::any_cast<Widget*>(w);
+
+    switch(tanto::utils::fnv1a_32(arg.type)) {
+        case "input"_fnv1a_32: return hw->text;
+        case "number"_fnv1a_32:
+        case "progress"_fnv1a_32: return hw->value;
+        case "check"_fnv1a_32: return hw->checked;
+        case "image"_fnv1a_32: return arg.text; // Not downloaded
+
+        case "files"_fnv1a_32:
+            if(hw->text.empty())
+                return nullptr;
+            return hw->text;
+
+        case "list"_fnv1a_32:
+        case "tree"_fnv1a_32:
+        case "gallery"_fnv1a_32: {
+            const tanto::types::MultiValue* item =
+                hw->current.empty() ? nullptr
+                                    : find_item(hw->arg, hw->current);
+
+            if(!item)
+                return nullptr;
+            if(!hw->header.empty())
+                return item_row(*item, hw->header);
+            return item_id(*item);
+        }
+
+        default: break;
+    }
+
+    return nullptr;
+}
+
+void BackendHeadlessImpl::update_widget(const std::string& type,
+                                        const std::any& widget,
+                                        std::string_view property,
+                                        const nlohmann::json& value) {
+    using namespace tanto::utils::string_literals;
+
+    auto* hw = std::any_cast<Widget*>(widget);
+
+    switch(tanto::utils::fnv1a_32(property)) {
+        case "text"_fnv1a_32: hw->text = tanto::stringify(value); break;
+        case "value"_fnv1a_32: hw->value = value.get<int>(); break;
+        case "checked"_fnv1a_32: hw->checked = value.get<bool>(); break;
+        case "enabled"_fnv1a_32: hw->arg.enabled = value.get<bool>(); break;
+        case "visible"_fnv1a_32: hw->visible = value.get<bool>(); break;
+        case "max"_fnv1a_32: hw->arg.properties["max"] = value; break;
+
+        case "items"_fnv1a_32: {
+            if((type != "list" && type != "tree") || !hw->header.empty()) {
+                spdlog::warn("Update: unsupported property '{}' for '{}'",
+                             property, type);
+                return;
+            }
+
+            // The current row stays current, if it's still there
+            std::optional<std::string> current;
+            if(const auto* item = find_item(hw->arg, hw->current); item)
+                current = item_id(*item);
+
+            hw->arg.items = tanto::types::items_from_json(value);
+            hw->current.clear();
+            if(current)
+                find_path(hw->arg.items, *current, hw->current);
+            return;
+        }
+
+        case "entries"_fnv1a_32:
+            if(type != "files") {
+                spdlog::warn("Update: unsupported property '{}' for '{}'",
+                             property, type);
+                return;
+            }
+
+            for(const auto& [dir, listing] : value.items()) {
+                for(const nlohmann::json& e : listing.at("entries"))
+                    hw->files[tanto::join_path(dir, e[0].get<std::string>())] =
+                        e[1].get<bool>();
+                if(listing.value("done", false))
+                    hw->dirs[dir] = true;
+            }
+            return;
+
+        case "append"_fnv1a_32:
+            if(type != "log") {
+                spdlog::warn("Update: unsupported property '{}' for '{}'",
+                             property, type);
+                return;
+            }
+
+            hw->text += value.get<std::string>();
+            keep_last_lines(hw->text, hw->arg.prop<size_t>(
+                                          "lines", tanto::LOG_MAX_LINES));
+            return;
+
+        default:
+            spdlog::warn("Update: unsupported property '{}' for '{}'",
+                         property, type);
+            return;
+    }
+
+    if(type == "number" || type == "progress")
+        hw->value = std::clamp(
+            hw->value, hw->arg.prop<int>("min", tanto::NUMBER_MIN),
+            hw->arg.prop<int>("max", type == "number" ? tanto::NUMBER_MAX
+                                                      : tanto::PROGRESS_MAX));
+}
+
+void BackendHeadlessImpl::message(const std::string& title,
+                                  const std::string& text, MessageType mt,
+                                  MessageIcon icon) {
+    (void)title;
+    (void)text;
+    (void)icon;
+
+    std::string line;
+    if(!this->next_action(line)) // Dismissed, no button
+        return;
+
+    // Not in run(): reported here, like a closed dialog
+    if(line == "ok" || (line == "cancel" && mt == MessageType::CONFIRM))
+        this->send_event(line);
+    else
+        spdlog::error("Script line {}: invalid answer '{}'", m_line, line);
+}
+
+void BackendHeadlessImpl::input(const std::string& title,
+                                const std::string& text,
+                                const std::string& value, InputType it) {
+    (void)title;
+    (void)text;
+    (void)value;
+    (void)it;
+    this->answer();
+}
+
+void BackendHeadlessImpl::select_dir(const std::string& title,
+                                     const std::string& startdir) {
+    (void)title;
+    (void)startdir;
+    this->answer();
+}
+
+void BackendHeadlessImpl::load_file(const std::string& title,
+                                    const tanto::FilterList& filter,
+                                    const std::string& startdir) {
+    (void)title;
+    (void)filter;
+    (void)startdir;
+    this->answer();
+}
+
+void BackendHeadlessImpl::save_file(const std::string& title,
+                                    const tanto::FilterList& filter,
+                                    const std::string& startdir) {
+    (void)title;
+    (void)filter;
+    (void)startdir;
+    this->answer();
+}
+
+std::any BackendHeadlessImpl::add(const tanto::types::Widget& arg,
+                                 const std::any& parent) {
+    auto* p = parent.has_value() ? std::any_cast<Widget*>(parent) : nullptr;
+    Widget& w = p && p->row ? p->row->rowwidgets.emplace_back()
+                            : m_widgets[arg.window].emplace_back();
+    w.arg = arg;
+    w.parent = p;
+    w.row = p ? p->row : nullptr;
+    w.text = arg.text;
+    w.value = arg.value;
+    w.checked = arg.prop<bool>("checked");
+
+    if(arg.type == "list" || arg.type == "tree" || arg.type == "gallery") {
+        std::vector<int> path;
+        if(arg.type != "gallery")
+            w.header = tanto::parse_header(arg);
+        find_selected(arg.items, path, w.current, arg.type == "tree");
+    }
+
+    if(w.arg.has_id())
+        m_ids[widget_key(w.arg)] = &w;
+
+    return &w;
+}
+
+std::any BackendHeadlessImpl::new_window(const tanto::types::Window& arg) {
+    tanto::types::Widget w{arg.type};
+    w.window = arg.id;
+    return this->add(w);
+}
+
+void BackendHeadlessImpl::destroy_window(const std::string& window) {
+    auto it = m_widgets.find(window);
+    if(it == m_widgets.end())
+        return;
+
+    for(const Widget& w : it->second) {
+        if(w.arg.has_id())
+            m_ids.erase(widget_key(w.arg));
+
+        for(const Widget& c : w.rowwidgets) {
+            if(c.arg.has_id())
+                m_ids.erase(widget_key(c.arg));
+        }
+    }
+
+    m_widgets.erase(it);
+}
+
+std::any BackendHeadlessImpl::new_space(const tanto::types::Widget& arg,
+                                        const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_text(const tanto::types::Widget& arg,
+                                       const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_input(const tanto::types::Widget& arg,
+                                        const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_number(const tanto::types::Widget& arg,
+                                         const std::any& parent) {
+    std::any w = this->add(arg, parent);
+    Widget* hw = std::any_cast<Widget*>(w);
+    hw->value = std::clamp(hw->value, arg.prop<int>("min", tanto::NUMBER_MIN),
+                           arg.prop<int>("max", tanto::NUMBER_MAX));
+    return w;
+}
+
+std::any BackendHeadlessImpl::new_image(const tanto::types::Widget& arg,
+                                        const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_button(const tanto::types::Widget& arg,
+                                         const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_check(const tanto::types::Widget& arg,
+                                        const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_progress(const tanto::types::Widget& arg,
+                                           const std::any& parent) {
+    std::any w = this->add(arg, parent);
+    Widget* hw = std::any_cast<Widget*>(w);
+    hw->value = std::clamp(hw->value, 0,
+                           arg.prop<int>("max", tanto::PROGRESS_MAX));
+    return w;
+}
+
+std::any BackendHeadlessImpl::new_log(const tanto::types::Widget& arg,
+                                      const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_list(const tanto::types::Widget& arg,
+                                       const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_tree(const tanto::types::Widget& arg,
+                                       const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_gallery(const tanto::types::Widget& arg,
+                                          const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_files(const tanto::types::Widget& arg,
+                                        const std::any& parent) {
+    std::any w = this->add(arg, parent);
+    std::any_cast<Widget*>(w)->dirs.emplace(tanto::files_root(arg), false);
+    return w;
+}
+
+std::any BackendHeadlessImpl::new_tabs(const tanto::types::Widget& arg,
+                                       const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_row(const tanto::types::Widget& arg,
+                                      const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_column(const tanto::types::Widget& arg,
+                                         const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_grid(const tanto::types::Widget& arg,
+                                       const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_form(const tanto::types::Widget& arg,
+                                       const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_group(const tanto::types::Widget& arg,
+                                        const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+void BackendHeadlessImpl::connect_tabs(const std::any& tabs,
+                                       std::function<void(int)> activated) {
+    std::any_cast<Widget*>(tabs)->activated = std::move(activated);
+}
+
+std::any BackendHeadlessImpl::new_scroll(const tanto::types::Widget& arg,
+                                         const std::any& parent) {
+    return this->add(arg, parent);
+}
+
+std::any BackendHeadlessImpl::new_scroll_row(const std::any& scroll,
+                                             size_t row) {
+    (void)row;
+    auto* s = std::any_cast<Widget*>(scroll);
+
+    if(!s->freerows.empty()) {
+        Widget* slot = s->freerows.back();
+        s->freerows.pop_back();
+        slot->visible = true;
+        return slot;
+    }
+
+    tanto::types::Widget w{"row"};
+    w.window = s->arg.window;
+    auto* slot = std::any_cast<Widget*>(this->add(w, scroll));
+    slot->row = slot;
+    return slot;
+}
+
+// Only the row's own widgets are touched, scrolling stays linear
+void BackendHeadlessImpl::destroy_scroll_row(const std::any& row) {
+    auto* slot = std::any_cast<Widget*>(row);
+    slot->visible = false;
+
+    for(const Widget& w : slot->rowwidgets) {
+        if(w.arg.has_id())
+            m_ids.erase(widget_key(w.arg));
+    }
+
+    slot->rowwidgets.clear();
+    slot->parent->freerows.push_back(slot);
+}
+
+void BackendHeadlessImpl::connect_scroll(
+    const std::any& scroll,
+    std::function<void(size_t first, size_t count)> scrolled) {
+    std::any_cast<Widget*>(scroll)->scrolled = std::move(scrolled);
+}
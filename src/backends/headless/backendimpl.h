@@ -0,0 +1,145 @@
+#pragma once
+
+#include "../../backend.h"
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Builds widgets in memory and drives them with a script instead of a
+// display: one action per line, read from $TANTO_SCRIPT (or stdin, after the
+// dialog with "tanto stdin").
+//
+//   click <id>             Button click
+//   dblclick <id>          Image double click
+//   set <id> <value>       Input text, number value or check state
+//   select <id> <path>     Current row ("2" or "0:1" in trees, a file path
+//                          in files), no event
+//   activate <id> [path]   Row double click/Return
+//   expand <id> <dir>      Lists a directory of a files, waits for it
+//   tab <id> <index>       Current page of a tabs
+//   scroll <id> <row>      Brings a row of a scroll into view
+//   close [window]         Close a window (or all of them) without events
+//   update <json>          Queue a property update, like tanto's stdin
+//
+// Queued updates are applied before the next action.
+// Widgets in windows with an id are addressed as <window>/<id>.
+// Messages take "ok" (or "cancel" if they confirm) from the next line, input
+// and file dialogs take it as their value.
+// A mistake in the script stops it: it's logged with its line number and
+// run() returns 2.
+class BackendHeadlessImpl: public Backend {
+private:
+    struct Widget {
+        tanto::types::Widget arg;
+        tanto::Header header;
+        std::string text;
+        int value{0};
+        bool checked{false};
+        std::vector<int> current; // Path of the current row, if any
+        Widget* parent{nullptr};
+        Widget* row{nullptr}; // Scroll row it's in (a row is in itself)
+        bool visible{true};
+        std::function<void(int)> activated;           // Tabs only
+        std::function<void(size_t, size_t)> scrolled; // Scrolls only
+        std::unordered_map<std::string, bool> dirs;   // Files: dir -> listed
+        std::unordered_map<std::string, bool> files;  // Files: path -> is dir
+        std::list<Widget> rowwidgets; // Scroll rows: freed with the row
+        std::vector<Widget*> freerows; // Scrolls: destroyed rows, reused
+    };
+
+public:
+    BackendHeadlessImpl(int& argc, char** argv);
+    int run() override;
+    void exit() override;
+    nlohmann::json get_model_data(const tanto::types::Widget& arg,
+                                  const std::any& w) override;
+    void message(const std::string& title, const std::string& text,
+                 MessageType mt, MessageIcon icon) override;
+    void input(const std::string& title, const std::string& text,
+               const std::string& value, InputType it) override;
+    void select_dir(const std::string& title,
+                    const std::string& startdir) override;
+    void load_file(const std::string& title, const tanto::FilterList& filter,
+                   const std::string& startdir) override;
+    void save_file(const std::string& title, const tanto::FilterList& filter,
+                   const std::string& startdir) override;
+    static std::string_view version();
+
+private:
+    [[nodiscard]] Widget* find(std::string_view id) const;
+    [[nodiscard]] static bool is_active(const Widget* w);
+    [[nodiscard]] bool next_action(std::string& line);
+    void answer();
+    void wait_listing(Widget* w, const std::string& dir);
+    void activate_file(Widget* w, std::string_view action,
+                       const std::string& path);
+    void execute(std::string_view line);
+    std::any add(const tanto::types::Widget& arg, const std::any& parent = {});
+    std::any new_window(const tanto::types::Window& arg) override;
+    void destroy_window(const std::string& window) override;
+    void update_widget(const std::string& type, const std::any& widget,
+                       std::string_view property,
+                       const nlohmann::json& value) override;
+    std::any new_space(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
+    std::any new_text(const tanto::types::Widget& arg,
+                      const std::any& parent) override;
+    std::any new_input(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
+    std::any new_number(const tanto::types::Widget& arg,
+                        const std::any& parent) override;
+    std::any new_image(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
+    std::any new_button(const tanto::types::Widget& arg,
+                        const std::any& parent) override;
+    std::any new_check(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
+    std::any new_progress(const tanto::types::Widget& arg,
+                          const std::any& parent) override;
+    std::any new_log(const tanto::types::Widget& arg,
+                     const std::any& parent) override;
+    std::any new_list(const tanto::types::Widget& arg,
+                      const std::any& parent) override;
+    std::any new_tree(const tanto::types::Widget& arg,
+                      const std::any& parent) override;
+    std::any new_gallery(const tanto::types::Widget& arg,
+                         const std::any& parent) override;
+    std::any new_files(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
+    std::any new_tabs(const tanto::types::Widget& arg,
+                      const std::any& parent) override;
+    std::any new_row(const tanto::types::Widget& arg,
+                     const std::any& parent) override;
+    std::any new_column(const tanto::types::Widget& arg,
+                        const std::any& parent) override;
+    std::any new_grid(const tanto::types::Widget& arg,
+                      const std::any& parent) override;
+    std::any new_form(const tanto::types::Widget& arg,
+                      const std::any& parent) override;
+    std::any new_group(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
+    void connect_tabs(const std::any& tabs,
+                      std::function<void(int)> activated) override;
+    std::any new_scroll(const tanto::types::Widget& arg,
+                        const std::any& parent) override;
+    std::any new_scroll_row(const std::any& scroll, size_t row) override;
+    void destroy_scroll_row(const std::any& row) override;
+    void connect_scroll(
+        const std::any& scroll,
+        std::function<void(size_t first, size_t count)> scrolled) override;
+
+private:
+    // Stable addresses, by window (scroll rows keep their own)
+    std::unordered_map<std::string, std::deque<Widget>> m_widgets;
+    std::unordered_map<std::string, Widget*> m_ids;
+    std::ifstream m_file;
+    std::istream* m_script;
+    size_t m_line{0}; // Of the last action read
+    bool m_running{false};
+};
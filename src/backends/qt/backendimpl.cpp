@@ -1,13 +1,18 @@
 #include "backendimpl.h"
+#include "../../dirlist.h"
 #include "../../error.h"
 #include "../../events.h"
 #include "../../tanto.h"
 #include "../../utils.h"
+#include "../../workerpool.h"
+#include "filetree.h"
+#include "gallery.h"
 #include "mainwindow.h"
 #include "picture.h"
 #include <QAction>
 #include <QCheckBox>
 #include <QFileDialog>
+#include <QFontDatabase>
 #include <QFormLayout>
 #include <QGridLayout>
 #include <QGroupBox>
@@ -18,14 +23,21 @@
 #include <QListWidget>
 #include <QMessageBox>
 #include <QPlainTextEdit>
+#include <QProgressBar>
 #include <QPushButton>
+#include <QResizeEvent>
 #include <QScreen>
 #include <QScrollArea>
+#include <QScrollBar>
 #include <QShortcut>
+#include <QSignalBlocker>
 #include <QSpinBox>
 #include <QTabWidget>
+#include <QTextCursor>
 #include <QTreeWidget>
 #include <QVBoxLayout>
+#include <algorithm>
+#include <cstdint>
 
 Q_DECLARE_METATYPE(tanto::types::MultiValue);
 
@@ -33,6 +45,58 @@ namespace {
 
 const QString CENTRAL_WIDGET = "__tanto_central_widget__";
 
+// Old blocks are dropped by the document itself (maximumBlockCount)
+void qtlog_append(QPlainTextEdit* w, const QString& text) {
+    QScrollBar* sb = w->verticalScrollBar();
+    bool follow = sb->value() == sb->maximum(); // Unless scrolled back
+
+    QTextCursor c{w->document()};
+    c.movePosition(QTextCursor::End);
+    c.insertText(text); // Only the new blocks are laid out
+
+    if(follow)
+        sb->setValue(sb->maximum());
+}
+
+template<typename T>
+[[nodiscard]] T* qtany_cast(const std::any& arg) {
+    return arg.type() == typeid(T*) ? std::any_cast<T*>(arg) : nullptr;
+}
+
+template<typename... Ts>
+[[nodiscard]] QWidget* qtwidget_cast(const std::any& arg) {
+    QWidget* w = nullptr;
+    ((w = w ? w : qtany_cast<Ts>(arg)), ...);
+    return w;
+}
+
+template<typename... Ts>
+[[nodiscard]] QLayout* qtlayout_cast(const std::any& arg) {
+    QLayout* l = nullptr;
+    ((l = l ? l : qtany_cast<Ts>(arg)), ...);
+    return l;
+}
+
+// Layouts aren't widgets: a group's layout stands for the group, the others
+// for their items
+template<typename Function>
+void qtlayout_apply(QLayout* l, Function f) {
+    if(auto* g = qobject_cast<QGroupBox*>(l->parentWidget());
+       g && g->layout() == l) {
+        f(g);
+        return;
+    }
+
+    for(int i = 0; i < l->count(); i++) {
+        QLayoutItem* item = l->itemAt(i);
+
+        if(item->widget())
+            f(item->widget());
+        else if(item->layout())
+            qtlayout_apply(item->layout(), f);
+    }
+}
+
 [[nodiscard]]
 QObject* qtcontainer_cast(const std::any& arg) {
     if(arg.type() == typeid(QWidget*))
@@ -234,8 +298,13 @@ QTreeWidget* qttree_new(Backend* self, const tanto::types::Widget& arg,
         w->setHeaderLabels(qheader);
     }
 
+    QList<QTreeWidgetItem*> items;
+    items.reserve(static_cast<int>(arg.items.size()));
+
     for(tanto::types::MultiValue item : arg.items)
-        w->addTopLevelItem(qttree_add(w, item, header, haschildren));
+        items.push_back(qttree_add(w, item, header, haschildren));
+
+    w->addTopLevelItems(items); // A single model insertion
 
     apply_parent(w, qtcontainer_cast(parent), arg);
 
@@ -267,19 +336,61 @@ QTreeWidget* qttree_new(Backend* self, const tanto::types::Widget& arg,
     return w;
 }
 
+// Rows of a "scroll" are placed by hand, only the visible ones exist
+class ScrollContent: public QWidget {
+public:
+    explicit ScrollContent(int rowheight): m_rowheight{rowheight} {}
+    [[nodiscard]] inline int row_height() const { return m_rowheight; }
+
+protected:
+    void resizeEvent(QResizeEvent* e) override {
+        for(QWidget* w :
+            this->findChildren<QWidget*>(QString{},
+                                         Qt::FindDirectChildrenOnly))
+            w->resize(e->size().width(), m_rowheight);
+
+        QWidget::resizeEvent(e);
+    }
+
+private:
+    int m_rowheight;
+};
+
 } // namespace
 
 BackendQtImpl::BackendQtImpl(int& argc, char** argv)
-    : Backend{argc, argv}, m_app{argc, argv} {}
+    : Backend{argc, argv}, m_app{argc, argv} {
+    tanto::WorkerPool::instance().start(); // If a previous backend stopped it
+    qreal hz = qApp->primaryScreen() ? qApp->primaryScreen()->refreshRate() : 0;
+
+    m_updatetimer.setSingleShot(true);
+    m_updatetimer.setInterval(hz > 0 ? std::max(1, qRound(1000 / hz)) : 16);
+    QObject::connect(&m_updatetimer, &QTimer::timeout, &m_updatetimer,
+                     [this]() { this->apply_updates(); });
+
+    this->updates()->set_notify([this]() { // From the producer's thread
+        QMetaObject::invokeMethod(
+            &m_updatetimer,
+            [this]() {
+                if(!m_updatetimer.isActive())
+                    m_updatetimer.start();
+            },
+            Qt::QueuedConnection);
+    });
+}
 
 BackendQtImpl::~BackendQtImpl() {
-    if(m_mainwindow)
-        m_mainwindow->deleteLater();
-    m_mainwindow = nullptr;
+    this->updates()->set_notify(nullptr);
+    tanto::WorkerPool::instance().stop(); // Before QApplication goes away
+    this->close_all();
 }
 
 std::string_view BackendQtImpl::version() { return QT_VERSION_STR; }
-int BackendQtImpl::run() const { return m_app.exec(); }
+int BackendQtImpl::run() {
+    int res = m_app.exec();
+    this->close_all(); // Don't leave them around when embedded
+    return res;
+}
 
 std::any BackendQtImpl::new_window(const tanto::types::Window& arg) {
     auto* mw = new MainWindow();
@@ -291,9 +402,12 @@ std::any BackendQtImpl::new_window(const tanto::types::Window& arg) {
     // mw->setWindowFlags(Qt::Tool);
 
     QAction* act = qtadd_action(mw, QString{}, QKeySequence{Qt::Key_Escape},
-                                qApp, &QApplication::exit);
+                                mw, [this, id = arg.id]() { this->close(id); });
     act->setShortcutContext(Qt::WidgetWithChildrenShortcut);
 
+    QObject::connect(mw, &MainWindow::closed, mw,
+                     [this, id = arg.id]() { this->close(id); });
+
     if(!arg.x && !arg.y) // Center window
     {
         QRect position = mw->frameGeometry();
@@ -315,17 +429,175 @@ std::any BackendQtImpl::new_window(const tanto::types::Window& arg) {
     auto* body = new QWidget();
     body->setObjectName(CENTRAL_WIDGET);
     mw->setCentralWidget(body);
+    mw->setUpdatesEnabled(false); // Shown by processed(), once it's complete
 
-    mw->show();
-
-    m_mainwindow = mw;
+    m_toplevels[arg.id] = mw;
     return body;
 }
 
+void BackendQtImpl::destroy_window(const std::string& window) {
+    auto it = m_toplevels.find(window);
+    if(it == m_toplevels.end())
+        return;
+
+    if(it->second) {
+        it->second->hide();
+        it->second->deleteLater();
+    }
+
+    m_toplevels.erase(it);
+}
+
 void BackendQtImpl::exit() { qApp->quit(); }
 
+void BackendQtImpl::processed(const std::any& window) {
+    QWidget* mw = std::any_cast<QWidget*>(window)->window();
+    mw->setUpdatesEnabled(true);
+    mw->show(); // A single layout pass for the whole window
+}
+
+void BackendQtImpl::update_widget(const std::string& type,
+                                  const std::any& widget,
+                                  std::string_view property,
+                                  const nlohmann::json& value) {
+    using namespace tanto::utils::string_literals;
+
+    auto* progress = qtany_cast<QProgressBar>(widget);
+    auto* spin = qtany_cast<QSpinBox>(widget);
+
+    switch(tanto::utils::fnv1a_32(property)) {
+        case "text"_fnv1a_32: {
+            QString text = QString::fromStdString(tanto::stringify(value));
+
+            if(auto* w = qtany_cast<QLabel>(widget); w)
+                w->setText(text);
+            else if(auto* w = qtany_cast<QLineEdit>(widget); w)
+                w->setText(text);
+            else if(auto* w = qtany_cast<QPlainTextEdit>(widget); w)
+                w->setPlainText(text);
+            else if(auto* w = qtany_cast<QPushButton>(widget); w)
+                w->setText(text);
+            else if(auto* w = qtany_cast<QCheckBox>(widget); w)
+                w->setText(text);
+            else if(progress) {
+                progress->setFormat(text.isEmpty() ? QStringLiteral("%p%")
+                                                   : text);
+            }
+            else
+                break;
+            return;
+        }
+
+        case "value"_fnv1a_32:
+            if(progress)
+                progress->setValue(value.get<int>());
+            else if(spin)
+                spin->setValue(value.get<int>());
+            else
+                break;
+            return;
+
+        case "max"_fnv1a_32:
+            if(progress)
+                progress->setMaximum(value.get<int>());
+            else if(spin)
+                spin->setMaximum(value.get<int>());
+            else
+                break;
+            return;
+
+        case "checked"_fnv1a_32:
+            if(auto* w = qtany_cast<QCheckBox>(widget); w) {
+                QSignalBlocker blocker{w}; // Not an user action
+                w->setChecked(value.get<bool>());
+                return;
+            }
+            break;
+
+        case "append"_fnv1a_32:
+            if(auto* w = qtany_cast<QPlainTextEdit>(widget);
+               w && type == "log") {
+                qtlog_append(w,
+                             QString::fromStdString(value.get<std::string>()));
+                return;
+            }
+            break;
+
+        case "items"_fnv1a_32:
+            if(auto* w = qtany_cast<QTreeWidget>(widget);
+               w && w->isHeaderHidden()) { // Rows without a header only
+                QList<QTreeWidgetItem*> items;
+
+                for(tanto::types::MultiValue& item :
+                    tanto::types::items_from_json(value))
+                    items.push_back(qttree_add(w, item, {}, type == "tree"));
+
+                // The current row stays current, if it's still there
+                QString text;
+                if(QTreeWidgetItem* current = w->currentItem(); current)
+                    text = current->text(0);
+
+                w->clear();
+                w->addTopLevelItems(items);
+
+                if(!text.isEmpty()) {
+                    QList<QTreeWidgetItem*> found = w->findItems(
+                        text, Qt::MatchExactly | Qt::MatchRecursive);
+                    if(!found.isEmpty())
+                        w->setCurrentItem(found.front());
+                }
+                return;
+            }
+            break;
+
+        case "entries"_fnv1a_32:
+            if(auto* w = qtany_cast<FileTree>(widget); w) {
+                w->add_entries(value);
+                return;
+            }
+            break;
+
+        case "enabled"_fnv1a_32:
+        case "visible"_fnv1a_32: {
+            bool v = value.get<bool>();
+            auto apply = [v, enabled = property == "enabled"](QWidget* w) {
+                if(enabled)
+                    w->setEnabled(v);
+                else
+                    w->setVisible(v);
+            };
+
+            if(QWidget* w =
+                   qtwidget_cast<QLabel, QLineEdit, QPlainTextEdit, QSpinBox,
+                                 QPushButton, QCheckBox, QProgressBar,
+                                 QTreeWidget, Picture, Gallery, FileTree,
+                                 QTabWidget, QGroupBox, QScrollArea,
+                                 QWidget>(widget);
+               w) {
+                apply(w);
+                return;
+            }
+
+            if(QLayout* l = qtlayout_cast<QVBoxLayout, QHBoxLayout,
+                                          QGridLayout, QFormLayout>(widget);
+               l) {
+                qtlayout_apply(l, apply);
+                return;
+            }
+            break;
+        }
+
+        default: break;
+    }
+
+    spdlog::warn("Update: unsupported property '{}' for '{}'", property, type);
+}
+
 nlohmann::json BackendQtImpl::get_model_data(const tanto::types::Widget& arg,
                                              const std::any& w) {
+    if(arg.type == "log") // Output, not a value
+        return nullptr;
+
     if(w.type() == typeid(QTreeWidget*)) {
         auto* tree = std::any_cast<QTreeWidget*>(w);
         QModelIndex index = tree->currentIndex();
@@ -356,8 +628,28 @@ nlohmann::json BackendQtImpl::get_model_data(const tanto::types::Widget& arg,
         return std::any_cast<QCheckBox*>(w)->isChecked();
     if(w.type() == typeid(Picture*))
         return std::any_cast<Picture*>(w)->file_path().toStdString();
+    if(w.type() == typeid(Gallery*)) {
+        auto* gallery = std::any_cast<Gallery*>(w);
+        QModelIndex index = gallery->currentIndex();
+        if(!index.isValid())
+            return nullptr;
+
+        return std::visit(
+            tanto::utils::Overload{
+                [&](tanto::types::Widget& a) { return a.get_id(); },
+                [&](std::string& a) { return a; }},
+            gallery->gallery_model()->value(index.row()));
+    }
+    if(w.type() == typeid(FileTree*)) {
+        QTreeWidgetItem* item = std::any_cast<FileTree*>(w)->currentItem();
+        if(!item)
+            return nullptr;
+        return FileTree::file_path(item).toStdString();
+    }
     if(w.type() == typeid(QSpinBox*))
         return std::any_cast<QSpinBox*>(w)->value();
+    if(w.type() == typeid(QProgressBar*))
+        return std::any_cast<QProgressBar*>(w)->value();
 
     return nullptr;
 }
@@ -462,6 +754,12 @@ std::any BackendQtImpl::new_input(const tanto::types::Widget& arg,
         auto* w = new QPlainTextEdit();
         w->setEnabled(arg.enabled);
         w->setPlainText(QString::fromStdString(arg.text));
+
+        if(this->observed(arg)) {
+            QObject::connect(w, &QPlainTextEdit::textChanged, w,
+                             [&, arg]() { this->value_changed(arg); });
+        }
+
         return apply_parent(w, qtcontainer_cast(parent), arg);
     }
 
@@ -470,6 +768,25 @@ std::any BackendQtImpl::new_input(const tanto::types::Widget& arg,
     w->setText(QString::fromStdString(arg.text));
     w->setPlaceholderText(
         QString::fromStdString(arg.prop<std::string>("placeholder")));
+
+    if(this->observed(arg)) {
+        QObject::connect(w, &QLineEdit::textChanged, w,
+                         [&, arg]() { this->value_changed(arg); });
+    }
+
+    return apply_parent(w, qtcontainer_cast(parent), arg);
+}
+
+std::any BackendQtImpl::new_log(const tanto::types::Widget& arg,
+                                const std::any& parent) {
+    auto* w = new QPlainTextEdit();
+    w->setEnabled(arg.enabled);
+    w->setReadOnly(true);
+    w->setUndoRedoEnabled(false);
+    w->setLineWrapMode(QPlainTextEdit::NoWrap); // No rewrapping on appends
+    w->setMaximumBlockCount(arg.prop<int>("lines", tanto::LOG_MAX_LINES));
+    w->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    qtlog_append(w, QString::fromStdString(arg.text));
     return apply_parent(w, qtcontainer_cast(parent), arg);
 }
 
@@ -483,6 +800,12 @@ std::any BackendQtImpl::new_number(const tanto::types::Widget& arg,
                 arg.prop<int>("max", tanto::NUMBER_MAX));
 
     w->setValue(arg.value);
+
+    if(this->observed(arg)) {
+        QObject::connect(w, qOverload<int>(&QSpinBox::valueChanged), w,
+                         [&, arg]() { this->value_changed(arg); });
+    }
+
     return apply_parent(w, qtcontainer_cast(parent), arg);
 }
 
@@ -526,6 +849,7 @@ std::any BackendQtImpl::new_check(const tanto::types::Widget& arg,
 
     if(arg.has_id()) {
         QObject::connect(w, &QCheckBox::stateChanged, w, [&, arg](int state) {
+            this->value_changed(arg);
             this->changed(arg, state == Qt::Checked);
         });
     }
@@ -533,6 +857,17 @@ std::any BackendQtImpl::new_check(const tanto::types::Widget& arg,
     return w;
 }
 
+std::any BackendQtImpl::new_progress(const tanto::types::Widget& arg,
+                                     const std::any& parent) {
+    auto* w = new QProgressBar();
+    w->setEnabled(arg.enabled);
+    w->setRange(0, arg.prop<int>("max", tanto::PROGRESS_MAX));
+    w->setValue(arg.value);
+    if(!arg.text.empty())
+        w->setFormat(QString::fromStdString(arg.text));
+    return apply_parent(w, qtcontainer_cast(parent), arg);
+}
+
 std::any BackendQtImpl::new_list(const tanto::types::Widget& arg,
                                  const std::any& parent) {
     return qttree_new(this, arg, parent, false);
@@ -541,6 +876,51 @@ std::any BackendQtImpl::new_tree(const tanto::types::Widget& arg,
                                  const std::any& parent) {
     return qttree_new(this, arg, parent);
 }
+std::any BackendQtImpl::new_gallery(const tanto::types::Widget& arg,
+                                    const std::any& parent) {
+    auto* w = new Gallery(arg.items);
+    w->setEnabled(arg.enabled);
+    apply_parent(w, qtcontainer_cast(parent), arg);
+
+    if(arg.has_id()) {
+        auto itemselected = [&, arg, w](const QModelIndex& index) {
+            this->selected(arg, index.row(),
+                           w->gallery_model()->value(index.row()));
+        };
+
+        qtadd_action(w, QString{}, QKeySequence{Qt::Key_Return}, w,
+                     [w, itemselected]() {
+                         if(w->currentIndex().isValid())
+                             itemselected(w->currentIndex());
+                     });
+
+        QObject::connect(w, &Gallery::doubleClicked, w, itemselected);
+    }
+
+    return w;
+}
+std::any BackendQtImpl::new_files(const tanto::types::Widget& arg,
+                                  const std::any& parent) {
+    auto* w = new FileTree(QString::fromStdString(tanto::files_root(arg)));
+    w->setEnabled(arg.enabled);
+    apply_parent(w, qtcontainer_cast(parent), arg);
+
+    QObject::connect(w, &FileTree::itemExpanded, w,
+                     [&, arg](QTreeWidgetItem* item) {
+                         this->expanded(
+                             arg, FileTree::file_path(item).toStdString());
+                     });
+
+    QObject::connect(w, &FileTree::itemActivated, w,
+                     [&, arg](QTreeWidgetItem* item) {
+                         if(!FileTree::is_dir(item)) {
+                             this->selected(
+                                 arg, FileTree::file_path(item).toStdString());
+                         }
+                     });
+
+    return w;
+}
 std::any BackendQtImpl::new_tabs(const tanto::types::Widget& arg,
                                  const std::any& parent) {
     return apply_parent(new QTabWidget(), qtcontainer_cast(parent), arg);
@@ -570,3 +950,69 @@ std::any BackendQtImpl::new_group(const tanto::types::Widget& arg,
     return apply_parent(new QGroupBox(QString::fromStdString(arg.text)),
                         qtcontainer_cast(parent), arg);
 }
+
+std::any BackendQtImpl::new_scroll(const tanto::types::Widget& arg,
+                                   const std::any& parent) {
+    int rowheight = arg.prop<int>("rowheight", tanto::SCROLL_ROW_HEIGHT);
+    auto* content = new ScrollContent{rowheight};
+    // Qt caps widget sizes, rows past it aren't reachable
+    content->setFixedHeight(static_cast<int>(
+        std::min<int64_t>(static_cast<int64_t>(rowheight) * arg.items.size(),
+                          QWIDGETSIZE_MAX)));
+
+    auto* w = new QScrollArea();
+    w->setEnabled(arg.enabled);
+    w->setWidgetResizable(true); // Rows follow the width
+    w->setWidget(content);
+    w->verticalScrollBar()->setSingleStep(rowheight);
+    return apply_parent(w, qtcontainer_cast(parent), arg);
+}
+
+std::any BackendQtImpl::new_scroll_row(const std::any& scroll, size_t row) {
+    auto* area = std::any_cast<QScrollArea*>(scroll);
+    auto* content = static_cast<ScrollContent*>(area->widget());
+
+    auto* w = new QWidget(content);
+    w->setGeometry(0, static_cast<int>(row) * content->row_height(),
+                   content->width(), content->row_height());
+
+    auto* l = new QVBoxLayout(w);
+    l->setContentsMargins(0, 0, 0, 0);
+    w->show(); // Widgets added to its layout are shown by Qt
+    return l;
+}
+
+void BackendQtImpl::destroy_scroll_row(const std::any& row) {
+    QWidget* w = std::any_cast<QVBoxLayout*>(row)->parentWidget();
+    w->hide();
+    w->deleteLater(); // It may be sending the signal that scrolled it away
+}
+
+void BackendQtImpl::connect_scroll(
+    const std::any& scroll,
+    std::function<void(size_t first, size_t count)> scrolled) {
+    auto* w = std::any_cast<QScrollArea*>(scroll);
+    auto* content = static_cast<ScrollContent*>(w->widget());
+
+    auto update = [w, content, scrolled = std::move(scrolled)]() {
+        int h = content->row_height();
+        scrolled(w->verticalScrollBar()->value() / h,
+                 w->viewport()->height() / h + 1);
+    };
+
+    // The range changes when the viewport is resized
+    QObject::connect(w->verticalScrollBar(), &QScrollBar::valueChanged, w,
+                     update);
+    QObject::connect(w->verticalScrollBar(), &QScrollBar::rangeChanged, w,
+                     update);
+}
+
+void BackendQtImpl::connect_tabs(const std::any& tabs,
+                                 std::function<void(int)> activated) {
+    // Widgets added to a visible layout are shown by Qt
+    auto* w = std::any_cast<QTabWidget*>(tabs);
+    QObject::connect(w, &QTabWidget::currentChanged, w,
+                     [activated = std::move(activated)](int index) {
+                         activated(index);
+                     });
+}
@@ -3,6 +3,10 @@
 #include "../../backend.h"
 #include <QApplication>
 #include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <string>
+#include <unordered_map>
 
 class MainWindow;
 
@@ -10,7 +14,7 @@ class BackendQtImpl: public Backend {
 public:
     BackendQtImpl(int& argc, char** argv);
     ~BackendQtImpl() override;
-    int run() const override;
+    int run() override;
     void exit() override;
     nlohmann::json get_model_data(const tanto::types::Widget& arg,
                                   const std::any& w) override;
@@ -28,6 +32,10 @@ public:
 
 private:
     std::any new_window(const tanto::types::Window& arg) override;
+    void destroy_window(const std::string& window) override;
+    void update_widget(const std::string& type, const std::any& widget,
+                       std::string_view property,
+                       const nlohmann::json& value) override;
     std::any new_space(const tanto::types::Widget& arg,
                        const std::any& parent) override;
     std::any new_text(const tanto::types::Widget& arg,
@@ -42,10 +50,18 @@ private:
                         const std::any& parent) override;
     std::any new_check(const tanto::types::Widget& arg,
                        const std::any& parent) override;
+    std::any new_progress(const tanto::types::Widget& arg,
+                          const std::any& parent) override;
+    std::any new_log(const tanto::types::Widget& arg,
+                     const std::any& parent) override;
     std::any new_list(const tanto::types::Widget& arg,
                       const std::any& parent) override;
     std::any new_tree(const tanto::types::Widget& arg,
                       const std::any& parent) override;
+    std::any new_gallery(const tanto::types::Widget& arg,
+                         const std::any& parent) override;
+    std::any new_files(const tanto::types::Widget& arg,
+                       const std::any& parent) override;
     std::any new_tabs(const tanto::types::Widget& arg,
                       const std::any& parent) override;
     std::any new_row(const tanto::types::Widget& arg,
@@ -58,8 +74,19 @@ private:
                       const std::any& parent) override;
     std::any new_group(const tanto::types::Widget& arg,
                        const std::any& parent) override;
+    void processed(const std::any& window) override;
+    void connect_tabs(const std::any& tabs,
+                      std::function<void(int)> activated) override;
+    std::any new_scroll(const tanto::types::Widget& arg,
+                        const std::any& parent) override;
+    std::any new_scroll_row(const std::any& scroll, size_t row) override;
+    void destroy_scroll_row(const std::any& row) override;
+    void connect_scroll(
+        const std::any& scroll,
+        std::function<void(size_t first, size_t count)> scrolled) override;
 
 private:
     QApplication m_app;
-    MainWindow* m_mainwindow{nullptr};
+    QTimer m_updatetimer; // Applies queued updates once per frame
+    std::unordered_map<std::string, QPointer<MainWindow>> m_toplevels;
 };
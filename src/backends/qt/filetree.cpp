@@ -0,0 +1,99 @@
+#include "filetree.h"
+#include "../../dirlist.h"
+#include <QStyle>
+
+namespace {
+
+constexpr int PATH_ROLE = Qt::UserRole;
+constexpr int ISDIR_ROLE = Qt::UserRole + 1;
+
+[[nodiscard]] tanto::DirEntry filetree_entry(const QTreeWidgetItem* item) {
+    return tanto::DirEntry{item->text(0).toStdString(),
+                           item->data(0, ISDIR_ROLE).toBool()};
+}
+
+// First child of 'parent' from 'first' on that comes after 'e'
+[[nodiscard]] int filetree_position(const QTreeWidgetItem* parent, int first,
+                                    const tanto::DirEntry& e) {
+    int last = parent->childCount();
+
+    while(first < last) { // Children are sorted
+        int mid = first + (last - first) / 2;
+        if(tanto::less_entry(e, filetree_entry(parent->child(mid))))
+            last = mid;
+        else
+            first = mid + 1;
+    }
+
+    return first;
+}
+
+} // namespace
+
+FileTree::FileTree(QString root, QWidget* parent): QTreeWidget{parent} {
+    this->setHeaderHidden(true);
+    this->setUniformRowHeights(true); // Layout doesn't query every item
+    this->setSelectionMode(QTreeWidget::SingleSelection);
+    m_dirs[root] = this->invisibleRootItem();
+}
+
+QString FileTree::file_path(const QTreeWidgetItem* item) {
+    return item->data(0, PATH_ROLE).toString();
+}
+
+bool FileTree::is_dir(const QTreeWidgetItem* item) {
+    return item->data(0, ISDIR_ROLE).toBool();
+}
+
+void FileTree::add_entries(const nlohmann::json& listings) {
+    QIcon diricon = this->style()->standardIcon(QStyle::SP_DirIcon);
+    QIcon fileicon = this->style()->standardIcon(QStyle::SP_FileIcon);
+
+    for(const auto& [d, listing] : listings.items()) {
+        QString dir = QString::fromStdString(d);
+        QTreeWidgetItem* parent = m_dirs.value(dir);
+        if(!parent)
+            continue;
+
+        QString prefix = dir.endsWith('/') ? dir : dir + '/';
+        QList<QTreeWidgetItem*> items;
+        int position = 0;
+
+        // Batches are sorted, but not with each other: they're merged, a
+        // run of entries going to the same position is a single insertion
+        for(const nlohmann::json& e : listing.at("entries")) {
+            tanto::DirEntry entry{e[0].get<std::string>(), e[1].get<bool>()};
+            int pos = filetree_position(parent, position, entry);
+
+            if(pos != position && !items.isEmpty()) {
+                parent->insertChildren(position, items);
+                pos += items.size();
+                items.clear();
+            }
+
+            position = pos;
+            QString name = QString::fromStdString(entry.name);
+            bool isdir = entry.isdir;
+
+            auto* item = new QTreeWidgetItem(QStringList{name});
+            item->setIcon(0, isdir ? diricon : fileicon);
+            item->setData(0, PATH_ROLE, prefix + name);
+            item->setData(0, ISDIR_ROLE, isdir);
+
+            if(isdir) { // Listed when expanded
+                item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+                m_dirs[prefix + name] = item;
+            }
+            else
+                item->setFlags(item->flags() | Qt::ItemNeverHasChildren);
+
+            items.push_back(item);
+        }
+
+        parent->insertChildren(position, items);
+
+        if(listing.value("done", false))
+            parent->setChildIndicatorPolicy(
+                QTreeWidgetItem::DontShowIndicatorWhenChildless);
+    }
+}
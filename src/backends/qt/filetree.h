@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QTreeWidget>
+#include <nlohmann/json.hpp>
+
+// Directory tree filled by "entries" updates: directories show an expander
+// until they're listed, which happens when they're first expanded.
+class FileTree: public QTreeWidget {
+    Q_OBJECT
+
+public:
+    explicit FileTree(QString root, QWidget* parent = nullptr);
+    void add_entries(const nlohmann::json& listings);
+    [[nodiscard]] static QString file_path(const QTreeWidgetItem* item);
+    [[nodiscard]] static bool is_dir(const QTreeWidgetItem* item);
+
+private:
+    QHash<QString, QTreeWidgetItem*> m_dirs; // By path, root included
+};
@@ -0,0 +1,269 @@
+#include "gallery.h"
+#include "../../httpcache.h"
+#include "../../imagecache.h"
+#include "../../tanto.h"
+#include "../../thumbnails.h"
+#include "../../utils.h"
+#include "../../workerpool.h"
+#include <QApplication>
+#include <QBuffer>
+#include <QColorSpace>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QImageReader>
+#include <QPointer>
+#include <QSaveFile>
+#include <QUrl>
+#include <filesystem>
+
+namespace {
+
+constexpr int GALLERY_SPACING = 8;
+
+using ThumbnailCache = tanto::ImageCache<QImage>;
+
+// With the mtime of the file, or of the body HttpCache has: new versions
+// get new thumbnails
+[[nodiscard]] std::string thumbnail_key(const std::string& source) {
+    tanto::HttpCache& cache = tanto::HttpCache::instance();
+    int64_t mtime = 0;
+
+    if(!tanto::is_url(source))
+        mtime = tanto::thumbnail_mtime(source);
+    else if(cache.enabled())
+        mtime = tanto::thumbnail_mtime(cache.body_path(source));
+
+    return "thumbnail|" + source + "|" + std::to_string(mtime);
+}
+
+[[nodiscard]] QString thumbnail_path(const std::string& uri) {
+    if(uri.empty())
+        return QString{};
+
+    QByteArray md5 = QCryptographicHash::hash(QByteArray::fromStdString(uri),
+                                              QCryptographicHash::Md5)
+                         .toHex();
+
+    return QString::fromStdString(tanto::thumbnail_path(md5.toStdString()));
+}
+
+[[nodiscard]] QImage load_thumbnail(const QString& path, int64_t mtime) {
+    if(path.isEmpty() || !mtime || !QFile::exists(path))
+        return QImage{};
+
+    QImage image{path};
+    if(image.text("Thumb::MTime") != QString::number(mtime))
+        return QImage{};
+
+    return image;
+}
+
+[[nodiscard]] QImage create_thumbnail(const tanto::Download& d,
+                                      const std::string& uri,
+                                      const QString& path, int64_t mtime) {
+    QByteArray bytes;
+    QBuffer buffer;
+    QImageReader reader;
+
+    if(d.filepath.empty() && d.data) {
+        bytes = QByteArray::fromRawData(d.data->data(), d.data->size());
+        buffer.setBuffer(&bytes);
+        buffer.open(QIODevice::ReadOnly);
+        reader.setDevice(&buffer);
+    }
+    else
+        reader.setFileName(QString::fromStdString(d.filepath));
+
+    reader.setAutoTransform(true);
+
+    // Let the decoder scale down (JPEG uses DCT scaling)
+    if(QSize size = reader.size(); size.isValid()) {
+        if(reader.transformation() & QImageIOHandler::TransformationRotate90)
+            size.transpose();
+
+        QSize box{tanto::THUMBNAIL_SIZE, tanto::THUMBNAIL_SIZE};
+        if(size.width() > box.width() || size.height() > box.height()) {
+            QSize scaled = size.scaled(box, Qt::KeepAspectRatio);
+            if(reader.transformation() &
+               QImageIOHandler::TransformationRotate90)
+                scaled.transpose();
+            reader.setScaledSize(scaled);
+        }
+    }
+
+    QImage image = reader.read();
+    if(image.isNull())
+        return image;
+
+    if(image.colorSpace().isValid())
+        image.convertToColorSpace(QColorSpace::SRgb);
+
+    if(!path.isEmpty() && mtime) { // Can't be checked later without one
+        image.setText("Thumb::URI", QString::fromStdString(uri));
+        image.setText("Thumb::MTime", QString::number(mtime));
+
+        QSaveFile f{path}; // Other readers never see partial files
+        if(f.open(QIODevice::WriteOnly) && image.save(&f, "PNG") &&
+           f.commit())
+            QFile::setPermissions(path,
+                                  QFile::ReadOwner | QFile::WriteOwner);
+    }
+
+    return image;
+}
+
+[[nodiscard]] QString item_label(const std::string& source) {
+    if(tanto::is_url(source))
+        return QUrl{QString::fromStdString(source)}.fileName();
+
+    return QString::fromStdString(
+        std::filesystem::path{source}.filename().string());
+}
+
+} // namespace
+
+GalleryModel::GalleryModel(const tanto::types::MultiValueList& items,
+                           QObject* parent)
+    : QAbstractListModel{parent},
+      m_placeholder{tanto::THUMBNAIL_SIZE, tanto::THUMBNAIL_SIZE,
+                    QImage::Format_ARGB32_Premultiplied} {
+    m_placeholder.fill(Qt::transparent);
+    m_items.reserve(items.size());
+
+    for(const tanto::types::MultiValue& item : items) {
+        std::visit(tanto::utils::Overload{
+                       [&](const tanto::types::Widget& a) {
+                           m_items.push_back({item_label(a.text), a.text, a});
+                       },
+                       [&](const std::string& a) {
+                           m_items.push_back({item_label(a), a, a});
+                       }},
+                   item);
+    }
+}
+
+tanto::types::MultiValue GalleryModel::value(int row) const {
+    return m_items.at(row).value;
+}
+
+int GalleryModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(m_items.size());
+}
+
+QVariant GalleryModel::data(const QModelIndex& index, int role) const {
+    if(!index.isValid() || index.row() >= this->rowCount())
+        return QVariant{};
+
+    const Item& item = m_items[index.row()];
+
+    switch(role) {
+        case Qt::DisplayRole: return item.label;
+        case Qt::ToolTipRole: return QString::fromStdString(item.source);
+
+        case Qt::DecorationRole: {
+            auto thumbnail =
+                ThumbnailCache::instance().get(thumbnail_key(item.source));
+            if(thumbnail)
+                return *thumbnail;
+
+            this->request(index.row());
+            return m_placeholder;
+        }
+
+        default: break;
+    }
+
+    return QVariant{};
+}
+
+void GalleryModel::request(int row) const {
+    if(m_pending.contains(row))
+        return;
+
+    m_pending.insert(row);
+
+    QPointer<GalleryModel> self{const_cast<GalleryModel*>(this)};
+    std::string source = m_items[row].source;
+
+    auto done = [self, row, key = thumbnail_key(source)](const QImage& image) {
+        QMetaObject::invokeMethod(
+            qApp,
+            [self, row, key, image]() {
+                if(!self || image.isNull())
+                    return; // Failed thumbnails stay pending
+
+                ThumbnailCache::instance().insert(
+                    key, std::make_shared<QImage>(image), image.sizeInBytes());
+
+                self->m_pending.remove(row);
+                QModelIndex index = self->index(row);
+                Q_EMIT self->dataChanged(index, index, {Qt::DecorationRole});
+            },
+            Qt::QueuedConnection);
+    };
+
+    // The pool stopped: ask again on the next paint
+    auto retry = [self, row]() {
+        QMetaObject::invokeMethod(
+            qApp,
+            [self, row]() {
+                if(self)
+                    self->m_pending.remove(row);
+            },
+            Qt::QueuedConnection);
+    };
+
+    auto load = [source, done, retry]() {
+        std::string uri = tanto::thumbnail_uri(source);
+        QString path = thumbnail_path(uri);
+        int64_t mtime = tanto::thumbnail_mtime(source); // 0 if remote
+
+        if(QImage image = load_thumbnail(path, mtime); !image.isNull()) {
+            done(image);
+            return;
+        }
+
+        tanto::download_file(source, [uri, path, mtime, done,
+                                      retry](const tanto::Download& d) {
+            auto create = [d, uri, path, mtime, done]() {
+                if(!d.ok() || mtime) {
+                    done(d.ok() ? create_thumbnail(d, uri, path, mtime)
+                                : QImage{});
+                    return;
+                }
+
+                // Remote ones are valid while HttpCache keeps the same body
+                int64_t bodymtime = d.filepath.empty()
+                                        ? 0
+                                        : tanto::thumbnail_mtime(d.filepath);
+                QImage image = load_thumbnail(path, bodymtime);
+                done(image.isNull()
+                         ? create_thumbnail(d, uri, path, bodymtime)
+                         : image);
+            };
+
+            if(!tanto::WorkerPool::instance().push(create)) // Stopped
+                retry();
+        });
+    };
+
+    if(!tanto::WorkerPool::instance().push(load)) // Stopped
+        m_pending.remove(row);
+}
+
+Gallery::Gallery(const tanto::types::MultiValueList& items, QWidget* parent)
+    : QListView{parent}, m_model{new GalleryModel(items, this)} {
+    int textheight = this->fontMetrics().height();
+
+    this->setViewMode(QListView::IconMode);
+    this->setMovement(QListView::Static);
+    this->setResizeMode(QListView::Adjust);
+    this->setUniformItemSizes(true); // Layout doesn't query every item
+    this->setSelectionMode(QListView::SingleSelection);
+    this->setTextElideMode(Qt::ElideMiddle);
+    this->setSpacing(GALLERY_SPACING);
+    this->setIconSize(QSize{tanto::THUMBNAIL_SIZE, tanto::THUMBNAIL_SIZE});
+    this->setGridSize(QSize{tanto::THUMBNAIL_SIZE + GALLERY_SPACING * 2,
+                            tanto::THUMBNAIL_SIZE + textheight * 2});
+    this->setModel(m_model);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../../types.h"
+#include <QAbstractListModel>
+#include <QImage>
+#include <QListView>
+#include <QSet>
+#include <string>
+#include <vector>
+
+class GalleryModel: public QAbstractListModel {
+    Q_OBJECT
+
+private:
+    struct Item {
+        QString label;
+        std::string source;
+        tanto::types::MultiValue value;
+    };
+
+public:
+    explicit GalleryModel(const tanto::types::MultiValueList& items,
+                          QObject* parent = nullptr);
+    [[nodiscard]] tanto::types::MultiValue value(int row) const;
+    [[nodiscard]] int rowCount(const QModelIndex& parent = {}) const override;
+    [[nodiscard]] QVariant data(const QModelIndex& index,
+                                int role) const override;
+
+private:
+    void request(int row) const;
+
+private:
+    std::vector<Item> m_items;
+    mutable QSet<int> m_pending; // Requested or failed thumbnails
+    QImage m_placeholder;
+};
+
+// Icon grid where only visible cells ask for their thumbnail: these are
+// generated in the worker pool and kept in the freedesktop.org store.
+class Gallery: public QListView {
+    Q_OBJECT
+
+public:
+    explicit Gallery(const tanto::types::MultiValueList& items,
+                     QWidget* parent = nullptr);
+    [[nodiscard]] inline GalleryModel* gallery_model() const {
+        return m_model;
+    }
+
+private:
+    GalleryModel* m_model;
+};
@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "../../trace.h"
 #include <QApplication>
 #include <QEvent>
 
@@ -8,5 +9,16 @@ bool MainWindow::event(QEvent* event) {
     if(event->type() == QEvent::Close && this->windowFlags() & Qt::Popup)
         qApp->exit();
 
-    return QMainWindow::event(event);
+    bool res = QMainWindow::event(event);
+
+    if(event->type() == QEvent::Close && event->isAccepted())
+        Q_EMIT closed();
+
+    // Backing store is flushed while handling the first update request
+    if(event->type() == QEvent::UpdateRequest && !m_painted) {
+        m_painted = true;
+        tanto::trace::instant("first paint", "backend");
+    }
+
+    return res;
 }
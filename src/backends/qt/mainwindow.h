@@ -8,6 +8,12 @@ class MainWindow: public QMainWindow {
 public:
     explicit MainWindow(QWidget* parent = nullptr);
 
+Q_SIGNALS:
+    void closed();
+
 protected:
     bool event(QEvent* event) override;
+
+private:
+    bool m_painted{false};
 };
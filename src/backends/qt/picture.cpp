@@ -1,11 +1,125 @@
 #include "picture.h"
+#include "../../httpcache.h"
+#include "../../imagecache.h"
 #include "../../tanto.h"
+#include "../../trace.h"
 #include "../../utils.h"
+#include "../../workerpool.h"
+#include <QApplication>
+#include <QBuffer>
 #include <QColorSpace>
 #include <QImageReader>
 #include <QLabel>
 #include <QMouseEvent>
+#include <QPointer>
+#include <QScreen>
 #include <QUrl>
+#include <chrono>
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+constexpr int IMAGE_DECODE_STEP = 256;
+
+[[nodiscard]] QImage read_image(QImageReader& reader, const QSize& target) {
+    reader.setAutoTransform(true);
+
+    // Let the decoder scale down (JPEG uses DCT scaling) when size is known
+    if(QSize size = reader.size();
+       size.isValid() && (target.width() || target.height())) {
+        bool rotated =
+            reader.transformation() & QImageIOHandler::TransformationRotate90;
+        if(rotated)
+            size.transpose();
+
+        QSize scaled = target.width()
+                           ? QSize{target.width(),
+                                   static_cast<int>(std::ceil(
+                                       target.width() * size.height() /
+                                       static_cast<double>(size.width())))}
+                           : QSize{static_cast<int>(std::ceil(
+                                       target.height() * size.width() /
+                                       static_cast<double>(size.height()))),
+                                   target.height()};
+
+        if(scaled.width() < size.width()) {
+            if(rotated)
+                scaled.transpose();
+            reader.setScaledSize(scaled);
+        }
+    }
+
+    QImage image = reader.read();
+    if(image.colorSpace().isValid())
+        image.convertToColorSpace(QColorSpace::SRgb);
+    return image;
+}
+
+[[nodiscard]] QImage read_image(const QString& filepath,
+                                const QSize& target = {}) {
+    QImageReader reader{filepath};
+    return read_image(reader, target);
+}
+
+[[nodiscard]] QImage read_image(const std::string& data, const QSize& target) {
+    QByteArray bytes = QByteArray::fromRawData(data.data(), data.size());
+    QBuffer buffer{&bytes};
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader{&buffer};
+    return read_image(reader, target);
+}
+
+[[nodiscard]] std::shared_ptr<QImage> decode_image(const tanto::Download& d,
+                                                   const std::string& source,
+                                                   const QSize& target,
+                                                   bool persist) {
+    auto& cache = tanto::ImageCache<QImage>::instance();
+    QString filepath = QString::fromStdString(d.filepath);
+    std::string key = d.filepath.empty() && d.data
+                          ? tanto::image_key(source, *d.data)
+                          : tanto::image_key(d.filepath);
+
+    if(!key.empty() && (target.width() || target.height()))
+        key += "@" + std::to_string(target.width()) + "x" +
+               std::to_string(target.height());
+
+    // Remote images with a fixed size keep a scaled copy in the HTTP cache
+    QString variant;
+
+    if(persist) {
+        variant = QString::fromStdString(
+            tanto::HttpCache::instance().variant_path(
+                d.filepath, target.width(), target.height()));
+    }
+
+    return cache.load(key, [&]() {
+        tanto::trace::Span span{"decode", "image"};
+        span.arg("source", source);
+        QImage image;
+
+        if(filepath.isEmpty() && d.data) // Straight from the downloaded body
+            image = read_image(*d.data, target);
+        else {
+            if(!variant.isEmpty())
+                image = read_image(variant);
+
+            if(image.isNull()) {
+                image = read_image(filepath, target);
+                if(!variant.isEmpty() && !image.isNull() &&
+                   image.save(variant, "PNG"))
+                    tanto::HttpCache::instance().add_variant(
+                        variant.toStdString());
+            }
+        }
+
+        auto p = std::make_shared<QImage>(std::move(image));
+        return std::make_pair(p, static_cast<size_t>(p->sizeInBytes()));
+    });
+}
+
+} // namespace
 
 Picture::Picture(QWidget* parent): QScrollArea{parent}, m_label(new QLabel()) {
     m_label->installEventFilter(this);
@@ -32,14 +146,66 @@ bool Picture::eventFilter(QObject* watched, QEvent* event) {
 }
 
 void Picture::load_image(const std::string& imagepath) {
-    m_filepath = QString::fromStdString(tanto::download_file(imagepath));
+    m_source = imagepath;
 
-    QImageReader reader{m_filepath};
-    reader.setAutoTransform(true);
+    if(m_width || m_height) { // Reserve space until the image arrives
+        m_label->setMinimumSize(m_width, m_height);
+        m_target = QSize{m_width, m_height};
+    }
+    else // It can't be wider than the screen, decode() grows it if needed
+        m_target = QSize{this->screen()->availableGeometry().width(), 0};
+
+    this->decode();
+}
+
+void Picture::decode() {
+    QPointer<Picture> self{this};
+    auto start = std::chrono::steady_clock::now();
+    bool persist = m_width || m_height;
+    int generation = ++m_generation;
 
-    m_image = reader.read();
-    if(m_image.colorSpace().isValid())
-        m_image.convertToColorSpace(QColorSpace::SRgb);
+    tanto::download_file(m_source, [self, imagepath = m_source, start,
+                                    target = m_target, persist,
+                                    generation](const tanto::Download& d) {
+        auto decode = [self, imagepath, d, start, target, persist,
+                       generation]() {
+            std::shared_ptr<QImage> image =
+                decode_image(d, imagepath, target, persist);
+
+            QMetaObject::invokeMethod(
+                qApp,
+                [self, imagepath, d, image, start, generation]() {
+                    if(!self || generation != self->m_generation)
+                        return; // Gone or superseded by a larger decode
+
+                    self->set_image(d, image);
+
+                    spdlog::debug(
+                        "image_loaded: '{}' in {}ms", imagepath,
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+                },
+                Qt::QueuedConnection);
+        };
+
+        if(!tanto::WorkerPool::instance().push(decode)) // Stopped
+            spdlog::debug("image_dropped: '{}'", imagepath);
+    });
+}
+
+const QString& Picture::file_path() {
+    if(m_filepath.isEmpty() && m_data) // Write it down only when asked
+        m_filepath = QString::fromStdString(tanto::save_temp(*m_data));
+    return m_filepath;
+}
+
+void Picture::set_image(const tanto::Download& d,
+                        std::shared_ptr<QImage> image) {
+    m_filepath = QString::fromStdString(d.filepath);
+    m_data = d.data;
+    m_image = std::move(image);
+    m_label->setMinimumSize(0, 0);
     this->update_image();
 }
 
@@ -49,7 +215,10 @@ void Picture::resizeEvent(QResizeEvent* e) {
 }
 
 void Picture::update_image() {
-    double ratio = m_image.height() / static_cast<double>(m_image.width());
+    if(!m_image || m_image->isNull())
+        return;
+
+    double ratio = m_image->height() / static_cast<double>(m_image->width());
     int w{}, h{};
 
     if(m_width) {
@@ -63,8 +232,14 @@ void Picture::update_image() {
     else {
         w = this->width();
         h = std::ceil(this->width() * ratio);
+
+        if(w > m_target.width()) { // Grown past the decoded size
+            m_target.setWidth((w / IMAGE_DECODE_STEP + 1) * IMAGE_DECODE_STEP);
+            this->decode();
+        }
     }
 
-    m_label->setPixmap(QPixmap::fromImage(m_image.scaled(
+    tanto::trace::Span span{"scale", "image"};
+    m_label->setPixmap(QPixmap::fromImage(m_image->scaled(
         QSize{w, h}, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)));
 }
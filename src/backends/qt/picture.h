@@ -1,8 +1,10 @@
 #pragma once
 
+#include "../../tanto.h"
 #include <QImage>
 #include <QLabel>
 #include <QScrollArea>
+#include <memory>
 #include <string>
 
 class Picture: public QScrollArea {
@@ -10,7 +12,7 @@ class Picture: public QScrollArea {
 
 public:
     explicit Picture(QWidget* parent = nullptr);
-    [[nodiscard]] inline const QString& file_path() const { return m_filepath; }
+    [[nodiscard]] const QString& file_path();
     void load_image(const std::string& imagepath);
 
     inline void set_image_size(int w, int h) {
@@ -19,6 +21,8 @@ public:
     }
 
 private:
+    void decode();
+    void set_image(const tanto::Download& d, std::shared_ptr<QImage> image);
     void update_image();
 
 Q_SIGNALS:
@@ -32,7 +36,10 @@ protected:
 
 private:
     QLabel* m_label;
-    QImage m_image;
+    std::shared_ptr<QImage> m_image;
+    std::shared_ptr<const std::string> m_data;
     QString m_filepath;
-    int m_width{0}, m_height{0};
+    QSize m_target;
+    std::string m_source;
+    int m_width{0}, m_height{0}, m_generation{0};
 };
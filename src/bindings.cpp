@@ -0,0 +1,332 @@
+#include "bindings.h"
+#include "error.h"
+#include "utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+
+namespace tanto {
+
+namespace {
+
+[[nodiscard]] bool truthy(const nlohmann::json& v) {
+    if(v.is_boolean())
+        return v.get<bool>();
+    if(v.is_number())
+        return std::fpclassify(v.get<double>()) != FP_ZERO;
+    if(v.is_string())
+        return !v.get_ref<const std::string&>().empty();
+    return !v.is_null() && !v.empty();
+}
+
+// <0, 0 or >0 like strcmp(), nullopt if the values can't be ordered
+[[nodiscard]] std::optional<int> compare(const nlohmann::json& a,
+                                        const nlohmann::json& b) {
+    if(auto na = utils::to_number(a), nb = utils::to_number(b); na && nb)
+        return (*na > *nb) - (*na < *nb);
+
+    if(a.is_string() && b.is_string())
+        return a.get_ref<const std::string&>().compare(
+            b.get_ref<const std::string&>());
+
+    if(a == b)
+        return 0;
+    return std::nullopt;
+}
+
+[[nodiscard]] bool is_identifier(char c, bool first) {
+    auto uc = static_cast<unsigned char>(c);
+    return std::isalpha(uc) || c == '_' ||
+           (!first && (std::isdigit(uc) || c == '-' || c == '.'));
+}
+
+} // namespace
+
+// Recursive descent, from the lowest precedence:
+//   or  := and ("||" and)*
+//   and := not ("&&" not)*
+//   not := "!" not | cmp
+//   cmp := primary (("==" | "!=" | "<=" | ">=" | "<" | ">") primary)?
+class ExpressionParser {
+public:
+    ExpressionParser(std::string_view src, Expression& e): m_src{src}, m_e{e} {}
+
+    void parse() {
+        this->parse_or();
+        this->skip_spaces();
+        if(m_pos != m_src.size())
+            this->error(fmt::format("unexpected '{}'", m_src.substr(m_pos)));
+    }
+
+private:
+    [[noreturn]] void error(const std::string& msg) const {
+        reject("Invalid expression '{}': {}", m_src, msg);
+    }
+
+    void skip_spaces() {
+        while(m_pos < m_src.size() &&
+              std::isspace(static_cast<unsigned char>(m_src[m_pos])))
+            m_pos++;
+    }
+
+    bool accept(std::string_view token) {
+        this->skip_spaces();
+        if(m_src.substr(m_pos, token.size()) != token)
+            return false;
+
+        m_pos += token.size();
+        return true;
+    }
+
+    void emit(Expression::Op op, size_t arg = 0) {
+        m_e.m_code.push_back({op, arg});
+    }
+
+    void push_const(nlohmann::json v) {
+        m_e.m_consts.push_back(std::move(v));
+        this->emit(Expression::Op::CONST, m_e.m_consts.size() - 1);
+    }
+
+    void push_var(std::string id) {
+        auto it = std::find(m_e.m_deps.begin(), m_e.m_deps.end(), id);
+        if(it == m_e.m_deps.end())
+            it = m_e.m_deps.insert(it, std::move(id));
+        this->emit(Expression::Op::VAR, it - m_e.m_deps.begin());
+    }
+
+    void parse_or() {
+        this->parse_and();
+        while(this->accept("||")) {
+            this->parse_and();
+            this->emit(Expression::Op::OR);
+        }
+    }
+
+    void parse_and() {
+        this->parse_not();
+        while(this->accept("&&")) {
+            this->parse_not();
+            this->emit(Expression::Op::AND);
+        }
+    }
+
+    void parse_not() {
+        if(this->accept("!")) {
+            this->parse_not();
+            this->emit(Expression::Op::NOT);
+        }
+        else
+            this->parse_comparison();
+    }
+
+    void parse_comparison() {
+        using Op = Expression::Op;
+
+        // Longest first: "<=" isn't "<" followed by "="
+        static constexpr std::pair<std::string_view, Op> OPERATORS[] = {
+            {"==", Op::EQ}, {"!=", Op::NE}, {"<=", Op::LE},
+            {">=", Op::GE}, {"<", Op::LT},  {">", Op::GT},
+        };
+
+        this->parse_primary();
+
+        for(const auto& [token, op] : OPERATORS) {
+            if(this->accept(token)) {
+                this->parse_primary();
+                this->emit(op);
+                return;
+            }
+        }
+    }
+
+    void parse_primary() {
+        this->skip_spaces();
+        if(m_pos == m_src.size())
+            this->error("unexpected end");
+
+        char c = m_src[m_pos];
+
+        if(c == '(') {
+            m_pos++;
+            this->parse_or();
+            if(!this->accept(")"))
+                this->error("missing ')'");
+        }
+        else if(c == '\'' || c == '"') {
+            size_t end = m_src.find(c, m_pos + 1);
+            if(end == std::string_view::npos)
+                this->error("unterminated string");
+
+            this->push_const(
+                std::string{m_src.substr(m_pos + 1, end - m_pos - 1)});
+            m_pos = end + 1;
+        }
+        else if(std::isdigit(static_cast<unsigned char>(c)) || c == '-' ||
+                c == '.') {
+            std::string s{m_src.substr(m_pos)};
+            char* end = nullptr;
+            double d = std::strtod(s.c_str(), &end);
+            if(end == s.c_str())
+                this->error(fmt::format("invalid number at '{}'", s));
+
+            this->push_const(d);
+            m_pos += end - s.c_str();
+        }
+        else if(is_identifier(c, true)) {
+            size_t start = m_pos;
+            while(m_pos < m_src.size() && is_identifier(m_src[m_pos], false))
+                m_pos++;
+
+            std::string_view id = m_src.substr(start, m_pos - start);
+
+            if(id == "true" || id == "false")
+                this->push_const(id == "true");
+            else if(id == "null")
+                this->push_const(nullptr);
+            else
+                this->push_var(std::string{id});
+        }
+        else
+            this->error(fmt::format("unexpected '{}'", c));
+    }
+
+private:
+    std::string_view m_src;
+    Expression& m_e;
+    size_t m_pos{0};
+};
+
+Expression Expression::compile(std::string_view src) {
+    Expression e;
+    ExpressionParser{src, e}.parse();
+    return e;
+}
+
+bool Expression::eval(const Lookup& value) const {
+    std::vector<nlohmann::json> stack;
+    stack.reserve(m_code.size());
+
+    // Variables are read once, even if used more than once
+    std::vector<std::optional<nlohmann::json>> vars(m_deps.size());
+
+    for(const Instruction& ins : m_code) {
+        if(ins.op == Op::CONST) {
+            stack.push_back(m_consts[ins.arg]);
+            continue;
+        }
+
+        if(ins.op == Op::VAR) {
+            if(!vars[ins.arg])
+                vars[ins.arg] = value(m_deps[ins.arg]);
+            stack.push_back(*vars[ins.arg]);
+            continue;
+        }
+
+        if(ins.op == Op::NOT) {
+            stack.back() = !truthy(stack.back());
+            continue;
+        }
+
+        nlohmann::json b = std::move(stack.back());
+        stack.pop_back();
+        nlohmann::json& a = stack.back();
+        std::optional<int> cmp;
+
+        switch(ins.op) {
+            case Op::AND: a = truthy(a) && truthy(b); break;
+            case Op::OR: a = truthy(a) || truthy(b); break;
+            case Op::EQ: a = compare(a, b) == 0; break;
+            case Op::NE: a = compare(a, b) != 0; break;
+
+            default:
+                cmp = compare(a, b);
+                if(!cmp) { // Unordered values: every comparison is false
+                    a = false;
+                    break;
+                }
+
+                switch(ins.op) {
+                    case Op::LT: a = *cmp < 0; break;
+                    case Op::LE: a = *cmp <= 0; break;
+                    case Op::GT: a = *cmp > 0; break;
+                    case Op::GE: a = *cmp >= 0; break;
+                    default: unreachable;
+                }
+                break;
+        }
+    }
+
+    assume(stack.size() == 1);
+    return truthy(stack.back());
+}
+
+void BindingGraph::add(const types::Widget& w) {
+    this->add(w, "enabled_if", "enabled");
+    this->add(w, "visible_if", "visible");
+}
+
+void BindingGraph::add(const types::Widget& w, std::string_view key,
+                       std::string_view property) {
+    if(!w.has_prop(key))
+        return;
+
+    if(!w.has_id()) // Updates find widgets by id
+        reject("'{}' needs an id for '{}'", w.type, key);
+
+    size_t idx = m_bindings.size();
+    m_bindings.push_back(
+        Binding{w.id, std::string{property},
+                Expression::compile(w.prop<std::string>(key))});
+
+    for(const std::string& dep : m_bindings.back().expr.deps())
+        m_dependents[dep].push_back(idx);
+}
+
+const std::vector<size_t>&
+BindingGraph::dependents(const std::string& id) const {
+    static const std::vector<size_t> NONE;
+
+    auto it = m_dependents.find(id);
+    return it != m_dependents.end() ? it->second : NONE;
+}
+
+std::shared_ptr<const BindingGraph> compile_bindings(const types::Window& w) {
+    auto graph = std::make_shared<BindingGraph>();
+    std::unordered_set<std::string> ids;
+    std::vector<const types::Widget*> stack{&w.body};
+
+    while(!stack.empty()) {
+        const types::Widget* widget = stack.back();
+        stack.pop_back();
+        graph->add(*widget);
+
+        if(widget->has_id())
+            ids.insert(widget->id);
+        if(widget->type == "list" || widget->type == "tree" ||
+           widget->type == "gallery")
+            continue; // Rows aren't widgets
+
+        for(const auto& item : widget->items) {
+            if(const auto* c = std::get_if<types::Widget>(&item); c)
+                stack.push_back(c);
+        }
+    }
+
+    for(const Binding& b : graph->bindings()) { // Values are looked up by id
+        for(const std::string& dep : b.expr.deps()) {
+            if(!ids.count(dep))
+                reject("'{}' refers to unknown id '{}'", b.id, dep);
+        }
+    }
+
+    if(graph->bindings().empty())
+        return nullptr;
+    return graph;
+}
+
+} // namespace tanto
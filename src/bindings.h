@@ -0,0 +1,80 @@
+#pragma once
+
+#include "types.h"
+#include <functional>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tanto {
+
+// Boolean expressions over widget values, compiled to a small stack program:
+//   check && !(count > 3 || mode == 'fast')
+// Identifiers are widget ids, literals are numbers, quoted strings, true,
+// false and null. Strings holding numbers compare as numbers.
+class Expression {
+private:
+    enum class Op { CONST, VAR, NOT, AND, OR, EQ, NE, LT, LE, GT, GE };
+
+    struct Instruction {
+        Op op;
+        size_t arg{0}; // Index in m_consts or m_deps
+    };
+
+public:
+    using Lookup = std::function<nlohmann::json(const std::string& id)>;
+
+public:
+    static Expression compile(std::string_view src);
+    [[nodiscard]] bool eval(const Lookup& value) const;
+
+    // Ids it reads, without duplicates
+    [[nodiscard]] inline const std::vector<std::string>& deps() const {
+        return m_deps;
+    }
+
+private:
+    friend class ExpressionParser;
+    std::vector<Instruction> m_code;
+    std::vector<nlohmann::json> m_consts;
+    std::vector<std::string> m_deps;
+};
+
+struct Binding {
+    std::string id, property; // The bound widget and "enabled"/"visible"
+    Expression expr;
+};
+
+// "enabled_if" and "visible_if" of a window, indexed by the ids they read:
+// a change re-evaluates only the bindings depending on that widget.
+class BindingGraph {
+public:
+    void add(const types::Widget& w);
+
+    [[nodiscard]] inline const std::vector<Binding>& bindings() const {
+        return m_bindings;
+    }
+
+    [[nodiscard]] inline bool observed(const std::string& id) const {
+        return m_dependents.count(id);
+    }
+
+    [[nodiscard]] const std::vector<size_t>&
+    dependents(const std::string& id) const;
+
+private:
+    void add(const types::Widget& w, std::string_view key,
+             std::string_view property);
+
+private:
+    std::vector<Binding> m_bindings;
+    std::unordered_map<std::string, std::vector<size_t>> m_dependents;
+};
+
+// nullptr if the window has no bindings
+std::shared_ptr<const BindingGraph> compile_bindings(const types::Window& w);
+
+} // namespace tanto
@@ -0,0 +1,182 @@
+#include "backends.h"
+#include "tanto.h"
+#include <array>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <tanto/tanto.h>
+#include <vector>
+
+struct tanto_backend {
+    std::string name;
+    std::array<char*, 2> argv{};
+    int argc{1}; // Referenced by the backend, it can't move
+    tanto::BackendPtr backend;
+};
+
+struct tanto_node {
+    nlohmann::json data;
+};
+
+namespace {
+
+// Nothing may unwind through the C API: errors are logged and reported as
+// 'failed'
+template<typename T, typename Function>
+T guarded(T failed, Function f) noexcept {
+    try {
+        return f();
+    }
+    catch(std::exception& e) {
+        spdlog::error(e.what());
+    }
+    catch(...) {
+        spdlog::error("Unknown error");
+    }
+
+    return failed;
+}
+
+template<typename Function>
+void guarded(Function f) noexcept {
+    guarded(0, [&]() {
+        f();
+        return 0;
+    });
+}
+
+int show(tanto_backend* backend,
+         const std::vector<tanto::types::Window>& windows,
+         tanto_event_callback cb, void* userdata) {
+    if(windows.empty())
+        return -1;
+
+    backend->backend->set_event_handler([cb, userdata](const std::string& e) {
+        if(cb)
+            cb(e.c_str(), userdata);
+    });
+
+    int res = -1;
+
+    try {
+        for(const tanto::types::Window& w : windows)
+            backend->backend->process(w);
+
+        res = backend->backend->run();
+    }
+    catch(...) { // Don't leave half built windows to the next call
+        backend->backend->close_all();
+        backend->backend->set_event_handler(nullptr);
+        throw;
+    }
+
+    backend->backend->set_event_handler(nullptr);
+    return res;
+}
+
+} // namespace
+
+extern "C" {
+
+tanto_backend* tanto_backend_new(const char* name) {
+    return guarded<tanto_backend*>(nullptr, [&]() -> tanto_backend* {
+        std::string n = name ? name : tanto::default_backend();
+
+        if(!tanto::has_backend(n)) {
+            spdlog::error("Unsupported backend '{}'", n);
+            return nullptr;
+        }
+
+        auto b = std::make_unique<tanto_backend>();
+        b->name = n;
+        b->argv[0] = b->name.data();
+        b->backend = tanto::new_backend(b->name, b->argc, b->argv.data());
+        return b.release();
+    });
+}
+
+void tanto_backend_free(tanto_backend* backend) {
+    guarded([&]() { delete backend; });
+}
+
+const char* tanto_backend_name(const tanto_backend* backend) {
+    return backend ? backend->name.c_str() : nullptr;
+}
+
+int tanto_show_json(tanto_backend* backend, const char* json,
+                    tanto_event_callback cb, void* userdata) {
+    if(!backend || !json)
+        return -1;
+
+    return guarded(-1, [&]() {
+        return show(backend,
+                    tanto::parse_windows(nlohmann::json::parse(json)), cb,
+                    userdata);
+    });
+}
+
+int tanto_show_node(tanto_backend* backend, const tanto_node* window,
+                    tanto_event_callback cb, void* userdata) {
+    if(!backend || !window)
+        return -1;
+
+    return guarded(-1, [&]() {
+        return show(backend, tanto::parse_windows(window->data), cb,
+                    userdata);
+    });
+}
+
+tanto_node* tanto_node_new(const char* type) {
+    if(!type)
+        return nullptr;
+
+    return guarded<tanto_node*>(nullptr, [&]() {
+        auto* n = new tanto_node{};
+        n->data = {{"type", type}};
+        return n;
+    });
+}
+
+void tanto_node_free(tanto_node* node) { delete node; }
+
+void tanto_node_set_string(tanto_node* node, const char* key,
+                           const char* value) {
+    if(!node || !key)
+        return;
+
+    guarded([&]() {
+        if(value)
+            node->data[key] = value;
+        else
+            node->data[key] = nullptr;
+    });
+}
+
+void tanto_node_set_int(tanto_node* node, const char* key, int value) {
+    if(node && key)
+        guarded([&]() { node->data[key] = value; });
+}
+
+void tanto_node_set_bool(tanto_node* node, const char* key, int value) {
+    if(node && key)
+        guarded([&]() { node->data[key] = static_cast<bool>(value); });
+}
+
+void tanto_node_append(tanto_node* node, const tanto_node* child) {
+    if(!node || !child)
+        return;
+
+    guarded([&]() {
+        if(node->data.value("type", std::string{}) == "window")
+            node->data["body"] = child->data;
+        else
+            node->data["items"].push_back(child->data);
+    });
+}
+
+void tanto_node_append_string(tanto_node* node, const char* item) {
+    if(node && item)
+        guarded([&]() { node->data["items"].push_back(item); });
+}
+
+} // extern "C"
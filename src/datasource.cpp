@@ -0,0 +1,285 @@
+#include "datasource.h"
+#include "utils.h"
+#include <array>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__unix__)
+    #include <unistd.h>
+#elif defined(_WIN32)
+    #include <io.h>
+#endif
+
+namespace tanto {
+
+namespace {
+
+constexpr uint8_t BASE64_INVALID = 0x80;
+constexpr size_t FD_READ_CHUNK = 64 * 1024;
+
+constexpr std::array<uint8_t, 256> BASE64_TABLE = []() {
+    std::array<uint8_t, 256> t{};
+    for(uint8_t& v : t)
+        v = BASE64_INVALID;
+
+    for(int i = 0; i < 26; i++) {
+        t['A' + i] = i;
+        t['a' + i] = 26 + i;
+    }
+
+    for(int i = 0; i < 10; i++)
+        t['0' + i] = 52 + i;
+
+    t['+'] = t['-'] = 62; // Both standard and URL-safe alphabets
+    t['/'] = t['_'] = 63;
+    return t;
+}();
+
+// Table driven, every 4 characters become 3 bytes: invalid characters are
+// tracked by OR-ing their table entries and checked once per group
+std::optional<std::string> base64_decode_strict(std::string_view s) {
+    while(!s.empty() && s.back() == '=')
+        s.remove_suffix(1);
+
+    size_t rem = s.size() % 4;
+    if(rem == 1)
+        return std::nullopt;
+
+    std::string out((s.size() / 4) * 3 + (rem ? rem - 1 : 0), '\0');
+    const auto* in = reinterpret_cast<const unsigned char*>(s.data());
+    auto* o = reinterpret_cast<unsigned char*>(out.data());
+    size_t i = 0, n = s.size() - rem;
+
+    for(; i < n; i += 4, o += 3) {
+        uint32_t a = BASE64_TABLE[in[i]], b = BASE64_TABLE[in[i + 1]],
+                 c = BASE64_TABLE[in[i + 2]], d = BASE64_TABLE[in[i + 3]];
+
+        if((a | b | c | d) & BASE64_INVALID)
+            return std::nullopt;
+
+        uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+        o[0] = v >> 16;
+        o[1] = v >> 8;
+        o[2] = v;
+    }
+
+    if(rem) {
+        uint32_t a = BASE64_TABLE[in[i]], b = BASE64_TABLE[in[i + 1]],
+                 c = rem == 3 ? BASE64_TABLE[in[i + 2]] : 0;
+
+        if((a | b | c) & BASE64_INVALID)
+            return std::nullopt;
+
+        uint32_t v = (a << 18) | (b << 12) | (c << 6);
+        o[0] = v >> 16;
+        if(rem == 3)
+            o[1] = v >> 8;
+    }
+
+    return out;
+}
+
+std::optional<std::string> percent_decode(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+
+    for(size_t i = 0; i < s.size(); i++) {
+        if(s[i] != '%') {
+            out.push_back(s[i]);
+            continue;
+        }
+
+        uint8_t c = 0;
+        auto res = std::from_chars(s.data() + i + 1,
+                                   s.data() + std::min(i + 3, s.size()), c, 16);
+        if(res.ec != std::errc{} || res.ptr != s.data() + i + 3)
+            return std::nullopt;
+
+        out.push_back(static_cast<char>(c));
+        i += 2;
+    }
+
+    return out;
+}
+
+std::optional<std::string> decode_data_uri(std::string_view uri) {
+    uri.remove_prefix(5); // "data:"
+
+    size_t comma = uri.find(',');
+    if(comma == std::string_view::npos)
+        return std::nullopt;
+
+    std::string_view meta = uri.substr(0, comma), data = uri.substr(comma + 1);
+
+    if(meta.size() >= 7 && meta.substr(meta.size() - 7) == ";base64")
+        return base64_decode(data);
+    return percent_decode(data);
+}
+
+// Live reads by source: the windows showing them own them
+std::unordered_map<std::string, std::weak_ptr<FdRead>> g_fdreads;
+std::mutex g_fdmutex;
+
+void close_fd(int fd) {
+#if defined(__unix__)
+    ::close(fd);
+#elif defined(_WIN32)
+    ::_close(fd);
+#endif
+}
+
+// Closes 'fd' whatever happens: it's consumed
+std::optional<std::string> read_fd(int fd) {
+    std::string data;
+
+    for(;;) {
+        size_t offset = data.size();
+        data.resize(offset + FD_READ_CHUNK);
+
+#if defined(__unix__)
+        ssize_t n = ::read(fd, data.data() + offset, FD_READ_CHUNK);
+        if(n < 0 && errno == EINTR) {
+            data.resize(offset);
+            continue;
+        }
+#elif defined(_WIN32)
+        int n = ::_read(fd, data.data() + offset, FD_READ_CHUNK);
+#endif
+
+        data.resize(offset + std::max<decltype(n)>(n, 0));
+        if(n <= 0) {
+            close_fd(fd);
+            return n == 0 ? std::make_optional(std::move(data))
+                          : std::nullopt;
+        }
+    }
+}
+
+} // namespace
+
+bool is_data_source(const std::string& s) {
+    return utils::starts_with(s, "data:") || utils::starts_with(s, "fd:");
+}
+
+std::optional<std::string> base64_decode(std::string_view s) {
+    if(auto res = base64_decode_strict(s); res)
+        return res;
+
+    // Slow path: line-wrapped input
+    std::string compact;
+    compact.reserve(s.size());
+
+    for(char c : s) {
+        if(!std::isspace(static_cast<unsigned char>(c)))
+            compact.push_back(c);
+    }
+
+    if(compact.size() == s.size())
+        return std::nullopt;
+    return base64_decode_strict(compact);
+}
+
+void read_data_source(const std::string& source, const DownloadCallback& cb) {
+    if(utils::starts_with(source, "data:")) {
+        std::optional<std::string> data = decode_data_uri(source);
+        if(!data)
+            spdlog::error("Invalid data URI");
+
+        Download d;
+        if(data)
+            d.data = std::make_shared<const std::string>(std::move(*data));
+
+        cb(d);
+        return;
+    }
+
+    std::shared_ptr<FdRead> r = read_fd_source(source);
+    r->then([r, cb](const Download& d) { cb(d); }); // Alive until then
+}
+
+std::optional<int> parse_fd_source(std::string_view source) {
+    if(source.substr(0, 3) != "fd:")
+        return std::nullopt;
+
+    const char* end = source.data() + source.size();
+    int fd = -1;
+    auto res = std::from_chars(source.data() + 3, end, fd);
+    if(res.ec != std::errc{} || res.ptr != end || fd < FD_SOURCE_MIN)
+        return std::nullopt;
+
+    return fd;
+}
+
+std::shared_ptr<FdRead> read_fd_source(const std::string& source) {
+    std::optional<int> fd = parse_fd_source(source);
+    if(!fd) { // An update, check_widget() rejects the others
+        spdlog::error("Invalid image source: '{}'", source);
+        auto r = std::make_shared<FdRead>();
+        r->finish(Download{});
+        return r;
+    }
+
+    std::lock_guard lock{g_fdmutex};
+
+    if(std::shared_ptr<FdRead> r = g_fdreads[source].lock(); r)
+        return r;
+
+    // Done with the others: descriptors are reused once closed
+    for(auto it = g_fdreads.begin(); it != g_fdreads.end();) {
+        if(it->second.expired())
+            it = g_fdreads.erase(it);
+        else
+            ++it;
+    }
+
+    auto r = std::make_shared<FdRead>();
+    g_fdreads[source] = r;
+
+    std::thread{[r, source, fd = *fd]() {
+        std::optional<std::string> data = read_fd(fd);
+        if(!data)
+            spdlog::error("Cannot read image from '{}'", source);
+
+        Download d;
+        if(data)
+            d.data = std::make_shared<const std::string>(std::move(*data));
+
+        r->finish(d);
+    }}.detach();
+
+    return r;
+}
+
+void FdRead::then(DownloadCallback cb) {
+    std::unique_lock lock{m_mutex};
+
+    if(!m_body) {
+        m_waiting.push_back(std::move(cb));
+        return;
+    }
+
+    Download d = *m_body;
+    lock.unlock();
+    cb(d);
+}
+
+void FdRead::finish(const Download& d) {
+    std::vector<DownloadCallback> waiting;
+
+    {
+        std::lock_guard lock{m_mutex};
+        m_body = d;
+        waiting.swap(m_waiting);
+    }
+
+    for(const DownloadCallback& cb : waiting)
+        cb(d);
+}
+
+} // namespace tanto
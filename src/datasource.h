@@ -0,0 +1,41 @@
+#pragma once
+
+#include "tanto.h"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tanto {
+
+constexpr int FD_SOURCE_MIN = 3; // 0-2 are tanto's own streams
+
+// A descriptor is read once, until EOF, on its own thread: a pipe's writer
+// may take its time. Later loads of the same "fd:N" share the body while
+// its owners (the windows showing it) keep the read alive.
+class FdRead {
+public:
+    void then(DownloadCallback cb); // Right away if it's read
+    void finish(const Download& d);
+
+private:
+    std::mutex m_mutex;
+    std::optional<Download> m_body;
+    std::vector<DownloadCallback> m_waiting;
+};
+
+// Image sources carried inline instead of a path:
+// "data:[<mediatype>][;base64],<data>" and "fd:N" (read until EOF).
+bool is_data_source(const std::string& s);
+std::optional<std::string> base64_decode(std::string_view s);
+void read_data_source(const std::string& source, const DownloadCallback& cb);
+
+// N of "fd:N", std::nullopt unless it's a descriptor an image may consume
+std::optional<int> parse_fd_source(std::string_view source);
+
+// The live read of 'source' ("fd:N"), started if there's none
+std::shared_ptr<FdRead> read_fd_source(const std::string& source);
+
+} // namespace tanto
@@ -0,0 +1,202 @@
+#include "dirlist.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+#if defined(__linux__)
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace tanto {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr size_t DIRLIST_BUFFER = 64 * 1024; // getdents64() batch, in bytes
+
+[[nodiscard]] bool is_glob(std::string_view s) {
+    return s.find_first_of("*?") != std::string_view::npos;
+}
+
+// '*' and '?' only, ASCII case insensitive
+[[nodiscard]] bool glob_match(std::string_view pattern, std::string_view s) {
+    size_t p = 0, i = 0, star = std::string_view::npos, mark = 0;
+
+    auto same = [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) ==
+               std::tolower(static_cast<unsigned char>(b));
+    };
+
+    while(i < s.size()) {
+        if(p < pattern.size() &&
+           (pattern[p] == '?' || same(pattern[p], s[i]))) {
+            p++;
+            i++;
+        }
+        else if(p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            mark = i;
+        }
+        else if(star != std::string_view::npos) { // Let '*' eat one more
+            p = star + 1;
+            i = ++mark;
+        }
+        else
+            return false;
+    }
+
+    while(p < pattern.size() && pattern[p] == '*')
+        p++;
+
+    return p == pattern.size();
+}
+
+using EntryFn = std::function<void(DirEntry e)>;
+
+#if defined(__linux__)
+// Reads the directory in DIRLIST_BUFFER batches, d_type avoids a stat for
+// most entries: only links and filesystems without it need statx()
+bool read_entries(const std::string& dir, bool hidden, const EntryFn& f) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1)
+        return false;
+
+    std::vector<char> buf(DIRLIST_BUFFER);
+    long n = 0;
+
+    while((n = ::syscall(SYS_getdents64, fd, buf.data(), buf.size())) > 0) {
+        for(long off = 0; off < n;) {
+            // Records are d_reclen long, d_name is only as long as needed
+            auto* d = reinterpret_cast<struct dirent64*>(buf.data() + off);
+            off += d->d_reclen;
+
+            std::string_view name = d->d_name;
+            if(name == "." || name == ".." || (!hidden && name[0] == '.'))
+                continue;
+
+            unsigned char type = d->d_type;
+
+            if(type == DT_UNKNOWN || type == DT_LNK) { // Links are followed
+                struct statx stx;
+                type = ::statx(fd, d->d_name,
+                               AT_STATX_DONT_SYNC | AT_NO_AUTOMOUNT,
+                               STATX_TYPE, &stx) == 0 &&
+                               S_ISDIR(stx.stx_mode)
+                           ? DT_DIR
+                           : DT_REG;
+            }
+
+            f(DirEntry{std::string{name}, type == DT_DIR});
+        }
+    }
+
+    int err = errno;
+    ::close(fd);
+    errno = err;
+    return n == 0;
+}
+#else
+bool read_entries(const std::string& dir, bool hidden, const EntryFn& f) {
+    std::error_code ec;
+
+    for(fs::directory_iterator it{dir, ec}, end; !ec && it != end;
+        it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if(!hidden && name[0] == '.')
+            continue;
+
+        std::error_code ec2;
+        f(DirEntry{std::move(name), it->is_directory(ec2)});
+    }
+
+    errno = ec.value();
+    return !ec;
+}
+#endif
+
+} // namespace
+
+std::string files_root(const types::Widget& arg) {
+    std::error_code ec;
+    fs::path root =
+        fs::absolute(arg.prop<std::string>("root", "."), ec).lexically_normal();
+
+    std::string s = root.string();
+    if(s.size() > 1 && s.back() == '/') // "dir/." normalizes to "dir/"
+        s.pop_back();
+    return s;
+}
+
+std::string join_path(std::string_view dir, std::string_view name) {
+    std::string path{dir};
+    if(path.empty() || path.back() != '/')
+        path += '/';
+    path += name;
+    return path;
+}
+
+bool less_entry(const DirEntry& a, const DirEntry& b) {
+    if(a.isdir != b.isdir)
+        return a.isdir;
+
+    auto lower = [](char c) {
+        return std::tolower(static_cast<unsigned char>(c));
+    };
+
+    return std::lexicographical_compare(
+        a.name.begin(), a.name.end(), b.name.begin(), b.name.end(),
+        [&](char x, char y) { return lower(x) < lower(y); });
+}
+
+bool match_filter(const FilterList& filter, std::string_view name) {
+    if(filter.empty())
+        return true;
+
+    for(const Filter& f : filter) {
+        for(const std::string& ext : f.ext) {
+            if(ext == "*")
+                return true;
+
+            if(is_glob(ext) ? glob_match(ext, name)
+                            : glob_match("*." + ext, name))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void list_dir(const std::string& dir, const FilterList& filter, bool hidden,
+              const DirBatch& f) {
+    std::vector<DirEntry> batch;
+
+    // Batches go out while the directory is still being read
+    bool ok = read_entries(dir, hidden, [&](DirEntry e) {
+        if(!e.isdir && !match_filter(filter, e.name))
+            return;
+
+        batch.push_back(std::move(e));
+        if(batch.size() < DIRLIST_BATCH)
+            return;
+
+        std::sort(batch.begin(), batch.end(), less_entry);
+        f(std::move(batch), false);
+        batch.clear();
+    });
+
+    if(!ok)
+        spdlog::warn("Cannot list '{}': {}", dir, std::strerror(errno));
+
+    std::sort(batch.begin(), batch.end(), less_entry);
+    f(std::move(batch), true);
+}
+
+} // namespace tanto
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "tanto.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tanto {
+
+constexpr size_t DIRLIST_BATCH = 1024; // Entries per callback
+
+struct DirEntry {
+    std::string name;
+    bool isdir{false};
+};
+
+using DirBatch = std::function<void(std::vector<DirEntry> entries, bool done)>;
+
+// Absolute path of a "files" widget's "root" (the current directory)
+std::string files_root(const types::Widget& arg);
+
+// Full path of 'name' in 'dir'
+std::string join_path(std::string_view dir, std::string_view name);
+
+// Directories first, then by name (ASCII case insensitive)
+[[nodiscard]] bool less_entry(const DirEntry& a, const DirEntry& b);
+
+// Extensions ("png") or globs with '*' and '?' ("IMG_*"), like parse_filter()
+// returns them; "*" and an empty list match everything
+[[nodiscard]] bool match_filter(const FilterList& filter,
+                                std::string_view name);
+
+// Lists 'dir', files must match 'filter'. Entries go to 'f' while they're
+// read, in batches of DIRLIST_BATCH sorted by less_entry() (but not with
+// each other: views merge them). The last one is 'done', maybe empty.
+void list_dir(const std::string& dir, const FilterList& filter, bool hidden,
+              const DirBatch& f);
+
+} // namespace tanto
@@ -0,0 +1,422 @@
+#include "downloader.h"
+#include "error.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <string_view>
+
+namespace tanto {
+
+namespace {
+
+using Headers = std::unordered_map<std::string, std::string>;
+
+constexpr size_t REPLAY_BUFFER = 64 * 1024; // For listeners arriving late
+
+// Bodies go either to the cache's file or to memory, never both
+template<typename Transfer>
+size_t curl_write(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    auto* t = reinterpret_cast<Transfer*>(userdata);
+    std::string_view chunk{ptr, size * nmemb};
+
+    if(!t->file)
+        t->body.append(chunk);
+    else if(std::fwrite(ptr, 1, chunk.size(), t->file) != chunk.size())
+        return 0; // Abort the transfer
+
+    for(const DownloadChunk& l : t->listeners)
+        l(chunk);
+
+    return chunk.size();
+}
+
+size_t curl_header(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* headers = reinterpret_cast<Headers*>(userdata);
+    std::string_view line{buffer, size * nitems};
+
+    if(line.substr(0, 5) == "HTTP/") // New response (redirects)
+        headers->clear();
+    else if(size_t idx = line.find(':'); idx != std::string_view::npos) {
+        std::string name{line.substr(0, idx)};
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+
+        std::string_view value = line.substr(idx + 1);
+        while(!value.empty() && std::isspace(value.front()))
+            value.remove_prefix(1);
+        while(!value.empty() && std::isspace(value.back()))
+            value.remove_suffix(1);
+
+        (*headers)[name] = std::string{value};
+    }
+
+    return size * nitems;
+}
+
+[[nodiscard]] std::string header_value(const Headers& headers,
+                                       const std::string& name) {
+    auto it = headers.find(name);
+    return it != headers.end() ? it->second : std::string{};
+}
+
+// Unix time until which a response is fresh, 0 to always revalidate.
+// "max-age" wins over "Expires", "s-maxage" is for shared caches only.
+[[nodiscard]] int64_t parse_expires(const Headers& headers) {
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+
+    std::string cc = header_value(headers, "cache-control");
+    std::transform(cc.begin(), cc.end(), cc.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+
+    for(std::string_view s = cc; !s.empty();) { // Comma separated directives
+        size_t idx = s.find(',');
+        std::string_view d = s.substr(0, idx);
+        s.remove_prefix(idx == std::string_view::npos ? s.size() : idx + 1);
+
+        while(!d.empty() && std::isspace(static_cast<unsigned char>(d[0])))
+            d.remove_prefix(1);
+
+        if(d.substr(0, 8) == "no-store" || d.substr(0, 8) == "no-cache")
+            return 0;
+
+        if(d.substr(0, 8) != "max-age=")
+            continue;
+
+        d.remove_prefix(8);
+        int64_t maxage = 0;
+        if(std::from_chars(d.data(), d.data() + d.size(), maxage).ec !=
+           std::errc{})
+            return 0;
+
+        return now + maxage;
+    }
+
+    std::string expires = header_value(headers, "expires");
+    if(expires.empty())
+        return 0;
+
+    time_t t = curl_getdate(expires.c_str(), nullptr);
+    if(t == -1) // Invalid dates ("0") mean already expired
+        return 0;
+
+    // Relative to the server's clock, if it sent one
+    std::string date = header_value(headers, "date");
+    time_t servernow = date.empty() ? -1 : curl_getdate(date.c_str(), nullptr);
+    if(servernow != -1)
+        return now + (static_cast<int64_t>(t) - servernow);
+
+    return static_cast<int64_t>(t);
+}
+
+void replay_file(std::FILE* file, const std::string& filepath,
+                 const DownloadChunk& l) {
+    std::fflush(file);
+
+    std::ifstream f{filepath, std::ios::binary};
+    std::string buf(REPLAY_BUFFER, '\0');
+
+    while(f.read(buf.data(), buf.size()) || f.gcount())
+        l(std::string_view{buf.data(), static_cast<size_t>(f.gcount())});
+}
+
+} // namespace
+
+Downloader::Downloader() {
+    // Constructed first, so it's destroyed after ~Downloader() joined
+    HttpCache::instance();
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    m_multi = curl_multi_init();
+    assume(m_multi);
+    curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                      DOWNLOAD_MAX_HOST_CONNECTIONS);
+    curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    m_thread = std::thread{[this]() { this->run(); }};
+}
+
+Downloader::~Downloader() {
+    {
+        std::lock_guard lock{m_mutex};
+        m_stopped = true;
+    }
+
+    curl_multi_wakeup(m_multi);
+    m_thread.join();
+
+    for(auto& [url, t] : m_transfers) {
+        if(t.handle) {
+            curl_multi_remove_handle(m_multi, t.handle);
+            curl_easy_cleanup(t.handle);
+        }
+
+        if(t.file)
+            std::fclose(t.file);
+        if(!t.filepath.empty()) // Still in flight, release its part
+            HttpCache::instance().discard(t.url, t.filepath);
+
+        curl_slist_free_all(t.request);
+    }
+
+    curl_multi_cleanup(m_multi);
+    curl_global_cleanup();
+}
+
+Downloader& Downloader::instance() {
+    static Downloader downloader;
+    return downloader;
+}
+
+void Downloader::fetch(const std::string& url, DownloadCallback cb,
+                       DownloadChunk chunk) {
+    HttpCache& cache = HttpCache::instance();
+    Download d;
+
+    {
+        std::lock_guard lock{m_mutex};
+
+        // Every fetch goes back to the cache: expired entries are
+        // revalidated and evicted ones downloaded again
+        if(auto e = cache.lookup(url); e && HttpCache::is_fresh(*e)) {
+            cache.touch(*e);
+            d.filepath = cache.body_path(url);
+        }
+        else {
+            auto [it2, inserted] = m_transfers.try_emplace(url);
+            if(cb)
+                it2->second.callbacks.push_back(std::move(cb));
+            if(chunk)
+                m_listeners.emplace_back(url, std::move(chunk));
+
+            if(inserted) {
+                it2->second.url = url;
+                it2->second.cached = std::move(e);
+                m_queued.push_back(url);
+            }
+
+            curl_multi_wakeup(m_multi);
+            return;
+        }
+    }
+
+    if(cb) // Fresh in the cache
+        cb(d);
+}
+
+bool Downloader::start(Transfer& t) {
+    HttpCache& cache = HttpCache::instance();
+
+    if(cache.enabled()) { // Otherwise the body stays in memory only
+        t.filepath = cache.create_part(t.url);
+        t.file = std::fopen(t.filepath.c_str(), "wb");
+
+        if(!t.file) {
+            spdlog::error("Cannot create a file for '{}'", t.url);
+            cache.discard(t.url, t.filepath);
+            return false;
+        }
+    }
+
+    if(t.cached) { // Revalidate
+        if(!t.cached->etag.empty())
+            t.request = curl_slist_append(
+                t.request, ("If-None-Match: " + t.cached->etag).c_str());
+        if(!t.cached->lastmodified.empty())
+            t.request = curl_slist_append(
+                t.request,
+                ("If-Modified-Since: " + t.cached->lastmodified).c_str());
+    }
+
+    t.handle = curl_easy_init();
+    assume(t.handle);
+
+    CURL* handle = t.handle;
+    curl_easy_setopt(handle, CURLOPT_URL, t.url.c_str());
+    curl_easy_setopt(handle, CURLOPT_PRIVATE, t.url.c_str());
+    curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, DOWNLOAD_CONNECT_TIMEOUT);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT, DOWNLOAD_TIMEOUT);
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, t.request);
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, curl_header);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, &t.headers);
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, curl_write<Transfer>);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &t);
+    curl_multi_add_handle(m_multi, handle);
+    return true;
+}
+
+bool Downloader::complete(Transfer& t, long status) {
+    HttpCache& cache = HttpCache::instance();
+
+    if(t.file) {
+        std::fclose(t.file);
+        t.file = nullptr;
+    }
+
+    if(status == 304) { // Not Modified
+        if(!t.filepath.empty())
+            cache.discard(t.url, t.filepath);
+        t.filepath.clear();
+
+        if(!t.cached) // Nothing to revalidate, the body is empty
+            return false;
+
+        t.cached->expires = parse_expires(t.headers);
+        cache.touch(*t.cached);
+        t.filepath = cache.body_path(t.url);
+    }
+    else if(cache.enabled()) {
+        HttpCache::Entry e;
+        e.url = t.url;
+        e.etag = header_value(t.headers, "etag");
+        e.lastmodified = header_value(t.headers, "last-modified");
+        e.expires = parse_expires(t.headers);
+
+        bool stored = cache.store(e, t.filepath);
+        t.filepath.clear();
+        if(!stored)
+            return false;
+
+        t.filepath = cache.body_path(t.url);
+    }
+
+    return true;
+}
+
+void Downloader::attach_listeners() {
+    std::vector<std::pair<std::string, DownloadChunk>> listeners;
+
+    {
+        std::lock_guard lock{m_mutex};
+        listeners.swap(m_listeners);
+    }
+
+    for(auto& [url, l] : listeners) {
+        auto it = m_transfers.find(url); // Only this thread erases them
+        if(it == m_transfers.end() || !it->second.handle)
+            continue; // Completed (or failed) meanwhile: callbacks cover it
+
+        Transfer& t = it->second;
+
+        if(t.file) // Replay what has arrived so far
+            replay_file(t.file, t.filepath, l);
+        else if(!t.body.empty())
+            l(t.body);
+
+        t.listeners.push_back(std::move(l));
+    }
+}
+
+void Downloader::finish(CURL* handle, CURLcode res) {
+    char* url = nullptr;
+    curl_easy_getinfo(handle, CURLINFO_PRIVATE, &url);
+    assume(url);
+
+    long status = 0;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+
+    Transfer* t = nullptr;
+
+    {
+        std::lock_guard lock{m_mutex};
+        auto it = m_transfers.find(url);
+        assume(it != m_transfers.end());
+        t = &it->second; // Nodes are stable, only this thread erases them
+    }
+
+    curl_multi_remove_handle(m_multi, handle);
+    curl_easy_cleanup(handle);
+    curl_slist_free_all(t->request);
+    t->handle = nullptr;
+    t->request = nullptr;
+
+    Download d;
+
+    if(res == CURLE_OK && status < 400 && this->complete(*t, status)) {
+        d.filepath = t->filepath;
+        if(d.filepath.empty())
+            d.data = std::make_shared<const std::string>(std::move(t->body));
+    }
+    else {
+        if(res != CURLE_OK)
+            spdlog::error("Download of '{}' failed: {}", t->url,
+                          curl_easy_strerror(res));
+        else
+            spdlog::error("Download of '{}' failed: HTTP {}", t->url, status);
+
+        if(t->file) {
+            std::fclose(t->file);
+            t->file = nullptr;
+        }
+
+        if(!t->filepath.empty()) // A part, unless complete() took it
+            HttpCache::instance().discard(t->url, t->filepath);
+
+        if(t->cached) // Better stale than nothing
+            d.filepath = HttpCache::instance().body_path(t->url);
+    }
+
+    std::vector<DownloadCallback> callbacks;
+    std::string key = t->url;
+
+    {
+        std::lock_guard lock{m_mutex};
+        callbacks = std::move(t->callbacks);
+        m_transfers.erase(key);
+    }
+
+    for(const DownloadCallback& cb : callbacks)
+        cb(d);
+}
+
+void Downloader::run() {
+    for(;;) {
+        std::vector<Transfer> failed;
+
+        {
+            std::lock_guard lock{m_mutex};
+            if(m_stopped)
+                break;
+
+            for(const std::string& url : m_queued) {
+                auto it = m_transfers.find(url);
+                if(this->start(it->second))
+                    continue;
+
+                failed.push_back(std::move(it->second));
+                m_transfers.erase(it);
+            }
+
+            m_queued.clear();
+        }
+
+        for(const Transfer& t : failed) {
+            for(const DownloadCallback& cb : t.callbacks)
+                cb(Download{});
+        }
+
+        this->attach_listeners();
+
+        int running = 0;
+        curl_multi_perform(m_multi, &running);
+
+        int nmsgs = 0;
+        while(CURLMsg* msg = curl_multi_info_read(m_multi, &nmsgs)) {
+            if(msg->msg == CURLMSG_DONE)
+                this->finish(msg->easy_handle, msg->data.result);
+        }
+
+        curl_multi_poll(m_multi, nullptr, 0, 1000, nullptr);
+    }
+}
+
+} // namespace tanto
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "httpcache.h"
+#include "tanto.h"
+#include <cstdio>
+#include <curl/curl.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace tanto {
+
+constexpr long DOWNLOAD_CONNECT_TIMEOUT = 10; // Seconds
+constexpr long DOWNLOAD_TIMEOUT = 120;        // Seconds
+constexpr long DOWNLOAD_MAX_HOST_CONNECTIONS = 6;
+
+// Runs every transfer on a single curl multi handle in a background thread:
+// requests run in parallel and connections are reused per host.
+// Responses are kept in HttpCache and revalidated with conditional requests.
+// Without a cache bodies stay in memory only until they're delivered, the
+// image caches bound them after that.
+class Downloader {
+private:
+    struct Transfer {
+        std::string url, filepath, body; // Body without a file
+        std::optional<HttpCache::Entry> cached;
+        std::unordered_map<std::string, std::string> headers; // Response
+        std::FILE* file{nullptr};
+        CURL* handle{nullptr};
+        curl_slist* request{nullptr};
+        std::vector<DownloadCallback> callbacks;
+        std::vector<DownloadChunk> listeners; // Downloader's thread only
+    };
+
+public:
+    Downloader();
+    ~Downloader();
+    void fetch(const std::string& url, DownloadCallback cb = {},
+               DownloadChunk chunk = {});
+    static Downloader& instance();
+
+private:
+    void run();
+    bool start(Transfer& t);
+    void finish(CURL* handle, CURLcode res);
+    bool complete(Transfer& t, long status);
+    void attach_listeners();
+
+private:
+    std::unordered_map<std::string, Transfer> m_transfers;
+    std::vector<std::pair<std::string, DownloadChunk>> m_listeners;
+    std::vector<std::string> m_queued;
+    std::mutex m_mutex;
+    std::thread m_thread;
+    CURLM* m_multi{nullptr};
+    bool m_stopped{false};
+};
+
+} // namespace tanto
@@ -2,6 +2,7 @@
 
 #include <cstdio>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <utility>
 
 #if defined(__GNUC__) // GCC, Clang, ICC
@@ -106,6 +107,17 @@ inline void print_backtrace() {}
 
 } // namespace impl
 
+namespace tanto {
+
+// Invalid requests, found before anything is built: unlike except() the
+// caller decides what to do (tanto exits, the C API returns -1)
+class ParseError: public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+} // namespace tanto
+
 #define print_backtrace impl::print_backtrace();
 
 #define assume(...)                                                            \
@@ -127,3 +139,5 @@ inline void print_backtrace() {}
         SPDLOG_CRITICAL(__VA_ARGS__);                                          \
         ::impl::abort();                                                       \
     } while(false)
+
+#define reject(...) throw ::tanto::ParseError{fmt::format(__VA_ARGS__)}
@@ -1,16 +1,72 @@
 #include "events.h"
 #include "error.h"
+#include "tanto.h"
+#include "trace.h"
 #include "utils.h"
 #include <cstdio>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <string_view>
 #include <variant>
 
-Events::ProcessedModel Events::process_model() {
-    assume(m_ismodel);
+namespace {
+
+// Replaces 'value', if large, with a reference to a temp file holding it (raw
+// text for strings, JSON otherwise)
+void spill_value(nlohmann::json& value, size_t threshold,
+                 std::string_view name) {
+    if(!value.is_string() && !value.is_structured())
+        return;
+
+    std::string dumped;
+    std::string_view data;
+
+    if(value.is_string())
+        data = value.get_ref<const std::string&>();
+    else {
+        dumped = value.dump();
+        data = dumped;
+    }
+
+    if(data.size() <= threshold)
+        return;
+
+    std::string filepath = tanto::save_temp(data);
+    if(filepath.empty()) {
+        spdlog::warn("Cannot spill '{}', sending it inline", name);
+        return;
+    }
+
+    value = {
+        {"$ref", filepath},
+        {"size", data.size()},
+        {"fnv1a", fmt::format("{:016x}", tanto::utils::fnv1a_64(data))},
+        {"format", dumped.empty() ? "text" : "json"},
+    };
+}
+
+// Members are spilled first so the detail keeps its keys, then the whole
+// detail if it's still too large (or not an object): the event stays small.
+void spill_values(nlohmann::json& detail, size_t threshold) {
+    if(detail.is_object()) {
+        for(auto item : detail.items())
+            spill_value(item.value(), threshold, item.key());
+    }
+
+    spill_value(detail, threshold, "detail");
+}
+
+} // namespace
+
+Events::ProcessedModel Events::process_model(const WindowModel& wm) {
+    assume(wm.ismodel);
 
     ProcessedModel pmodel;
 
-    for(const auto& [id, arg] : m_model) {
-        nlohmann::json data = this->get_model_data(arg.first, arg.second);
+    for(const auto& [id, arg] : wm.model) {
+        nlohmann::json data = arg.second.has_value() // Built?
+                                  ? this->get_model_data(arg.first, arg.second)
+                                  : tanto::default_value(arg.first);
         if(!data.is_null())
             pmodel[id] = data;
     }
@@ -18,18 +74,29 @@ Events::ProcessedModel Events::process_model() {
     return pmodel;
 }
 
+const Events::WindowModel*
+Events::window_model(const tanto::types::Widget& w) const {
+    auto it = m_windows.find(w.window);
+    return it != m_windows.end() ? &it->second : nullptr;
+}
+
+bool Events::is_model(const tanto::types::Widget& w) const {
+    const WindowModel* wm = this->window_model(w);
+    return wm && wm->ismodel;
+}
+
 void Events::selected(const tanto::types::Widget& w,
                       const nlohmann::json& row) {
-    if(m_ismodel)
+    if(this->is_model(w) || !this->can_submit(w))
         return;
 
     this->create_event("selected", w, row);
-    this->exit();
+    this->close(w.window);
 }
 
 void Events::selected(const tanto::types::Widget& w, int index,
                       tanto::types::MultiValue value) {
-    if(m_ismodel)
+    if(this->is_model(w))
         return;
 
     nlohmann::json detail = {{"index", index}};
@@ -44,7 +111,7 @@ void Events::selected(const tanto::types::Widget& w, int index,
 
 void Events::changed(const tanto::types::Widget& w,
                      const nlohmann::json& detail) {
-    if(m_ismodel)
+    if(this->is_model(w))
         return;
 
     this->create_event("changed", w, detail);
@@ -52,20 +119,29 @@ void Events::changed(const tanto::types::Widget& w,
 
 void Events::clicked(const tanto::types::Widget& w,
                      const nlohmann::json& detail) {
+    if(!this->can_submit(w))
+        return;
+
     this->create_event("clicked", w, detail);
-    this->exit();
+    this->close(w.window);
 }
 
 void Events::double_clicked(const tanto::types::Widget& w,
                             const nlohmann::json& detail) {
-    if(m_ismodel)
+    if(this->is_model(w) || !this->can_submit(w))
         return;
 
     this->create_event("doubleclicked", w, detail);
-    this->exit();
+    this->close(w.window);
 }
 
-void Events::send_event(const std::string& s) { std::puts(s.c_str()); }
+void Events::send_event(const std::string& s) {
+    tanto::trace::Span span{"event", "events"};
+    if(m_eventhandler)
+        m_eventhandler(s);
+    else
+        std::puts(s.c_str());
+}
 
 void Events::create_event(const std::string& type,
                           const tanto::types::Widget& w,
@@ -73,11 +149,18 @@ void Events::create_event(const std::string& type,
     assume(!w.id.empty());
 
     nlohmann::json event = {{"type", type}, {"from", w.id}};
+    const WindowModel* wm = this->window_model(w);
+
+    if(!w.window.empty())
+        event["window"] = w.window;
 
-    if(m_ismodel)
-        event["detail"] = this->process_model();
+    if(wm && wm->ismodel)
+        event["detail"] = this->process_model(*wm);
     else if(!detail.is_null())
         event["detail"] = detail;
 
-    std::puts(event.dump().c_str());
+    if(m_spillthreshold && event.contains("detail"))
+        spill_values(event["detail"], m_spillthreshold);
+
+    this->send_event(event.dump());
 }
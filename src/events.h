@@ -2,6 +2,7 @@
 
 #include "types.h"
 #include <any>
+#include <functional>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <unordered_map>
@@ -12,8 +13,22 @@ private:
     using Model = std::unordered_map<std::string,
                                      std::pair<tanto::types::Widget, std::any>>;
 
+protected:
+    struct WindowModel {
+        bool ismodel{false};
+        Model model;
+
+        // Widgets with an id, by id: {type, widget}
+        std::unordered_map<std::string, std::pair<std::string, std::any>>
+            widgets;
+    };
+
+public:
+    using EventHandler = std::function<void(const std::string&)>;
+
 public:
     virtual void exit() = 0;
+    virtual void close(const std::string& window) = 0;
     virtual nlohmann::json get_model_data(const tanto::types::Widget& arg,
                                           const std::any& w) = 0;
     void selected(const tanto::types::Widget& w, int index,
@@ -27,6 +42,23 @@ public:
     void double_clicked(const tanto::types::Widget& w,
                         const nlohmann::json& detail = {});
     void send_event(const std::string& s);
+    [[nodiscard]] bool is_model(const tanto::types::Widget& w) const;
+
+    // Checked before 'w' closes its window
+    [[nodiscard]] virtual bool can_submit(const tanto::types::Widget& w) {
+        (void)w;
+        return true;
+    }
+
+    // Events go to stdout unless a handler is set (embedded use)
+    inline void set_event_handler(EventHandler h) {
+        m_eventhandler = std::move(h);
+    }
+
+    // Detail values above 'bytes' are written to temp files (0 disables it)
+    inline void set_spill_threshold(size_t bytes) {
+        m_spillthreshold = bytes;
+    }
 
     inline void send_quit_event(const std::string& s) {
         this->send_event(s);
@@ -36,9 +68,15 @@ public:
 private:
     void create_event(const std::string& type, const tanto::types::Widget& w,
                       const nlohmann::json& detail);
-    ProcessedModel process_model();
+    ProcessedModel process_model(const WindowModel& wm);
+    [[nodiscard]] const WindowModel* window_model(
+        const tanto::types::Widget& w) const;
 
 protected:
-    bool m_ismodel{false};
-    Model m_model;
+    // Open windows by id (empty for a single dialog)
+    std::unordered_map<std::string, WindowModel> m_windows;
+
+private:
+    EventHandler m_eventhandler;
+    size_t m_spillthreshold{0};
 };
@@ -0,0 +1,299 @@
+#include "httpcache.h"
+#include "utils.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+[[nodiscard]] int64_t unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+[[nodiscard]] std::string cache_dir() {
+    if(const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        return (fs::path{xdg} / "tanto").string();
+    if(const char* home = std::getenv("HOME"); home && *home)
+        return (fs::path{home} / ".cache" / "tanto").string();
+    return std::string{};
+}
+
+[[nodiscard]] size_t cache_capacity() {
+    const char* env = std::getenv("TANTO_HTTP_CACHE"); // In MiB
+    if(!env)
+        return tanto::HTTP_CACHE_SIZE;
+
+    std::string_view s = env;
+    size_t mib = 0;
+    auto res = std::from_chars(s.data(), s.data() + s.size(), mib);
+    if(res.ec != std::errc{})
+        return tanto::HTTP_CACHE_SIZE;
+
+    return mib * 1024 * 1024;
+}
+
+// Name prefix of the files of 'url'
+[[nodiscard]] std::string url_key(const std::string& url) {
+    return fmt::format("{:016x}", tanto::utils::fnv1a_64(url));
+}
+
+} // namespace
+
+namespace tanto {
+
+HttpCache::HttpCache()
+    : m_capacity{cache_capacity()}, m_nonce{std::random_device{}()} {
+    if(!m_capacity)
+        return;
+
+    std::string dir = cache_dir();
+    if(dir.empty())
+        return;
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+
+    if(!ec)
+        m_dir = dir;
+    else
+        spdlog::warn("HTTP cache disabled: cannot use '{}'", dir);
+}
+
+HttpCache& HttpCache::instance() {
+    static HttpCache cache;
+    return cache;
+}
+
+bool HttpCache::is_fresh(const Entry& e) { return e.expires > unix_now(); }
+
+std::string HttpCache::path(const std::string& key,
+                            std::string_view suffix) const {
+    return (fs::path{m_dir} / fmt::format("{}{}", key, suffix)).string();
+}
+
+std::string HttpCache::temp_path(const std::string& key) {
+    return this->path(key,
+                      fmt::format(".{:08x}{:x}.part", m_nonce, ++m_ntemp));
+}
+
+std::string HttpCache::body_path(const std::string& url) const {
+    return this->path(url_key(url), {});
+}
+
+std::string HttpCache::variant_path(const std::string& filepath, int w,
+                                    int h) const {
+    if(!this->enabled() || (!w && !h))
+        return std::string{};
+
+    fs::path p{filepath};
+    if(p.parent_path() != fs::path{m_dir} || p.has_extension())
+        return std::string{}; // Not a cached body
+
+    return fmt::format("{}.{}x{}.png", filepath, w, h);
+}
+
+std::optional<HttpCache::Entry> HttpCache::lookup(const std::string& url) const {
+    if(!this->enabled())
+        return std::nullopt;
+
+    std::string key = url_key(url);
+    std::ifstream f{this->path(key, ".json")};
+    if(!f.is_open() || !fs::exists(this->path(key, {})))
+        return std::nullopt;
+
+    nlohmann::json j = nlohmann::json::parse(f, nullptr, false);
+    if(j.is_discarded())
+        return std::nullopt;
+
+    auto e = j.get<Entry>();
+    if(e.url != url) // Hash collision
+        return std::nullopt;
+
+    return e;
+}
+
+std::string HttpCache::create_part(const std::string& url) {
+    std::string key = url_key(url);
+
+    std::lock_guard lock{m_mutex};
+    this->load_index();
+    m_groups[key].writers++;
+    return this->temp_path(key);
+}
+
+void HttpCache::discard(const std::string& url, const std::string& part) {
+    std::error_code ec;
+    fs::remove(part, ec);
+
+    std::lock_guard lock{m_mutex};
+    if(auto it = m_groups.find(url_key(url)); it != m_groups.end())
+        it->second.writers--;
+}
+
+bool HttpCache::store(const Entry& e, const std::string& part) {
+    std::string key = url_key(e.url);
+
+    std::lock_guard lock{m_mutex};
+    this->load_index();
+    Group& g = m_groups[key];
+    g.writers--;
+
+    std::error_code ec;
+    for(const std::string& v : g.variants)
+        fs::remove(v, ec); // Stale
+    g.variants.clear();
+
+    fs::rename(part, this->path(key, {}), ec);
+
+    if(ec) {
+        spdlog::error("Cannot store '{}' in cache: {}", e.url, ec.message());
+        fs::remove(part, ec);
+        this->update_size(key, g);
+        return false;
+    }
+
+    this->write_entry(key, e);
+    g.lastuse = fs::file_time_type::clock::now();
+    this->update_size(key, g);
+    this->trim();
+    return true;
+}
+
+void HttpCache::touch(const Entry& e) {
+    std::string key = url_key(e.url);
+
+    std::lock_guard lock{m_mutex};
+    this->load_index();
+    Group& g = m_groups[key];
+    this->write_entry(key, e); // Refreshes mtime too
+    g.lastuse = fs::file_time_type::clock::now();
+    this->update_size(key, g);
+}
+
+void HttpCache::add_variant(const std::string& filepath) {
+    std::string name = fs::path{filepath}.filename().string();
+    std::string key = name.substr(0, name.find('.'));
+
+    std::lock_guard lock{m_mutex};
+    this->load_index();
+    Group& g = m_groups[key];
+    if(std::find(g.variants.begin(), g.variants.end(), filepath) ==
+       g.variants.end())
+        g.variants.push_back(filepath);
+
+    this->update_size(key, g);
+    this->trim();
+}
+
+// Readers never see a partial entry
+void HttpCache::write_entry(const std::string& key, const Entry& e) {
+    std::string temp = this->temp_path(key);
+    std::ofstream f{temp, std::ios::trunc};
+    f << nlohmann::json(e).dump();
+    f.close();
+
+    std::error_code ec;
+    if(f)
+        fs::rename(temp, this->path(key, ".json"), ec);
+
+    if(!f || ec) {
+        spdlog::error("Cannot store '{}' in cache", e.url);
+        fs::remove(temp, ec);
+    }
+}
+
+void HttpCache::update_size(const std::string& key, Group& g) {
+    uintmax_t size = 0;
+    std::error_code ec;
+
+    for(std::string_view suffix : {"", ".json"}) {
+        uintmax_t n = fs::file_size(this->path(key, suffix), ec);
+        if(!ec)
+            size += n;
+    }
+
+    for(const std::string& v : g.variants) {
+        uintmax_t n = fs::file_size(v, ec);
+        if(!ec)
+            size += n;
+    }
+
+    m_total = m_total - g.size + size;
+    g.size = size;
+}
+
+// Other processes' parts aren't counted, they're removed once stale
+void HttpCache::load_index() {
+    if(m_indexed)
+        return;
+
+    m_indexed = true;
+    auto stale = fs::file_time_type::clock::now() -
+                 std::chrono::seconds{HTTP_CACHE_PART_AGE};
+    std::error_code ec;
+
+    for(const auto& de : fs::directory_iterator{m_dir, ec}) {
+        std::string name = de.path().filename().string();
+        std::string ext = de.path().extension().string();
+        std::error_code ec2;
+
+        if(ext == ".part") {
+            if(de.last_write_time(ec2) < stale && !ec2)
+                fs::remove(de.path(), ec2);
+            continue;
+        }
+
+        Group& g = m_groups[name.substr(0, name.find('.'))];
+        uintmax_t size = de.file_size(ec2);
+
+        if(!ec2) {
+            g.size += size;
+            m_total += size;
+        }
+
+        if(ext == ".json")
+            g.lastuse = de.last_write_time(ec2);
+        else if(ext == ".png")
+            g.variants.push_back(de.path().string());
+    }
+}
+
+void HttpCache::trim() {
+    if(m_total <= m_capacity)
+        return;
+
+    std::vector<std::pair<fs::file_time_type, std::string>> lru;
+    for(const auto& [key, g] : m_groups) {
+        if(!g.writers)
+            lru.emplace_back(g.lastuse, key);
+    }
+
+    std::sort(lru.begin(), lru.end());
+    std::error_code ec;
+
+    for(const auto& [_, key] : lru) {
+        if(m_total <= m_capacity)
+            break;
+
+        auto it = m_groups.find(key);
+        fs::remove(this->path(key, ".json"), ec); // Lookups miss first
+        fs::remove(this->path(key, {}), ec);
+        for(const std::string& v : it->second.variants)
+            fs::remove(v, ec);
+
+        m_total -= it->second.size;
+        m_groups.erase(it);
+    }
+}
+
+} // namespace tanto
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tanto {
+
+constexpr size_t HTTP_CACHE_SIZE = 256 * 1024 * 1024;
+constexpr int HTTP_CACHE_PART_AGE = 3600; // Seconds, then a ".part" is stale
+
+// On-disk cache of downloaded files in $XDG_CACHE_HOME/tanto: each URL has a
+// body, a metadata file (whose mtime drives LRU eviction) and optional
+// pre-scaled image variants sharing the same name prefix.
+// Files are written to unique ".part" files and renamed, the directory is
+// scanned once (removing stale parts) and sizes are kept up to date after.
+class HttpCache {
+public:
+    struct Entry {
+        std::string url, etag, lastmodified;
+        int64_t expires{0}; // Unix time, 0 means "always revalidate"
+
+        NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Entry, url, etag,
+                                                    lastmodified, expires)
+    };
+
+public:
+    HttpCache();
+    [[nodiscard]] inline bool enabled() const { return !m_dir.empty(); }
+    [[nodiscard]] std::optional<Entry> lookup(const std::string& url) const;
+    [[nodiscard]] std::string body_path(const std::string& url) const;
+    [[nodiscard]] std::string variant_path(const std::string& filepath, int w,
+                                           int h) const;
+
+    // A new file for the body of 'url', its group isn't evicted until it's
+    // stored or discarded
+    [[nodiscard]] std::string create_part(const std::string& url);
+    bool store(const Entry& e, const std::string& part);
+    void discard(const std::string& url, const std::string& part);
+    void touch(const Entry& e);
+    void add_variant(const std::string& filepath); // Once it's written
+    static bool is_fresh(const Entry& e);
+    static HttpCache& instance();
+
+private:
+    struct Group { // Files of a URL
+        uintmax_t size{0};
+        std::filesystem::file_time_type lastuse{
+            std::filesystem::file_time_type::min()};
+        std::vector<std::string> variants;
+        int writers{0}; // Parts being written
+    };
+
+private:
+    // Paths by name prefix, the others need m_mutex
+    [[nodiscard]] std::string path(const std::string& key,
+                                   std::string_view suffix) const;
+    [[nodiscard]] std::string temp_path(const std::string& key);
+    void write_entry(const std::string& key, const Entry& e);
+    void update_size(const std::string& key, Group& g);
+    void load_index();
+    void trim();
+
+private:
+    std::string m_dir;
+    size_t m_capacity{HTTP_CACHE_SIZE};
+    uint32_t m_nonce{0}; // Tells this process' temporary files apart
+    size_t m_ntemp{0};
+    std::unordered_map<std::string, Group> m_groups; // By name prefix
+    uintmax_t m_total{0};
+    bool m_indexed{false};
+    std::mutex m_mutex;
+};
+
+} // namespace tanto
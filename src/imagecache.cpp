@@ -0,0 +1,54 @@
+#include "imagecache.h"
+#include "utils.h"
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <string_view>
+
+namespace tanto {
+
+namespace fs = std::filesystem;
+
+std::string image_key(const std::string& filepath) {
+    std::error_code ec;
+    fs::path p = fs::canonical(filepath, ec);
+    if(ec)
+        return std::string{};
+
+    auto size = fs::file_size(p, ec);
+    if(ec)
+        return std::string{};
+
+    auto mtime = fs::last_write_time(p, ec);
+    if(ec)
+        return std::string{};
+
+    return p.string() + "|" +
+           std::to_string(mtime.time_since_epoch().count()) + "|" +
+           std::to_string(size);
+}
+
+std::string image_key(const std::string& source, std::string_view data) {
+    // Data URIs carry the whole image, the hash identifies them already
+    std::string_view prefix =
+        utils::starts_with(source, "data:") ? "data:" : source;
+
+    return std::string{prefix} + "#" + std::to_string(utils::fnv1a_64(data)) + "|" +
+           std::to_string(data.size());
+}
+
+size_t image_cache_budget() {
+    const char* env = std::getenv("TANTO_IMAGE_CACHE"); // In MiB
+    if(!env)
+        return IMAGE_CACHE_BUDGET;
+
+    std::string_view s = env;
+    size_t mib = 0;
+    auto res = std::from_chars(s.data(), s.data() + s.size(), mib);
+    if(res.ec != std::errc{})
+        return IMAGE_CACHE_BUDGET;
+
+    return mib * 1024 * 1024;
+}
+
+} // namespace tanto
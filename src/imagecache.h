@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace tanto {
+
+constexpr size_t IMAGE_CACHE_BUDGET = 64 * 1024 * 1024;
+
+std::string image_key(const std::string& filepath);
+std::string image_key(const std::string& source, std::string_view data);
+size_t image_cache_budget();
+
+// Decoded images shared between widgets: entries still referenced by a widget
+// are never evicted, the others are dropped in LRU order when over budget.
+// It's safe to use from worker threads.
+template<typename T>
+class ImageCache {
+public:
+    using Ptr = std::shared_ptr<T>;
+
+private:
+    struct Entry {
+        Ptr image;
+        size_t cost;
+        std::list<std::string>::iterator lru;
+    };
+
+public:
+    explicit ImageCache(size_t budget): m_budget{budget} {}
+
+    [[nodiscard]] inline size_t usage() {
+        std::lock_guard lock{m_mutex};
+        return m_usage;
+    }
+
+    static ImageCache& instance() {
+        static ImageCache cache{tanto::image_cache_budget()};
+        return cache;
+    }
+
+    inline void set_budget(size_t budget) {
+        std::lock_guard lock{m_mutex};
+        m_budget = budget;
+        this->evict();
+    }
+
+    inline void trim() {
+        std::lock_guard lock{m_mutex};
+        this->evict();
+    }
+
+    Ptr get(const std::string& key) {
+        std::lock_guard lock{m_mutex};
+        return this->lookup(key);
+    }
+
+    Ptr insert(const std::string& key, Ptr image, size_t cost) {
+        if(key.empty() || !image)
+            return image;
+
+        std::lock_guard lock{m_mutex};
+        this->store(key, image, cost);
+        return image;
+    }
+
+    // Decodes 'key' with 'f' (returning {image, cost}) unless it's already
+    // cached; concurrent requests for the same key wait for a single decode.
+    template<typename Function>
+    Ptr load(const std::string& key, Function f) {
+        if(key.empty())
+            return f().first;
+
+        std::promise<Ptr> promise;
+
+        {
+            std::unique_lock lock{m_mutex};
+            if(Ptr image = this->lookup(key); image)
+                return image;
+
+            if(auto it = m_pending.find(key); it != m_pending.end()) {
+                std::shared_future<Ptr> pending = it->second;
+                lock.unlock();
+                return pending.get();
+            }
+
+            m_pending[key] = promise.get_future().share();
+        }
+
+        decltype(f()) res;
+
+        try {
+            res = f();
+        }
+        catch(...) { // Waiters get the error too, the next load retries
+            {
+                std::lock_guard lock{m_mutex};
+                m_pending.erase(key);
+            }
+
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+
+        auto& [image, cost] = res;
+
+        {
+            std::lock_guard lock{m_mutex};
+            if(image)
+                this->store(key, image, cost);
+            m_pending.erase(key);
+        }
+
+        promise.set_value(image);
+        return image;
+    }
+
+private:
+    Ptr lookup(const std::string& key) {
+        auto it = m_entries.find(key);
+        if(it == m_entries.end())
+            return nullptr;
+
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+        return it->second.image;
+    }
+
+    void store(const std::string& key, const Ptr& image, size_t cost) {
+        if(auto it = m_entries.find(key); it != m_entries.end()) {
+            m_usage -= it->second.cost;
+            m_lru.erase(it->second.lru);
+            m_entries.erase(it);
+        }
+
+        m_lru.push_front(key);
+        m_entries[key] = Entry{image, cost, m_lru.begin()};
+        m_usage += cost;
+        this->evict();
+    }
+
+    void evict() {
+        for(auto it = m_lru.end(); it != m_lru.begin() && m_usage > m_budget;) {
+            --it;
+            Entry& e = m_entries.at(*it);
+            if(e.image.use_count() > 1) // Still displayed somewhere
+                continue;
+
+            m_usage -= e.cost;
+            m_entries.erase(*it);
+            it = m_lru.erase(it);
+        }
+    }
+
+private:
+    std::unordered_map<std::string, Entry> m_entries;
+    std::unordered_map<std::string, std::shared_future<Ptr>> m_pending;
+    std::list<std::string> m_lru;
+    std::mutex m_mutex;
+    size_t m_budget, m_usage{0};
+};
+
+} // namespace tanto
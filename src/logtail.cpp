@@ -0,0 +1,217 @@
+#include "logtail.h"
+#include "utils.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <spdlog/spdlog.h>
+#include <string_view>
+
+#if defined(__unix__)
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+    #include <sys/inotify.h>
+#endif
+
+namespace tanto {
+
+namespace {
+
+constexpr size_t LOG_READ_CHUNK = 64 * 1024;
+constexpr int LOG_POLL_INTERVAL = 100; // ms, bounds the shutdown latency
+
+// Length of 's' without a trailing incomplete UTF-8 sequence
+[[nodiscard]] size_t utf8_complete(std::string_view s) {
+    for(size_t i = 1; i <= std::min<size_t>(s.size(), 4); i++) {
+        auto c = static_cast<unsigned char>(s[s.size() - i]);
+        if((c & 0xC0) == 0x80) // Continuation byte, keep looking
+            continue;
+
+        size_t len = 1;
+        if((c & 0xE0) == 0xC0)
+            len = 2;
+        else if((c & 0xF0) == 0xE0)
+            len = 3;
+        else if((c & 0xF8) == 0xF0)
+            len = 4;
+
+        return len > i ? s.size() - i : s.size();
+    }
+
+    return s.size(); // Not UTF-8 anyway
+}
+
+#if defined(__unix__)
+// Where the last 'maxlines' lines start, a trailing newline doesn't count
+off_t tail_offset(int fd, off_t size, size_t maxlines) {
+    std::array<char, LOG_READ_CHUNK> buf;
+    size_t lines = 0;
+
+    for(off_t end = size; end > 0 && maxlines;) {
+        off_t start = std::max<off_t>(0, end - static_cast<off_t>(buf.size()));
+        ssize_t n = ::pread(fd, buf.data(), end - start, start);
+        if(n <= 0)
+            break;
+
+        for(ssize_t i = n; i-- > 0;) {
+            if(buf[i] != '\n' || start + i + 1 == size)
+                continue;
+            if(++lines == maxlines)
+                return start + i + 1;
+        }
+
+        end = start;
+    }
+
+    return 0;
+}
+
+[[nodiscard]] int open_source(const std::string& source) {
+    if(utils::starts_with(source, "fd:")) {
+        std::string_view s{source};
+        int fd = -1;
+        auto res = std::from_chars(s.data() + 3, s.data() + s.size(), fd);
+        if(res.ec != std::errc{} || fd < 0)
+            return -1;
+        return ::fcntl(fd, F_DUPFD_CLOEXEC, 0); // Ours to close
+    }
+
+    // Non blocking: a FIFO without writers would block open()
+    return ::open(source.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+}
+#endif
+
+} // namespace
+
+LogTail::LogTail(std::string source, size_t maxlines, Append append)
+    : m_source{std::move(source)}, m_maxlines{maxlines},
+      m_append{std::move(append)} {
+    m_thread = std::thread{[this]() { this->run(); }};
+}
+
+LogTail::~LogTail() {
+    m_stop = true;
+    if(m_thread.joinable())
+        m_thread.join();
+}
+
+void LogTail::run() {
+#if defined(__unix__)
+    int fd = open_source(m_source);
+    if(fd == -1) {
+        spdlog::warn("Log: cannot open '{}'", m_source);
+        return;
+    }
+
+    struct stat st{};
+    if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        this->follow_file(fd);
+    else
+        this->follow_pipe(fd);
+
+    ::close(fd);
+#else // No change notifications, show what's there
+    std::ifstream f{m_source, std::ios::binary};
+    if(!f) {
+        spdlog::warn("Log: cannot open '{}'", m_source);
+        return;
+    }
+
+    m_append(std::string{std::istreambuf_iterator<char>{f}, {}});
+#endif
+}
+
+#if defined(__unix__)
+void LogTail::follow_file(int fd) {
+    struct stat st{};
+    if(::fstat(fd, &st) == 0)
+        ::lseek(fd, tail_offset(fd, st.st_size, m_maxlines), SEEK_SET);
+
+    while(this->read_available(fd))
+        ;
+
+    int in = -1;
+#if defined(__linux__)
+    in = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(in != -1 && ::inotify_add_watch(in, m_source.c_str(), IN_MODIFY) == -1) {
+        ::close(in);
+        in = -1;
+    }
+#endif
+
+    while(!m_stop) {
+        if(in != -1) {
+            pollfd p{in, POLLIN, 0};
+            if(::poll(&p, 1, LOG_POLL_INTERVAL) <= 0)
+                continue;
+
+            std::array<char, 4096> events; // Only a wake up
+            while(::read(in, events.data(), events.size()) > 0)
+                ;
+        }
+        else { // Poll the size instead
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds{LOG_POLL_INTERVAL});
+        }
+
+        // Truncated in place (copytruncate rotation): start over
+        if(::fstat(fd, &st) == 0 && st.st_size < ::lseek(fd, 0, SEEK_CUR))
+            ::lseek(fd, 0, SEEK_SET);
+
+        while(this->read_available(fd))
+            ;
+    }
+
+    if(in != -1)
+        ::close(in);
+}
+
+void LogTail::follow_pipe(int fd) {
+    while(!m_stop) {
+        pollfd p{fd, POLLIN, 0};
+        int r = ::poll(&p, 1, LOG_POLL_INTERVAL);
+
+        if(r < 0 && errno != EINTR)
+            break;
+        if(r <= 0)
+            continue;
+
+        if(!this->read_available(fd) && errno != EAGAIN && errno != EINTR)
+            break; // EOF: every writer is gone
+    }
+}
+
+bool LogTail::read_available(int fd) {
+    std::string chunk = std::move(m_carry);
+    size_t offset = chunk.size();
+    chunk.resize(offset + LOG_READ_CHUNK);
+
+    errno = 0;
+    ssize_t n = ::read(fd, chunk.data() + offset, LOG_READ_CHUNK);
+    if(n <= 0) {
+        chunk.resize(offset);
+        m_carry = std::move(chunk);
+        return false;
+    }
+
+    // Characters split between reads are sent with the next chunk
+    chunk.resize(offset + n);
+    size_t len = utf8_complete(chunk);
+    m_carry = chunk.substr(len);
+    chunk.resize(len);
+
+    if(!chunk.empty())
+        m_append(std::move(chunk));
+    return true;
+}
+#endif
+
+} // namespace tanto
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace tanto {
+
+// Follows a log from its own thread: regular files start from their last
+// 'maxlines' lines and are watched for appends (inotify where available),
+// pipes ("fd:N" or a FIFO) are read until EOF.
+// Text goes to 'append' in chunks, as soon as it's read.
+class LogTail {
+public:
+    using Append = std::function<void(std::string)>;
+
+public:
+    LogTail(std::string source, size_t maxlines, Append append);
+    ~LogTail(); // Stops following, waits at most one poll interval
+    LogTail(const LogTail&) = delete;
+    LogTail& operator=(const LogTail&) = delete;
+
+private:
+    void run();
+    void follow_file(int fd);
+    void follow_pipe(int fd);
+    [[nodiscard]] bool read_available(int fd);
+
+private:
+    std::string m_source;
+    size_t m_maxlines;
+    Append m_append;
+    std::string m_carry; // Incomplete UTF-8 sequence from the last read
+    std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+};
+
+} // namespace tanto
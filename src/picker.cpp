@@ -0,0 +1,534 @@
+#include "picker.h"
+#include "progress.h"
+#include "trace.h"
+#include "workerpool.h"
+#include <algorithm>
+#include <array>
+#include <fmt/core.h>
+#include <tuple>
+
+namespace tanto {
+
+namespace {
+
+constexpr size_t PICK_READ_CHUNK = 256 * 1024;
+constexpr size_t PICK_TASK_LINES = 32 * 1024; // Per worker pool task
+
+constexpr int SCORE_MATCH = 16;
+constexpr int SCORE_GAP_START = -3;
+constexpr int SCORE_GAP_EXTENSION = -1;
+constexpr int BONUS_BOUNDARY = 8;
+constexpr int BONUS_CAMEL = 7;
+constexpr int BONUS_CONSECUTIVE = 4;
+constexpr int BONUS_FIRST_MULTIPLIER = 2;
+
+// Letters (folded), digits, the other ASCII characters in 27 buckets and
+// everything else in the last bit
+constexpr std::array<uint64_t, 256> CHAR_BITS = []() {
+    std::array<uint64_t, 256> bits{};
+
+    for(size_t c = 0; c < bits.size(); c++) {
+        if(c >= 'a' && c <= 'z')
+            bits[c] = uint64_t{1} << (c - 'a');
+        else if(c >= 'A' && c <= 'Z')
+            bits[c] = uint64_t{1} << (c - 'A');
+        else if(c >= '0' && c <= '9')
+            bits[c] = uint64_t{1} << (26 + c - '0');
+        else if(c >= 128)
+            bits[c] = uint64_t{1} << 63;
+        else
+            bits[c] = uint64_t{1} << (36 + c % 27);
+    }
+
+    return bits;
+}();
+
+[[nodiscard]] inline bool is_lower(char c) { return c >= 'a' && c <= 'z'; }
+[[nodiscard]] inline bool is_upper(char c) { return c >= 'A' && c <= 'Z'; }
+[[nodiscard]] inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+[[nodiscard]] inline bool is_alnum(char c) {
+    return is_lower(c) || is_upper(c) || is_digit(c);
+}
+
+[[nodiscard]] inline char fold(char c) {
+    return is_upper(c) ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+[[nodiscard]] int bonus_at(std::string_view text, size_t i) {
+    if(!i)
+        return BONUS_BOUNDARY;
+
+    char prev = text[i - 1], c = text[i];
+    if(!is_alnum(prev) && is_alnum(c))
+        return BONUS_BOUNDARY;
+    if((is_lower(prev) && is_upper(c)) || (!is_digit(prev) && is_digit(c)))
+        return BONUS_CAMEL;
+    return 0;
+}
+
+// Runs f(0) ... f(n - 1) on the worker pool and waits for them
+template<typename Function>
+void parallel_for(size_t n, Function f) {
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t pending = n;
+
+    auto done = [&]() {
+        std::lock_guard lock{mutex};
+        if(!--pending)
+            cond.notify_one();
+    };
+
+    for(size_t i = 0; i < n; i++) {
+        if(!WorkerPool::instance().push([&, i]() {
+               f(i);
+               done();
+           })) { // Stopped: nobody else will run it
+            f(i);
+            done();
+        }
+    }
+
+    std::unique_lock lock{mutex};
+    cond.wait(lock, [&]() { return !pending; });
+}
+
+} // namespace
+
+uint64_t char_mask(std::string_view s) {
+    uint64_t mask = 0;
+    for(unsigned char c : s)
+        mask |= CHAR_BITS[c];
+    return mask;
+}
+
+std::optional<int> fuzzy_score(std::string_view text, std::string_view query) {
+    if(query.empty())
+        return 0;
+
+    bool sensitive = std::any_of(query.begin(), query.end(), is_upper);
+    auto eq = [sensitive](char c, char q) {
+        return (sensitive ? c : fold(c)) == q;
+    };
+
+    // The first occurrence, then the shortest one ending there
+    size_t end = 0;
+    for(size_t qi = 0; qi < query.size(); end++) {
+        if(end == text.size())
+            return std::nullopt;
+        if(eq(text[end], query[qi]))
+            qi++;
+    }
+
+    size_t start = end;
+    for(size_t qi = query.size(); qi;) {
+        if(eq(text[--start], query[qi - 1]))
+            qi--;
+    }
+
+    int score = 0, consecutive = 0;
+    bool ingap = false;
+
+    for(size_t i = start, qi = 0; i < end; i++) {
+        if(!eq(text[i], query[qi])) {
+            score += ingap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            ingap = true;
+            consecutive = 0;
+            continue;
+        }
+
+        int bonus = bonus_at(text, i);
+        if(consecutive)
+            bonus = std::max(bonus, BONUS_CONSECUTIVE);
+
+        score += SCORE_MATCH + (qi ? bonus : bonus * BONUS_FIRST_MULTIPLIER);
+        ingap = false;
+        consecutive++;
+        qi++;
+    }
+
+    return score;
+}
+
+std::string_view Picker::Chunk::line(size_t i) const {
+    uint32_t start = i ? ends[i - 1] : 0;
+    return std::string_view{text}.substr(start, ends[i] - start);
+}
+
+Picker::Picker(std::shared_ptr<UpdateQueue> updates)
+    : m_updates{std::move(updates)}, m_thread{[this]() { this->run(); }} {}
+
+Picker::~Picker() {
+    {
+        std::lock_guard lock{m_mutex};
+        m_stopped = true;
+        ++m_generation; // Abort the current ranking
+    }
+
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+void Picker::feed(std::string_view data) {
+    Chunk chunk;
+    chunk.text.reserve(data.size());
+
+    auto add = [&chunk](std::string_view line) {
+        if(!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        if(line.empty())
+            return;
+
+        line = line.substr(0, PICK_LINE_MAX);
+
+        chunk.text.append(line);
+        chunk.ends.push_back(static_cast<uint32_t>(chunk.text.size()));
+        chunk.masks.push_back(char_mask(line));
+    };
+
+    size_t start = 0;
+
+    for(size_t nl = data.find('\n'); nl != std::string_view::npos;
+        nl = data.find('\n', start)) {
+        if(m_partial.empty())
+            add(data.substr(start, nl - start));
+        else {
+            this->keep_partial(data.substr(start, nl - start));
+            add(m_partial);
+            m_partial.clear();
+        }
+
+        start = nl + 1;
+    }
+
+    this->keep_partial(data.substr(start));
+
+    if(!chunk.ends.empty())
+        this->add_chunk(std::move(chunk));
+}
+
+// What doesn't fit in PICK_LINE_MAX would be truncated by add() anyway
+void Picker::keep_partial(std::string_view data) {
+    if(m_partial.size() < PICK_LINE_MAX)
+        m_partial.append(data.substr(0, PICK_LINE_MAX - m_partial.size()));
+}
+
+void Picker::finish() {
+    if(!m_partial.empty())
+        this->feed("\n");
+
+    {
+        std::lock_guard lock{m_mutex};
+        m_eof = true;
+    }
+
+    m_cond.notify_one();
+}
+
+void Picker::set_query(std::string query) {
+    {
+        std::lock_guard lock{m_mutex};
+        if(query == m_query)
+            return;
+
+        m_query = std::move(query);
+        ++m_generation;
+    }
+
+    m_cond.notify_one();
+}
+
+std::optional<std::string> Picker::best() {
+    std::lock_guard lock{m_mutex};
+    return m_best;
+}
+
+void Picker::add_chunk(Chunk&& chunk) {
+    auto c = std::make_shared<const Chunk>(std::move(chunk));
+
+    {
+        std::lock_guard lock{m_mutex};
+        m_total += c->ends.size();
+        m_chunks.push_back(std::move(c));
+    }
+
+    m_cond.notify_one();
+}
+
+void Picker::run() {
+    for(;;) {
+        ChunkList chunks;
+        std::string query;
+        size_t total = 0, generation = 0;
+        bool eof = false;
+
+        {
+            std::unique_lock lock{m_mutex};
+            m_cond.wait(lock, [this]() {
+                return m_stopped || m_query != m_matched ||
+                       m_chunks.size() > m_scanned || m_eof != m_done;
+            });
+
+            if(m_stopped)
+                return;
+
+            chunks = m_chunks;
+            query = m_query;
+            total = m_total;
+            eof = m_eof;
+            generation = m_generation;
+        }
+
+        this->rank(chunks, query, total, eof, generation);
+    }
+}
+
+// Returns early, keeping the previous results, if the query changes meanwhile
+void Picker::rank(const ChunkList& chunks, const std::string& query,
+                  size_t total, bool eof, size_t generation) {
+    trace::Span span{"rank", "pick"};
+
+    if(query.empty()) { // Input order, nothing to score
+        m_matches.clear();
+        m_top.clear();
+
+        for(size_t c = 0; c < chunks.size(); c++) {
+            for(size_t l = 0; l < chunks[c]->ends.size(); l++) {
+                if(m_top.size() == PICK_RESULTS)
+                    break;
+                m_top.push_back(Match{0, static_cast<uint32_t>(c),
+                                      static_cast<uint32_t>(l)});
+            }
+        }
+
+        m_matched.clear();
+        m_scanned = chunks.size();
+        this->report(chunks, total, total, eof);
+        return;
+    }
+
+    std::vector<Match> matches;
+
+    if(query != m_matched) {
+        // Lines matching "ab" are a superset of the ones matching "abc"
+        bool narrowing = !m_matched.empty() &&
+                         !query.compare(0, m_matched.size(), m_matched);
+
+        if(narrowing ? !this->rescan(chunks, query, matches, generation)
+                     : !this->scan(chunks, 0, query, matches, generation))
+            return;
+
+        if(!narrowing)
+            m_scanned = chunks.size();
+
+        m_matches = std::move(matches);
+        m_matched = query;
+        this->sort_top(chunks, m_matches);
+        m_top.assign(m_matches.begin(),
+                     m_matches.begin() +
+                         std::min(m_matches.size(), PICK_RESULTS));
+    }
+
+    if(chunks.size() > m_scanned) { // Only the new lines can change the top
+        if(!this->scan(chunks, m_scanned, query, matches, generation))
+            return;
+
+        m_scanned = chunks.size();
+        m_matches.insert(m_matches.end(), matches.begin(), matches.end());
+        m_top.insert(m_top.end(), matches.begin(), matches.end());
+        this->sort_top(chunks, m_top);
+        m_top.resize(std::min(m_top.size(), PICK_RESULTS));
+    }
+
+    this->report(chunks, m_matches.size(), total, eof);
+}
+
+bool Picker::scan(const ChunkList& chunks, size_t first,
+                  const std::string& query, std::vector<Match>& res,
+                  size_t generation) const {
+    uint64_t qmask = char_mask(query);
+    std::vector<std::pair<size_t, size_t>> tasks; // Chunk ranges
+
+    for(size_t c = first, lines = 0; c < chunks.size(); c++) {
+        if(!lines)
+            tasks.emplace_back(c, c);
+
+        tasks.back().second = c + 1;
+        lines += chunks[c]->ends.size();
+        if(lines >= PICK_TASK_LINES)
+            lines = 0;
+    }
+
+    std::vector<std::vector<Match>> parts(tasks.size());
+
+    parallel_for(tasks.size(), [&](size_t i) {
+        std::vector<uint32_t> candidates;
+
+        for(size_t c = tasks[i].first; c < tasks[i].second; c++) {
+            if(m_generation != generation) // Stale
+                return;
+
+            const Chunk& chunk = *chunks[c];
+            size_t n = 0;
+            candidates.resize(chunk.masks.size());
+
+            // Branchless, most lines are rejected here
+            for(size_t l = 0; l < chunk.masks.size(); l++) {
+                candidates[n] = static_cast<uint32_t>(l);
+                n += (chunk.masks[l] & qmask) == qmask;
+            }
+
+            for(size_t k = 0; k < n; k++) {
+                if(auto score = fuzzy_score(chunk.line(candidates[k]), query);
+                   score) {
+                    parts[i].push_back(Match{*score, static_cast<uint32_t>(c),
+                                             candidates[k]});
+                }
+            }
+        }
+    });
+
+    if(m_generation != generation)
+        return false;
+
+    res.clear();
+    for(const std::vector<Match>& part : parts)
+        res.insert(res.end(), part.begin(), part.end());
+    return true;
+}
+
+bool Picker::rescan(const ChunkList& chunks, const std::string& query,
+                    std::vector<Match>& res, size_t generation) const {
+    uint64_t qmask = char_mask(query);
+    size_t ntasks = (m_matches.size() + PICK_TASK_LINES - 1) / PICK_TASK_LINES;
+    std::vector<std::vector<Match>> parts(ntasks);
+
+    parallel_for(ntasks, [&](size_t i) {
+        size_t end = std::min(m_matches.size(), (i + 1) * PICK_TASK_LINES);
+
+        for(size_t k = i * PICK_TASK_LINES; k < end; k++) {
+            if(!(k % 4096) && m_generation != generation) // Stale
+                return;
+
+            const Match& m = m_matches[k];
+            const Chunk& chunk = *chunks[m.chunk];
+            if((chunk.masks[m.line] & qmask) != qmask)
+                continue;
+
+            if(auto score = fuzzy_score(chunk.line(m.line), query); score)
+                parts[i].push_back(Match{*score, m.chunk, m.line});
+        }
+    });
+
+    if(m_generation != generation)
+        return false;
+
+    res.clear();
+    for(const std::vector<Match>& part : parts)
+        res.insert(res.end(), part.begin(), part.end());
+    return true;
+}
+
+// Best score first, then the shortest line, then input order
+void Picker::sort_top(const ChunkList& chunks,
+                      std::vector<Match>& matches) const {
+    auto better = [&chunks](const Match& a, const Match& b) {
+        if(a.score != b.score)
+            return a.score > b.score;
+
+        size_t la = chunks[a.chunk]->line(a.line).size();
+        size_t lb = chunks[b.chunk]->line(b.line).size();
+        if(la != lb)
+            return la < lb;
+
+        return std::tie(a.chunk, a.line) < std::tie(b.chunk, b.line);
+    };
+
+    size_t n = std::min(matches.size(), PICK_RESULTS);
+    std::partial_sort(matches.begin(), matches.begin() + n, matches.end(),
+                      better);
+}
+
+void Picker::report(const ChunkList& chunks, size_t matched, size_t total,
+                    bool eof) {
+    nlohmann::json items = nlohmann::json::array();
+    for(const Match& m : m_top)
+        items.push_back(std::string{chunks[m.chunk]->line(m.line)});
+
+    {
+        std::lock_guard lock{m_mutex};
+        if(items.empty())
+            m_best.reset();
+        else
+            m_best = items.front().get<std::string>();
+    }
+
+    if(items != m_shown) {
+        m_shown = items;
+        m_updates->push(
+            UpdateQueue::Update{{}, "results", "items", std::move(items)});
+    }
+
+    std::string count = fmt::format("{}/{}", matched, total);
+    if(!eof)
+        count += " (reading)";
+
+    if(count != m_count) {
+        m_count = count;
+        m_updates->push(UpdateQueue::Update{{}, "count", "text", count});
+    }
+
+    m_done = eof;
+}
+
+types::Window pick_window(const std::string& title) {
+    types::Widget query{"input"};
+    query.id = "query";
+    query.properties["placeholder"] = "Search";
+
+    types::Widget results{"list"};
+    results.id = "results";
+    results.fill = true;
+
+    types::Widget count{"text"};
+    count.id = "count";
+
+    types::Widget cancel{"button"};
+    cancel.id = "cancel";
+    cancel.text = "Cancel";
+
+    types::Widget ok{"button"};
+    ok.id = "ok";
+    ok.text = "OK";
+
+    types::Widget buttons{"row"};
+    buttons.items = {count, types::Widget{"space"}, cancel, ok};
+
+    types::Window window;
+    window.type = "window";
+    window.title = title;
+    window.width = 600;
+    window.height = 400;
+    window.body = types::Widget{"column"};
+    window.body.items = {query, results, buttons};
+    return window;
+}
+
+void read_candidates(int fd, std::shared_ptr<Picker> picker) {
+    std::thread{[fd, picker = std::move(picker)]() {
+        std::vector<char> buf(PICK_READ_CHUNK);
+
+        for(;;) {
+            long n = read_chunk(fd, buf.data(), buf.size());
+            if(n <= 0)
+                break;
+
+            picker->feed(std::string_view{buf.data(), static_cast<size_t>(n)});
+        }
+
+        picker->finish();
+    }}.detach(); // Blocked in read() until EOF
+}
+
+} // namespace tanto
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "types.h"
+#include "updates.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace tanto {
+
+constexpr size_t PICK_RESULTS = 100;    // Rows shown
+constexpr size_t PICK_LINE_MAX = 4096; // Longer candidates are truncated
+
+// A bit per character class of 's' (letters folded): lines missing one of
+// the query's bits cannot match it
+[[nodiscard]] uint64_t char_mask(std::string_view s);
+
+// fzf-style: the characters of 'query' must appear in 'text' in order,
+// ignoring case unless 'query' has uppercase letters. Matches at word starts
+// and in a row score more, gaps less; std::nullopt if 'text' doesn't match.
+[[nodiscard]] std::optional<int> fuzzy_score(std::string_view text,
+                                             std::string_view query);
+
+// Ranks candidate lines against a query while they're still arriving.
+// A matcher thread scores them on the worker pool and reports the best ones
+// to pick_window() as "results" items and "count" text updates. A longer
+// query only rescans the lines matching the shorter one, new lines are
+// scanned once and merged. Lines are cut at PICK_LINE_MAX bytes, so input
+// without newlines doesn't grow m_partial.
+class Picker {
+private:
+    struct Chunk { // Lines of one read, immutable once added
+        std::string text;
+        std::vector<uint32_t> ends;  // Past the last character of each line
+        std::vector<uint64_t> masks; // char_mask() of each line
+
+        [[nodiscard]] std::string_view line(size_t i) const;
+    };
+
+    using ChunkList = std::vector<std::shared_ptr<const Chunk>>;
+
+    struct Match {
+        int score;
+        uint32_t chunk, line;
+    };
+
+public:
+    explicit Picker(std::shared_ptr<UpdateQueue> updates);
+    ~Picker();
+    void feed(std::string_view data); // From a single reader thread
+    void finish();                    // At EOF
+    void set_query(std::string query);
+
+    // The first result, chosen when no row is selected
+    [[nodiscard]] std::optional<std::string> best();
+
+private:
+    void run();
+    void rank(const ChunkList& chunks, const std::string& query, size_t total,
+              bool eof, size_t generation);
+    bool scan(const ChunkList& chunks, size_t first,
+              const std::string& query, std::vector<Match>& res,
+              size_t generation) const;
+    bool rescan(const ChunkList& chunks, const std::string& query,
+                std::vector<Match>& res, size_t generation) const;
+    void sort_top(const ChunkList& chunks, std::vector<Match>& matches) const;
+    void report(const ChunkList& chunks, size_t matched, size_t total,
+                bool eof);
+    void add_chunk(Chunk&& chunk);
+    void keep_partial(std::string_view data);
+
+private:
+    std::shared_ptr<UpdateQueue> m_updates;
+    std::string m_partial; // Incomplete line from the previous read
+
+    // Shared with the matcher thread
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    ChunkList m_chunks;
+    size_t m_total{0};
+    std::string m_query;
+    std::optional<std::string> m_best;
+    std::atomic<size_t> m_generation{0}; // Bumped by each query
+    bool m_eof{false}, m_stopped{false};
+
+    // Matcher thread only
+    std::string m_matched; // Query of m_matches
+    std::vector<Match> m_matches, m_top;
+    size_t m_scanned{0}; // Chunks in m_matches
+    nlohmann::json m_shown;
+    std::string m_count;
+    bool m_done{false}; // EOF reported
+
+    std::thread m_thread;
+};
+
+// "query" filters the "results" list, "count" shows matches/lines,
+// "ok" and "cancel" close it
+types::Window pick_window(const std::string& title);
+
+// Feeds 'picker' with the lines of 'fd' on a separate thread
+void read_candidates(int fd, std::shared_ptr<Picker> picker);
+
+} // namespace tanto
@@ -0,0 +1,293 @@
+#include "progress.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <fmt/core.h>
+#include <thread>
+
+#if defined(__unix__)
+    #include <poll.h>
+    #include <unistd.h>
+#elif defined(_WIN32)
+    #include <io.h>
+#endif
+
+namespace tanto {
+
+namespace {
+
+constexpr size_t PROGRESS_READ_CHUNK = 64 * 1024;
+constexpr auto PROGRESS_REPORT_INTERVAL = std::chrono::milliseconds{100};
+constexpr double PROGRESS_RATE_SMOOTHING = 0.3;
+
+[[nodiscard]] std::string_view trim(std::string_view s) {
+    size_t start = s.find_first_not_of(" \t\r");
+    if(start == std::string_view::npos)
+        return {};
+
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(start, end - start + 1);
+}
+
+[[nodiscard]] std::string format_count(double n) {
+    if(n >= 1e6)
+        return fmt::format("{:.1f}M", n / 1e6);
+    if(n >= 1e3)
+        return fmt::format("{:.1f}k", n / 1e3);
+    return fmt::format("{:.0f}", n);
+}
+
+[[nodiscard]] std::string format_duration(double secs) {
+    auto s = static_cast<long long>(secs + 0.5);
+    if(s >= 3600)
+        return fmt::format("{}:{:02}:{:02}", s / 3600, s / 60 % 60, s % 60);
+    return fmt::format("{}:{:02}", s / 60, s % 60);
+}
+
+// False if nothing arrived in 'timeout', so the caller can report a stall
+[[nodiscard]] bool wait_readable(int fd, std::chrono::milliseconds timeout) {
+#if defined(__unix__)
+    pollfd p{fd, POLLIN, 0};
+    int n = 0;
+
+    do
+        n = ::poll(&p, 1, static_cast<int>(timeout.count()));
+    while(n < 0 && errno == EINTR);
+
+    return n != 0; // Errors are left to read()
+#else
+    (void)fd; // Pipes can't be polled: blocks in read()
+    (void)timeout;
+    return true;
+#endif
+}
+
+} // namespace
+
+long read_chunk(int fd, char* buf, size_t size) {
+    for(;;) {
+#if defined(__unix__)
+        ssize_t n = ::read(fd, buf, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+#elif defined(_WIN32)
+        int n = ::_read(fd, buf, static_cast<unsigned int>(size));
+#endif
+        return static_cast<long>(n);
+    }
+}
+
+void ProgressParser::feed(std::string_view data) {
+    this->count_lines(data);
+
+    size_t last = data.find_last_of("\r\n");
+    if(last == std::string_view::npos) {
+        this->keep_partial(data);
+        return;
+    }
+
+    bool haspercent = false, hasstatus = false;
+    std::string_view complete = data.substr(0, last);
+    size_t end = complete.size();
+
+    // Newest lines first, the first one is completed by m_partial
+    while(!haspercent || !hasstatus) {
+        size_t nl = std::string_view::npos;
+        if(end)
+            nl = complete.find_last_of("\r\n", end - 1);
+
+        if(nl == std::string_view::npos) {
+            this->keep_partial(complete.substr(0, end));
+            if(!m_overlong)
+                this->parse_line(m_partial, haspercent, hasstatus);
+            break;
+        }
+
+        this->parse_line(complete.substr(nl + 1, end - nl - 1), haspercent,
+                         hasstatus);
+        end = nl;
+    }
+
+    m_partial.clear();
+    m_overlong = false;
+    this->keep_partial(data.substr(last + 1));
+}
+
+// A stream without line ends (binary data, a wrong separator) mustn't grow
+// m_partial: what's too long to be ours is dropped until the next line end
+void ProgressParser::keep_partial(std::string_view data) {
+    if(m_overlong)
+        return;
+
+    if(m_partial.size() + data.size() > PROGRESS_LINE_MAX) {
+        m_partial.clear();
+        m_overlong = true;
+        return;
+    }
+
+    m_partial.append(data);
+}
+
+// "\r\n" is one line end, even when split between chunks
+void ProgressParser::count_lines(std::string_view data) {
+    if(data.empty())
+        return;
+
+    size_t n = std::count(data.begin(), data.end(), '\n');
+    if(m_cr && data.front() == '\n')
+        n--;
+
+    for(size_t cr = data.find('\r'); cr != std::string_view::npos;
+        cr = data.find('\r', cr + 1)) {
+        if(cr + 1 == data.size() || data[cr + 1] != '\n')
+            n++;
+    }
+
+    m_lines += n;
+    m_cr = data.back() == '\r';
+}
+
+void ProgressParser::finish() {
+    bool haspercent = false, hasstatus = false;
+    if(!m_partial.empty())
+        this->parse_line(m_partial, haspercent, hasstatus);
+    m_partial.clear();
+}
+
+bool ProgressParser::parse_line(std::string_view line, bool& haspercent,
+                                bool& hasstatus) {
+    line = trim(line);
+    if(line.empty() || line.size() > PROGRESS_LINE_MAX)
+        return false;
+
+    if(line.front() == '#') {
+        if(!hasstatus)
+            m_status = trim(line.substr(1));
+        hasstatus = true;
+        return true;
+    }
+
+    int percent = 0;
+    auto res = std::from_chars(line.data(), line.data() + line.size(), percent);
+    if(res.ec != std::errc{}) // Not ours, ignore it
+        return false;
+
+    if(!haspercent)
+        m_percent = std::clamp(percent, 0, 100);
+    haspercent = true;
+    return true;
+}
+
+types::Window progress_window(const std::string& title,
+                              const std::string& text) {
+    types::Widget status{"text"};
+    status.id = "status";
+    status.text = text;
+
+    types::Widget progress{"progress"};
+    progress.id = "progress";
+
+    types::Widget cancel{"button"};
+    cancel.id = "cancel";
+    cancel.text = "Cancel";
+
+    types::Widget buttons{"row"};
+    buttons.items = {types::Widget{"space"}, cancel};
+
+    types::Window window;
+    window.type = "window";
+    window.title = title;
+    window.width = 400;
+    window.body = types::Widget{"column"};
+    window.body.items = {status, progress, buttons};
+    return window;
+}
+
+void read_progress(int fd, std::shared_ptr<UpdateQueue> updates,
+                   std::shared_ptr<ProgressOutcome> outcome) {
+    std::thread{[fd, updates = std::move(updates),
+                 outcome = std::move(outcome)]() {
+        using Clock = std::chrono::steady_clock;
+
+        std::array<char, PROGRESS_READ_CHUNK> buf;
+        ProgressParser parser;
+        Clock::time_point start = Clock::now(), lastreport = start;
+        size_t lastlines = 0;
+        std::optional<double> rate; // Unset until the first sample
+        int percent = -1;
+        std::string status, shown;
+
+        auto set = [&](const char* id, const char* property,
+                       nlohmann::json value) {
+            updates->push(
+                UpdateQueue::Update{{}, id, property, std::move(value)});
+        };
+
+        auto report = [&](Clock::time_point now) {
+            double dt = std::chrono::duration<double>(now - lastreport).count();
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            double r = dt > 0 ? (parser.lines() - lastlines) / dt : 0;
+
+            rate = rate ? *rate + PROGRESS_RATE_SMOOTHING * (r - *rate) : r;
+            lastreport = now;
+            lastlines = parser.lines();
+
+            std::string text = fmt::format("{}%  ·  {} lines/s",
+                                           std::max(parser.percent(), 0),
+                                           format_count(*rate));
+
+            if(parser.percent() > 0 && parser.percent() < 100) {
+                double eta =
+                    elapsed * (100 - parser.percent()) / parser.percent();
+                text += "  ·  ETA " + format_duration(eta);
+            }
+
+            if(text != shown) {
+                shown = text;
+                set("progress", "text", std::move(text));
+            }
+        };
+
+        for(;;) {
+            if(!wait_readable(fd, PROGRESS_REPORT_INTERVAL)) { // Stalled
+                report(Clock::now());
+                continue;
+            }
+
+            long n = read_chunk(fd, buf.data(), buf.size());
+            if(n <= 0)
+                break;
+
+            parser.feed(std::string_view{buf.data(), static_cast<size_t>(n)});
+
+            if(parser.percent() != percent) {
+                percent = parser.percent();
+                set("progress", "value", percent);
+            }
+
+            if(parser.status() != status) {
+                status = parser.status();
+                set("status", "text", status);
+            }
+
+            if(Clock::time_point now = Clock::now();
+               now - lastreport >= PROGRESS_REPORT_INTERVAL)
+                report(now);
+        }
+
+        parser.finish();
+        set("progress", "value", std::max(parser.percent(), 0));
+        if(!parser.status().empty())
+            set("status", "text", parser.status());
+
+        if(!outcome->settle(ProgressOutcome::FINISHED))
+            return; // Cancelled, it's closing already
+
+        // No id: it's for the window itself
+        updates->push(UpdateQueue::Update{{}, {}, "close", true});
+    }}.detach(); // Blocked in read() until EOF
+}
+
+} // namespace tanto
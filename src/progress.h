@@ -0,0 +1,74 @@
+#pragma once
+
+#include "types.h"
+#include "updates.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace tanto {
+
+constexpr size_t PROGRESS_LINE_MAX = 4096;
+
+// zenity-style progress: numeric lines are percentages and lines starting
+// with '#' replace the status text. Lines end with '\n', '\r' or both, longer
+// ones than PROGRESS_LINE_MAX are ignored. Chunks are scanned backwards, only
+// the last value of each kind matters.
+class ProgressParser {
+public:
+    void feed(std::string_view data);
+    void finish(); // Parses the trailing line without a newline, if any
+
+    [[nodiscard]] inline size_t lines() const { return m_lines; }
+    [[nodiscard]] inline int percent() const { return m_percent; }
+    [[nodiscard]] inline const std::string& status() const { return m_status; }
+
+private:
+    bool parse_line(std::string_view line, bool& haspercent, bool& hasstatus);
+    void keep_partial(std::string_view data);
+    void count_lines(std::string_view data);
+
+private:
+    std::string m_partial; // Incomplete line from the previous chunk
+    std::string m_status;
+    size_t m_lines{0};
+    int m_percent{-1};
+    bool m_overlong{false}; // m_partial was dropped, skip to the line end
+    bool m_cr{false};       // The previous chunk ended with '\r'
+};
+
+// How a progress dialog ended: EOF and the user's cancel race for it, the
+// first one wins
+class ProgressOutcome {
+public:
+    enum Result { RUNNING = 0, FINISHED, CANCELLED };
+
+    // True if it's 'r' because of this call
+    inline bool settle(Result r) {
+        Result expected = RUNNING;
+        return m_result.compare_exchange_strong(expected, r);
+    }
+
+    [[nodiscard]] inline Result result() const { return m_result; }
+
+private:
+    std::atomic<Result> m_result{RUNNING};
+};
+
+// read() from 'fd', retried when interrupted: 0 at EOF, < 0 on errors
+[[nodiscard]] long read_chunk(int fd, char* buf, size_t size);
+
+// "progress" shows the percentage, "status" the text and "cancel" aborts
+types::Window progress_window(const std::string& title,
+                              const std::string& text);
+
+// Feeds the window built by progress_window() from 'fd' on a separate thread
+// and closes it at EOF, unless it was cancelled first. Throughput and ETA are
+// refreshed while no data arrives too.
+void read_progress(int fd, std::shared_ptr<UpdateQueue> updates,
+                   std::shared_ptr<ProgressOutcome> outcome);
+
+} // namespace tanto
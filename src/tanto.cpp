@@ -1,33 +1,33 @@
 #include "tanto.h"
+#include "bindings.h"
+#include "datasource.h"
+#include "dirlist.h"
 #include "error.h"
+#include "templates.h"
+#include "trace.h"
 #include "utils.h"
+#include "validation.h"
+#include <algorithm>
 #include <cctype>
 #include <charconv>
 #include <cstddef>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <string_view>
+#include <unordered_set>
 
 #if defined(__unix__)
-    #include <curl/curl.h>
+    #include "downloader.h"
     #include <unistd.h>
 #elif defined(_WIN32)
+    #include "workerpool.h"
+    #include <array>
     #include <urlmon.h>
 #endif
 
 namespace {
 
-std::vector<char> g_tmpnamebuffer;
-
-#if defined(__unix__)
-size_t curl_write(void* ptr, size_t size, size_t nmemb, void* userdata) {
-    auto* ofs = reinterpret_cast<std::fstream*>(userdata);
-    size_t nbytes = size * nmemb;
-    ofs->write(reinterpret_cast<char*>(ptr), nbytes);
-    return nbytes;
-}
-#endif
-
 template<typename Function>
 void split_each(std::string_view s, char sep, Function f) {
     size_t i = 0, start = 0;
@@ -54,12 +54,95 @@ void split_each(std::string_view s, char sep, Function f) {
     return ext;
 }
 
+[[nodiscard]] bool is_widget_type(const std::string& type) {
+    using namespace tanto::utils::string_literals;
+
+    switch(tanto::utils::fnv1a_32(type)) {
+        case "space"_fnv1a_32:
+        case "text"_fnv1a_32:
+        case "input"_fnv1a_32:
+        case "number"_fnv1a_32:
+        case "image"_fnv1a_32:
+        case "button"_fnv1a_32:
+        case "check"_fnv1a_32:
+        case "progress"_fnv1a_32:
+        case "log"_fnv1a_32:
+        case "list"_fnv1a_32:
+        case "tree"_fnv1a_32:
+        case "gallery"_fnv1a_32:
+        case "files"_fnv1a_32:
+        case "tabs"_fnv1a_32:
+        case "scroll"_fnv1a_32:
+        case "row"_fnv1a_32:
+        case "column"_fnv1a_32:
+        case "grid"_fnv1a_32:
+        case "form"_fnv1a_32: return true;
+        default: break;
+    }
+
+    return type.empty(); // Skipped
+}
+
+[[nodiscard]] bool is_container(const std::string& type) {
+    return type == "row" || type == "column" || type == "grid" ||
+           type == "form" || type == "tabs" || type == "scroll";
+}
+
+// What Backend::process() would refuse halfway, checked before anything is
+// built. Collects ids and compiles "validate" rules.
+void check_widget(const tanto::types::Widget& w, bool model, bool inrow,
+                  std::unordered_set<std::string>& ids,
+                  tanto::types::Window& window) {
+    if(!is_widget_type(w.type))
+        reject("Unknown widget type: '{}'", w.type);
+
+    const nlohmann::json* rule = tanto::find_rule(w);
+    bool validated = rule != nullptr;
+
+    // Reading stdin/stdout/stderr to EOF would break the protocol
+    if(w.type == "image" && tanto::utils::starts_with(w.text, "fd:") &&
+       !tanto::parse_fd_source(w.text))
+        reject("Invalid image source: '{}' (fd:0-2 are reserved)", w.text);
+
+    if(inrow && (w.type == "log" || w.type == "files" || w.type == "tabs" ||
+                 w.type == "scroll" || validated))
+        reject("'{}' is not supported in scroll rows", w.type);
+
+    if(!w.has_id()) {
+        if(w.type == "files")
+            reject("Files '{}' needs an id", tanto::files_root(w));
+        if(w.type == "log" && w.has_prop("source"))
+            reject("Log '{}' needs an id", w.prop<std::string>("source"));
+        if(validated)
+            reject("Validated '{}' needs an id", w.type);
+    }
+    else if(!ids.insert(w.id).second && model)
+        reject("Duplicate id: '{}'", w.id);
+
+    if(rule)
+        window.rules[w.id] = std::make_shared<const tanto::ValidationRule>(
+            tanto::parse_rule(*rule));
+
+    if(!is_container(w.type)) // List rows aren't widgets
+        return;
+
+    for(const tanto::types::MultiValue& item : w.items) {
+        if(const auto* c = std::get_if<tanto::types::Widget>(&item); c)
+            check_widget(*c, model, inrow || w.type == "scroll", ids, window);
+    }
+}
+
 } // namespace
 
 namespace tanto {
 
 namespace fs = std::filesystem;
 
+bool is_url(const std::string& s) {
+    return utils::starts_with(s, "https://") ||
+           utils::starts_with(s, "http://");
+}
+
 Header parse_header(const types::Widget& w) {
     Header header;
     nlohmann::json rawheader = w.prop<nlohmann::json::array_t>("header");
@@ -96,9 +179,24 @@ std::optional<types::Window> parse(const nlohmann::json& jsonreq) {
 
     if(jsonreq.is_null())
         return std::nullopt;
-    assume(jsonreq.is_object());
+    if(!jsonreq.is_object())
+        reject("Invalid request: '{}'", jsonreq.type_name());
 
-    types::Window window = jsonreq.get<types::Window>();
+    std::optional<types::Window> expanded;
+    types::Window window;
+
+    {
+        // With templates the widgets are built while expanding them
+        trace::Span span{"expand templates", "parse"};
+        expanded = tanto::expand_templates(jsonreq);
+    }
+
+    if(expanded)
+        window = std::move(*expanded);
+    else {
+        trace::Span span{"from_json", "parse"};
+        window = jsonreq.get<types::Window>();
+    }
 
     switch(utils::fnv1a_32(window.type)) {
         case "window"_fnv1a_32:
@@ -106,12 +204,52 @@ std::optional<types::Window> parse(const nlohmann::json& jsonreq) {
             // case "tool"_fnv1a_32:
             break;
 
-        default: except("Invalid type: '{}'", window.type); break;
+        default: reject("Invalid type: '{}'", window.type);
     }
 
+    {
+        trace::Span span{"validate", "parse"};
+        std::unordered_set<std::string> ids;
+        check_widget(window.body, window.model, false, ids, window);
+
+        for(const auto& [id, rule] : window.rules) {
+            if(!rule->equals.empty() && !ids.count(rule->equals))
+                reject("'{}' must equal unknown id '{}'", id, rule->equals);
+        }
+    }
+
+    trace::Span span{"bindings", "parse"};
+    window.bindings = compile_bindings(window);
     return window;
 }
 
+std::vector<types::Window> parse_windows(const nlohmann::json& jsonreq) {
+    std::vector<types::Window> windows;
+
+    if(!jsonreq.is_array()) {
+        if(auto w = tanto::parse(jsonreq); w)
+            windows.push_back(std::move(*w));
+        return windows;
+    }
+
+    windows.reserve(jsonreq.size());
+    std::unordered_set<std::string> ids;
+
+    for(size_t i = 0; i < jsonreq.size(); i++) {
+        auto w = tanto::parse(jsonreq[i]);
+        if(!w)
+            continue;
+
+        if(w->id.empty()) // Events must tell windows apart
+            w->id = std::to_string(i);
+        if(!ids.insert(w->id).second)
+            reject("Duplicate window: '{}'", w->id);
+        windows.push_back(std::move(*w));
+    }
+
+    return windows;
+}
+
 std::optional<std::pair<std::string, int>> parse_font(const std::string& font) {
     if(font.empty())
         return std::nullopt;
@@ -165,39 +303,110 @@ std::optional<std::pair<std::string, int>> parse_font(const std::string& font) {
     return std::make_optional(std::make_pair(name, size));
 }
 
+void download_file(const std::string& url, const DownloadCallback& cb,
+                   const DownloadChunk& chunk) {
+    if(is_data_source(url)) {
+        read_data_source(url, cb);
+        return;
+    }
+
+    if(!is_url(url)) {
+        cb(Download{url, nullptr});
+        return;
+    }
+
+    DownloadCallback done = cb;
+
+    if(trace::enabled()) { // Measure from request to completion
+        int64_t start = trace::now();
+
+        done = [url, cb, start](const Download& d) {
+            trace::complete("download", "io", start,
+                            {{"url", url}, {"ok", d.ok()}});
+            cb(d);
+        };
+    }
+
+#if defined(__unix__)
+    Downloader::instance().fetch(url, done, chunk);
+#elif defined(_WIN32)
+    (void)chunk;
+
+    bool queued = WorkerPool::instance().push([url, done]() {
+        std::array<char, MAX_PATH> tmpdir{}, filepath{};
+        GetTempPathA(tmpdir.size(), tmpdir.data());
+        GetTempFileNameA(tmpdir.data(), "tnt", 0, filepath.data());
+
+        HRESULT hr = URLDownloadToFileA(nullptr, url.c_str(), filepath.data(),
+                                        0, nullptr);
+        done(hr == S_OK ? Download{filepath.data(), nullptr} : Download{});
+    });
+
+    if(!queued) // Pool is stopped, nobody would complete it
+        done(Download{});
+#endif
+}
+
 std::string download_file(const std::string& url) {
-    if(url.empty())
-        return std::string{};
-    if(!utils::starts_with(url, "https://") &&
-       !tanto::utils::starts_with(url, "http://"))
-        return url;
+    std::promise<Download> promise;
+    std::future<Download> res = promise.get_future();
+    download_file(url, [&promise](const Download& d) { promise.set_value(d); });
+
+    Download d = res.get();
+    if(d.filepath.empty() && d.data) // Only in memory, write it down
+        return save_temp(*d.data);
+    return d.filepath;
+}
 
-    g_tmpnamebuffer.resize(TMP_MAX);
-    std::tmpnam(g_tmpnamebuffer.data());
+std::string save_temp(std::string_view data) {
     std::string filepath =
-        (fs::temp_directory_path() / std::string{g_tmpnamebuffer.data()})
-            .string();
+        (fs::temp_directory_path() / "tanto-XXXXXX").string();
 
 #if defined(__unix__)
-    curl_global_init(CURL_GLOBAL_ALL);
-    CURL* curl_handle = curl_easy_init();
-    curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, curl_write);
-
-    std::fstream ofs{filepath, std::ios::out | std::ios::binary};
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &ofs);
-    curl_easy_perform(curl_handle);
-    curl_easy_cleanup(curl_handle);
-    curl_global_init(CURL_GLOBAL_ALL);
-#elif defined(_WIN32)
-    HRESULT hr =
-        URLDownloadToFileA(nullptr, url.c_str(), filepath.c_str(), 0, nullptr);
-    if(hr != S_OK)
+    int fd = ::mkstemp(filepath.data());
+    if(fd == -1)
         return std::string{};
+    ::close(fd);
+#elif defined(_WIN32)
+    std::array<char, MAX_PATH> tmpdir{}, tmpfile{};
+    GetTempPathA(tmpdir.size(), tmpdir.data());
+    GetTempFileNameA(tmpdir.data(), "tnt", 0, tmpfile.data());
+    filepath = tmpfile.data();
 #endif
 
-    return filepath;
+    std::ofstream f{filepath, std::ios::binary | std::ios::trunc};
+    f.write(data.data(), data.size());
+    f.close(); // Flushes: a full disk shows up here
+
+    if(f)
+        return filepath;
+
+    std::error_code ec;
+    fs::remove(filepath, ec); // Don't leave partial files around
+    return std::string{};
+}
+
+std::vector<std::shared_ptr<FdRead>> prefetch(const types::Window& window) {
+    std::vector<std::shared_ptr<FdRead>> fdreads;
+    std::vector<const types::Widget*> stack{&window.body};
+
+    while(!stack.empty()) {
+        const types::Widget* w = stack.back();
+        stack.pop_back();
+
+        // Descriptors are drained early, so writers don't block on them
+        if(w->type == "image" && utils::starts_with(w->text, "fd:"))
+            fdreads.push_back(read_fd_source(w->text));
+        else if(w->type == "image" && is_url(w->text))
+            download_file(w->text, [](const Download&) {});
+
+        for(const auto& item : w->items) {
+            if(const auto* c = std::get_if<types::Widget>(&item); c)
+                stack.push_back(c);
+        }
+    }
+
+    return fdreads;
 }
 
 std::string stringify(const nlohmann::json& arg) {
@@ -211,4 +420,61 @@ std::string stringify(const nlohmann::json& arg) {
     except("Cannot stringify type: '{}'", arg.type_name());
 }
 
+nlohmann::json default_value(const types::Widget& arg) {
+    using namespace tanto::utils::string_literals;
+
+    switch(utils::fnv1a_32(arg.type)) {
+        case "input"_fnv1a_32:
+        case "image"_fnv1a_32: return arg.text;
+        case "check"_fnv1a_32: return arg.prop<bool>("checked");
+
+        case "number"_fnv1a_32:
+            return std::clamp(arg.value, arg.prop<int>("min", NUMBER_MIN),
+                              arg.prop<int>("max", NUMBER_MAX));
+
+        case "progress"_fnv1a_32:
+            return std::clamp(arg.value, 0,
+                              arg.prop<int>("max", PROGRESS_MAX));
+
+        case "list"_fnv1a_32:
+        case "tree"_fnv1a_32:
+        case "gallery"_fnv1a_32: break;
+
+        default: return nullptr;
+    }
+
+    // The last "selected" item is the current one
+    const types::Widget* selected = nullptr;
+
+    std::function<void(const types::Widget&)> find =
+        [&](const types::Widget& w) {
+            for(const types::MultiValue& item : w.items) {
+                const auto* a = std::get_if<types::Widget>(&item);
+                if(!a)
+                    continue;
+                if(a->prop<bool>("selected"))
+                    selected = a;
+                if(arg.type == "tree")
+                    find(*a);
+            }
+        };
+
+    find(arg);
+    if(!selected)
+        return nullptr;
+
+    Header header = arg.type == "gallery" ? Header{} : parse_header(arg);
+    if(header.empty())
+        return selected->get_id();
+
+    nlohmann::json row = nlohmann::json::object();
+
+    for(const HeaderItem& h : header) {
+        if(selected->has_prop(h.id))
+            row[h.id] = selected->prop<nlohmann::json>(h.id);
+    }
+
+    return row;
+}
+
 } // namespace tanto
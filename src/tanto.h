@@ -1,6 +1,8 @@
 #pragma once
 
 #include "types.h"
+#include <functional>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <string>
@@ -11,6 +13,9 @@ namespace tanto {
 
 constexpr int NUMBER_MIN = 0;
 constexpr int NUMBER_MAX = 99;
+constexpr int PROGRESS_MAX = 100; // 0 means indeterminate
+constexpr int LOG_MAX_LINES = 10000;
+constexpr int SCROLL_ROW_HEIGHT = 32;
 
 struct HeaderItem {
     std::string id;
@@ -30,11 +35,36 @@ struct Filter {
 
 using FilterList = std::vector<Filter>;
 
+class FdRead;
+
+struct Download {
+    std::string filepath;                    // Empty if it's in memory only
+    std::shared_ptr<const std::string> data; // Body, when not on disk
+
+    [[nodiscard]] inline bool ok() const { return !filepath.empty() || data; }
+};
+
+using DownloadCallback = std::function<void(const Download&)>;
+using DownloadChunk = std::function<void(std::string_view)>;
+
 Header parse_header(const types::Widget& w);
 FilterList parse_filter(std::string_view filter);
 std::optional<types::Window> parse(const nlohmann::json& jsonreq);
+std::vector<types::Window> parse_windows(const nlohmann::json& jsonreq);
+// Sources fetched over the network (and cached by HttpCache)
+bool is_url(const std::string& s);
 std::optional<std::pair<std::string, int>> parse_font(const std::string& font);
+void download_file(const std::string& url, const DownloadCallback& cb,
+                   const DownloadChunk& chunk = {});
 std::string download_file(const std::string& url);
+std::string save_temp(std::string_view data);
+// Starts the window's downloads; its "fd:N" images are read once, their
+// bodies last as long as the returned reads
+[[nodiscard]] std::vector<std::shared_ptr<FdRead>>
+prefetch(const types::Window& window);
 std::string stringify(const nlohmann::json& arg);
 
+// What get_model_data() reports for a widget that was never built
+nlohmann::json default_value(const types::Widget& arg);
+
 } // namespace tanto
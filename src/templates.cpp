@@ -0,0 +1,307 @@
+#include "templates.h"
+#include "error.h"
+#include "tanto.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tanto {
+
+namespace {
+
+constexpr size_t TEMPLATE_MAX_DEPTH = 32;
+
+[[nodiscard]] bool has_templates(const nlohmann::json& w) {
+    if(!w.is_object())
+        return false;
+    if(w.contains("use") || w.contains("repeat"))
+        return true;
+
+    auto it = w.find("items");
+    if(it == w.end() || !it->is_array())
+        return false;
+
+    for(const nlohmann::json& item : *it) {
+        if(has_templates(item))
+            return true;
+    }
+
+    return false;
+}
+
+// Builds widgets straight from the templates: an instance is converted once
+// for each distinct set of the arguments its template references, the
+// others are copies
+class TemplateExpander {
+public:
+    explicit TemplateExpander(const nlohmann::json& defines)
+        : m_defines{defines} {}
+
+    types::Widget expand_body(const nlohmann::json& body) {
+        if(body.is_object() && body.contains("repeat"))
+            reject("'repeat' is only allowed in 'items'");
+
+        return this->build(body, nlohmann::json::object());
+    }
+
+private:
+    // Builds 'w' (with 'params' in scope) into 'out', repeat adds several
+    void build_item(const nlohmann::json& w, const nlohmann::json& params,
+                    types::MultiValueList& out) {
+        if(!w.is_object()) { // Strings, or whatever a parameter holds
+            types::MultiValueList items = types::items_from_json(
+                nlohmann::json::array({this->substitute(w, params)}));
+            out.push_back(std::move(items.front()));
+            return;
+        }
+
+        if(!w.contains("repeat")) {
+            out.emplace_back(this->build(w, params));
+            return;
+        }
+
+        nlohmann::json repeat = this->substitute(w["repeat"], params);
+        if(!repeat.is_array())
+            reject("'repeat' must be an array");
+
+        nlohmann::json item = w;
+        item.erase("repeat");
+        out.reserve(out.size() + repeat.size());
+
+        for(size_t i = 0; i < repeat.size(); i++) {
+            nlohmann::json p = params;
+            p["index"] = i;
+            p["item"] = repeat[i];
+
+            if(repeat[i].is_object()) // Its keys are parameters too
+                p.update(repeat[i]);
+
+            out.emplace_back(this->build(item, p));
+        }
+    }
+
+    types::Widget build(const nlohmann::json& w,
+                        const nlohmann::json& params) {
+        if(!w.is_object())
+            return this->substitute(w, params).get<types::Widget>();
+
+        if(w.contains("use"))
+            return this->instantiate(w, params);
+
+        nlohmann::json fields = nlohmann::json::object();
+        const nlohmann::json* items = nullptr;
+
+        for(const auto& [k, v] : w.items()) {
+            if(k == "items" && v.is_array())
+                items = &v;
+            else
+                fields[k] = this->substitute(v, params);
+        }
+
+        auto res = fields.get<types::Widget>();
+
+        if(items) {
+            res.items.reserve(items->size());
+            for(const nlohmann::json& item : *items)
+                this->build_item(item, params, res.items);
+        }
+
+        return res;
+    }
+
+    types::Widget instantiate(const nlohmann::json& w,
+                              const nlohmann::json& params) {
+        auto name = w["use"].get<std::string>();
+        auto def = m_defines.find(name);
+        if(def == m_defines.end())
+            reject("Template '{}' not found", name);
+        if(!def->is_object())
+            reject("Template '{}' must be a widget", name);
+
+        nlohmann::json args = params;
+        if(w.contains("with"))
+            args.update(this->substitute(w["with"], params));
+
+        // "${index}" and the like only tell instances apart when they're used
+        nlohmann::json key = {name, nlohmann::json::object()};
+        for(const std::string& ref : this->references(name)) {
+            if(auto it = args.find(ref); it != args.end())
+                key[1][ref] = *it;
+        }
+
+        types::Widget res;
+        std::string instance = key.dump();
+
+        if(auto it = m_instances.find(instance); it != m_instances.end())
+            res = it->second;
+        else {
+            if(m_depth >= TEMPLATE_MAX_DEPTH)
+                reject("Template '{}' is nested too deeply", name);
+
+            m_depth++;
+            res = this->build(*def, args);
+            m_depth--;
+            m_instances.emplace(std::move(instance), res);
+        }
+
+        nlohmann::json overrides = nlohmann::json::object();
+        for(const auto& [k, v] : w.items()) { // The instance wins
+            if(k != "use" && k != "with")
+                overrides[k] = this->substitute(v, params);
+        }
+
+        if(overrides.empty())
+            return res;
+
+        // from_json() keeps the fields 'overrides' doesn't have, but items
+        types::MultiValueList items = std::move(res.items);
+        from_json(overrides, res);
+        if(!overrides.contains("items"))
+            res.items = std::move(items);
+        return res;
+    }
+
+    // Parameters "${name}" used by a template, its nested ones included
+    const std::unordered_set<std::string>& references(const std::string& name) {
+        auto it = m_references.find(name);
+
+        if(it == m_references.end()) {
+            std::unordered_set<std::string> res, visited;
+            this->collect_template(name, visited, res);
+            it = m_references.emplace(name, std::move(res)).first;
+        }
+
+        return it->second;
+    }
+
+    void collect_template(const std::string& name,
+                          std::unordered_set<std::string>& visited,
+                          std::unordered_set<std::string>& res) const {
+        auto def = m_defines.find(name);
+        if(def != m_defines.end() && visited.insert(name).second)
+            this->collect_references(*def, visited, res);
+    }
+
+    void collect_references(const nlohmann::json& v,
+                            std::unordered_set<std::string>& visited,
+                            std::unordered_set<std::string>& res) const {
+        if(v.is_string()) {
+            const auto& s = v.get_ref<const std::string&>();
+
+            for(size_t start = s.find("${"); start != std::string::npos;
+                start = s.find("${", start + 2)) {
+                size_t end = s.find('}', start);
+                if(end == std::string::npos)
+                    break;
+                res.insert(s.substr(start + 2, end - start - 2));
+            }
+
+            return;
+        }
+
+        if(v.is_object()) {
+            if(auto it = v.find("use"); it != v.end() && it->is_string())
+                this->collect_template(it->get<std::string>(), visited, res);
+        }
+
+        for(const nlohmann::json& item : v) // Nothing for other primitives
+            this->collect_references(item, visited, res);
+    }
+
+    nlohmann::json substitute(const nlohmann::json& v,
+                              const nlohmann::json& params) const {
+        if(v.is_string())
+            return this->substitute(v.get_ref<const std::string&>(), params);
+
+        if(!v.is_structured())
+            return v;
+
+        nlohmann::json res = v;
+        for(auto& item : res)
+            item = this->substitute(item, params);
+        return res;
+    }
+
+    nlohmann::json substitute(const std::string& s,
+                              const nlohmann::json& params) const {
+        size_t start = s.find("${");
+        if(start == std::string::npos)
+            return s;
+
+        size_t end = s.find('}', start);
+        if(end == std::string::npos)
+            return s;
+
+        if(start == 0 && end == s.size() - 1) { // Keeps the parameter's type
+            const nlohmann::json* p = this->param(s.substr(2, end - 2), params);
+            return p ? *p : nlohmann::json(s);
+        }
+
+        std::string res;
+
+        for(size_t pos = 0;;) {
+            start = s.find("${", pos);
+            end = start == std::string::npos ? start : s.find('}', start);
+
+            if(end == std::string::npos) {
+                res.append(s, pos);
+                break;
+            }
+
+            res.append(s, pos, start - pos);
+
+            if(const nlohmann::json* p =
+                   this->param(s.substr(start + 2, end - start - 2), params);
+               p)
+                res += tanto::stringify(*p);
+            else
+                res.append(s, start, end - start + 1);
+
+            pos = end + 1;
+        }
+
+        return res;
+    }
+
+    // Unknown parameters are left as they are, like literal text
+    [[nodiscard]] const nlohmann::json*
+    param(const std::string& name, const nlohmann::json& params) const {
+        auto it = params.find(name);
+        return it != params.end() ? &*it : nullptr;
+    }
+
+private:
+    const nlohmann::json& m_defines;
+    std::unordered_map<std::string, types::Widget> m_instances;
+    std::unordered_map<std::string, std::unordered_set<std::string>>
+        m_references;
+    size_t m_depth{0}; // Of nested instances
+};
+
+} // namespace
+
+std::optional<types::Window> expand_templates(const nlohmann::json& window) {
+    if(!window.is_object())
+        return std::nullopt;
+
+    auto body = window.find("body");
+    bool hasdefines = window.contains("define");
+
+    if(!hasdefines && (body == window.end() || !has_templates(*body)))
+        return std::nullopt;
+
+    static const nlohmann::json NODEFINES = nlohmann::json::object();
+    TemplateExpander expander{hasdefines ? window["define"] : NODEFINES};
+
+    nlohmann::json fields = window;
+    fields.erase("define");
+    fields.erase("body");
+
+    auto res = fields.get<types::Window>();
+    if(body != window.end())
+        res.body = expander.expand_body(*body);
+    return res;
+}
+
+} // namespace tanto
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "types.h"
+#include <nlohmann/json.hpp>
+#include <optional>
+
+namespace tanto {
+
+// Expands the templates of a window's JSON:
+//   "define": {"<name>": <widget>}             At window level
+//   {"use": "<name>", "with": {<params>}}      Instance, other keys override
+//   {..., "repeat": [<params>, ...]}           One item per element
+// "${param}" is replaced by the parameter's value (keeping its type when
+// it's the whole string), repeated items also get "${index}" and "${item}".
+// Unknown parameters are left as they are. Instances with the same
+// arguments are converted once and copied.
+// Returns nullopt when there's nothing to expand.
+std::optional<types::Window> expand_templates(const nlohmann::json& window);
+
+} // namespace tanto
@@ -0,0 +1,91 @@
+#include "thumbnails.h"
+#include "datasource.h"
+#include "tanto.h"
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+[[nodiscard]] std::string thumbnail_dir() {
+    fs::path dir;
+
+    if(const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        dir = fs::path{xdg} / "thumbnails" / "normal";
+    else if(const char* home = std::getenv("HOME"); home && *home)
+        dir = fs::path{home} / ".cache" / "thumbnails" / "normal";
+    else
+        return std::string{};
+
+    std::error_code ec;
+    if(fs::create_directories(dir, ec)) // The spec wants it private
+        fs::permissions(dir, fs::perms::owner_all, ec);
+
+    if(ec) {
+        spdlog::warn("Thumbnail store disabled: cannot use '{}'", dir.string());
+        return std::string{};
+    }
+
+    return dir.string();
+}
+
+} // namespace
+
+namespace tanto {
+
+std::string thumbnail_uri(const std::string& source) {
+    if(is_url(source))
+        return source;
+    if(is_data_source(source)) // No stable URI, don't store them
+        return std::string{};
+
+    std::error_code ec;
+    std::string path = fs::absolute(source, ec).lexically_normal().string();
+    if(ec)
+        return std::string{};
+
+    // Same escaping as g_filename_to_uri(), other thumbnailers hash this
+    std::string uri = "file://";
+
+    for(unsigned char c : path) {
+        if(std::isalnum(c) || std::string_view{"-._~!$&'()*+,;=:@/"}.find(
+                                  c) != std::string_view::npos)
+            uri.push_back(c);
+        else
+            uri += fmt::format("%{:02X}", c);
+    }
+
+    return uri;
+}
+
+std::string thumbnail_path(const std::string& md5) {
+    static const std::string DIR = thumbnail_dir();
+    if(DIR.empty())
+        return std::string{};
+    return (fs::path{DIR} / (md5 + ".png")).string();
+}
+
+int64_t thumbnail_mtime(const std::string& source) {
+    if(is_url(source))
+        return 0;
+
+#if defined(_WIN32)
+    struct _stat64 st {};
+    if(::_stat64(source.c_str(), &st) == -1)
+        return 0;
+#else
+    struct stat st {};
+    if(::stat(source.c_str(), &st) == -1)
+        return 0;
+#endif
+
+    return st.st_mtime; // Unix time, as the spec wants
+}
+
+} // namespace tanto
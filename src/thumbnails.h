@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace tanto {
+
+constexpr int THUMBNAIL_SIZE = 128; // "normal" size
+
+// freedesktop.org thumbnail store: thumbnails live in
+// $XDG_CACHE_HOME/thumbnails/normal/<md5 of URI>.png and are valid while
+// their "Thumb::MTime" matches the source file, or for remote sources the
+// body HttpCache has for them.
+std::string thumbnail_uri(const std::string& source);
+std::string thumbnail_path(const std::string& md5);
+int64_t thumbnail_mtime(const std::string& source);
+
+} // namespace tanto
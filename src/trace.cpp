@@ -0,0 +1,130 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace tanto::trace {
+
+std::atomic<bool> g_enabled{false};
+
+namespace {
+
+struct Event {
+    std::string name, cat;
+    char phase;
+    int64_t ts, dur;
+    unsigned int tid;
+    nlohmann::json args;
+};
+
+// Buffered events, written out when there are this many of them: long
+// lived dialogs keep tracing in bounded memory
+constexpr size_t TRACE_CHUNK_EVENTS = 4096;
+
+std::chrono::steady_clock::time_point g_origin;
+std::ofstream g_file;
+size_t g_written{0};
+std::vector<Event> g_events;
+std::mutex g_mutex;
+
+unsigned int thread_id() {
+    static std::atomic<unsigned int> nextid{1};
+    thread_local unsigned int tid = nextid++;
+    return tid;
+}
+
+// Appends the buffered events to "traceEvents", with g_mutex locked
+void write_events() {
+    for(const Event& e : g_events) {
+        nlohmann::json ev = {
+            {"name", e.name}, {"cat", e.cat}, {"ph", std::string(1, e.phase)},
+            {"ts", e.ts},     {"pid", 1},     {"tid", e.tid},
+        };
+
+        if(e.phase == 'X')
+            ev["dur"] = e.dur;
+        else
+            ev["s"] = "t"; // Instant events are thread scoped
+
+        if(!e.args.is_null())
+            ev["args"] = e.args;
+
+        if(g_written++ > 0)
+            g_file << ",\n";
+        g_file << ev;
+    }
+
+    g_file.flush();
+    g_events.clear();
+}
+
+void record(Event e) {
+    std::lock_guard lock{g_mutex};
+    if(!g_file.is_open()) // Raced with flush()
+        return;
+
+    g_events.push_back(std::move(e));
+    if(g_events.size() >= TRACE_CHUNK_EVENTS)
+        write_events();
+}
+
+} // namespace
+
+bool start(const std::string& filepath) {
+    {
+        std::lock_guard lock{g_mutex};
+        g_file.open(filepath, std::ios::trunc);
+        if(!g_file)
+            return false;
+
+        g_file << R"({"displayTimeUnit":"ms","traceEvents":[)" << '\n';
+        g_written = 0;
+    }
+
+    g_origin = std::chrono::steady_clock::now();
+    thread_id(); // The calling thread is the first one
+    g_events.reserve(TRACE_CHUNK_EVENTS);
+
+    if(!g_enabled.exchange(true))
+        std::atexit(trace::flush);
+    return true;
+}
+
+void flush() {
+    if(!g_enabled.exchange(false))
+        return;
+
+    std::lock_guard lock{g_mutex};
+    write_events();
+    g_file << "\n]}\n";
+    g_file.close();
+}
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - g_origin)
+        .count();
+}
+
+void complete(std::string_view name, std::string_view cat, int64_t start,
+              nlohmann::json args) {
+    if(!trace::enabled())
+        return;
+
+    int64_t ts = trace::now();
+    record(Event{std::string{name}, std::string{cat}, 'X', start, ts - start,
+                 thread_id(), std::move(args)});
+}
+
+void instant(std::string_view name, std::string_view cat,
+             nlohmann::json args) {
+    if(!trace::enabled())
+        return;
+
+    record(Event{std::string{name}, std::string{cat}, 'i', trace::now(), 0,
+                 thread_id(), std::move(args)});
+}
+
+} // namespace tanto::trace
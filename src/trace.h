@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+
+// Chrome trace-event recorder, open the output in 'chrome://tracing' or
+// 'ui.perfetto.dev'. When it's off every call is a single relaxed load.
+namespace tanto::trace {
+
+extern std::atomic<bool> g_enabled;
+
+[[nodiscard]] inline bool enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+// Starts recording, events are appended to 'filepath' in chunks
+bool start(const std::string& filepath);
+void flush(); // Writes what's left and completes the file, at exit
+
+[[nodiscard]] int64_t now(); // Microseconds since start()
+void complete(std::string_view name, std::string_view cat, int64_t start,
+              nlohmann::json args = {});
+void instant(std::string_view name, std::string_view cat,
+             nlohmann::json args = {});
+
+class Span {
+public:
+    explicit Span(std::string_view name, std::string_view cat = "tanto")
+        : m_name{name}, m_cat{cat} {
+        if(trace::enabled())
+            m_start = trace::now();
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    ~Span() {
+        if(m_start >= 0)
+            trace::complete(m_name, m_cat, m_start, std::move(m_args));
+    }
+
+    inline Span& arg(const char* key, std::string_view value) {
+        if(m_start >= 0)
+            m_args[key] = value;
+        return *this;
+    }
+
+private:
+    std::string_view m_name, m_cat;
+    nlohmann::json m_args;
+    int64_t m_start{-1};
+};
+
+} // namespace tanto::trace
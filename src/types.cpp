@@ -70,17 +70,26 @@ void from_json(const nlohmann::json& j, Widget& w) {
         w.properties[k] = v;
     }
 
-    for(const auto& c : j.value("items", nlohmann::json::array_t{})) {
+    w.items = items_from_json(j.value("items", nlohmann::json::array_t{}));
+}
+
+MultiValueList items_from_json(const nlohmann::json& items) {
+    MultiValueList res;
+    res.reserve(items.size());
+
+    for(const auto& c : items) {
         if(c.is_object()) {
             Widget obj;
             tanto::types::from_json(c, obj);
-            w.items.emplace_back(obj);
+            res.emplace_back(obj);
         }
         else if(c.is_string())
-            w.items.emplace_back(c.get<std::string>());
+            res.emplace_back(c.get<std::string>());
         else
-            except("Type {} is not supported", c.type_name());
+            reject("Type {} is not supported", c.type_name());
     }
+
+    return res;
 }
 
 } // namespace tanto::types
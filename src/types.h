@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <type_traits>
@@ -9,6 +10,11 @@
 #include <variant>
 #include <vector>
 
+namespace tanto {
+class BindingGraph;
+struct ValidationRule;
+} // namespace tanto
+
 namespace tanto::types {
 
 struct Widget;
@@ -21,6 +27,7 @@ struct Widget {
     // Base
     bool enabled{true}, fill{false};
     std::string id, type, title, group;
+    std::string window; // Owner window id, set by Backend (not serialized)
 
     // Values
     std::string text;
@@ -60,14 +67,24 @@ struct Widget {
 };
 
 struct Window {
-    std::string type, title, font;
+    std::string id, type, title, font;
     int x{}, y{}, width{}, height{};
     bool fixed{false}, model{false};
     Widget body;
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Window, type, title, font, x, y,
-                                                width, height, fixed, model,
-                                                body)
+    // Compiled "enabled_if"/"visible_if", set by tanto::parse (not serialized)
+    std::shared_ptr<const BindingGraph> bindings;
+
+    // Compiled "validate" rules by id, set by tanto::parse (not serialized)
+    std::unordered_map<std::string, std::shared_ptr<const ValidationRule>>
+        rules;
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Window, id, type, title, font,
+                                                x, y, width, height, fixed,
+                                                model, body)
 };
 
+// "items" of a widget: strings and widget objects
+MultiValueList items_from_json(const nlohmann::json& items);
+
 } // namespace tanto::types
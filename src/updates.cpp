@@ -0,0 +1,139 @@
+#include "updates.h"
+#include <spdlog/spdlog.h>
+
+namespace tanto {
+
+namespace {
+
+void append_text(std::string& s, const std::string& text) {
+    s += text;
+    if(s.size() <= UPDATE_APPEND_MAX)
+        return;
+
+    // Older lines are lost anyway, keep whole lines if possible
+    size_t cut = s.find('\n', s.size() - UPDATE_APPEND_MAX);
+    s.erase(0, cut == std::string::npos ? s.size() - UPDATE_APPEND_MAX
+                                        : cut + 1);
+}
+
+// {"<dir>": {"entries": [...], "done": <bool>}} listings of "files" widgets
+void merge_entries(nlohmann::json& pending, const nlohmann::json& value) {
+    for(const auto& [dir, listing] : value.items()) {
+        nlohmann::json& p = pending[dir];
+        if(!p.is_object()) {
+            p = listing;
+            continue;
+        }
+
+        nlohmann::json& entries = p["entries"];
+        for(const nlohmann::json& e : listing["entries"])
+            entries.push_back(e);
+        p["done"] = p.value("done", false) || listing.value("done", false);
+    }
+}
+
+[[nodiscard]] size_t count_entries(const nlohmann::json& value) {
+    size_t n = 0;
+    for(const nlohmann::json& listing : value) { // By directory
+        if(auto it = listing.find("entries"); it != listing.end())
+            n += it->size();
+    }
+    return n;
+}
+
+} // namespace
+
+void UpdateQueue::set_notify(Notify n) {
+    std::lock_guard lock{m_mutex};
+    m_notify = std::move(n);
+}
+
+bool UpdateQueue::empty() {
+    std::lock_guard lock{m_mutex};
+    return m_pending.empty();
+}
+
+UpdateQueue::Stats UpdateQueue::stats() {
+    std::lock_guard lock{m_mutex};
+    return m_stats;
+}
+
+std::vector<UpdateQueue::Update> UpdateQueue::take() {
+    std::vector<Update> updates;
+
+    std::lock_guard lock{m_mutex};
+    updates.swap(m_pending);
+    m_index.clear();
+    m_stats.applied += updates.size();
+    return updates;
+}
+
+void UpdateQueue::push(Update u) {
+    std::lock_guard lock{m_mutex};
+    if(this->enqueue(std::move(u)) && m_notify)
+        m_notify();
+}
+
+void UpdateQueue::push(const nlohmann::json& msg) {
+    if(!msg.is_object()) {
+        spdlog::warn("Invalid update: '{}'", msg.dump());
+        return;
+    }
+
+    std::string id = msg.value("id", std::string{}); // Empty: the window
+    std::string window = msg.value("window", std::string{});
+    bool notify = false;
+
+    std::lock_guard lock{m_mutex};
+
+    for(const auto& [k, v] : msg.items()) {
+        if(k != "id" && k != "window")
+            notify |= this->enqueue(Update{window, id, k, v});
+    }
+
+    if(notify && m_notify)
+        m_notify();
+}
+
+bool UpdateQueue::enqueue(Update u) {
+    std::string key = u.window + '\x1f' + u.id + '\x1f' + u.property;
+    bool wasempty = m_pending.empty();
+    m_stats.received++;
+
+    if(auto it = m_index.find(key); it != m_index.end()) {
+        nlohmann::json& value = m_pending[it->second].value;
+
+        if(u.property == "append" && value.is_string() &&
+           u.value.is_string()) {
+            append_text(value.get_ref<std::string&>(),
+                        u.value.get_ref<const std::string&>());
+            m_stats.merged++;
+            return false;
+        }
+
+        if(u.property == "entries" && value.is_object() &&
+           u.value.is_object()) {
+            if(count_entries(value) + count_entries(u.value) <=
+               UPDATE_ENTRIES_MAX) {
+                merge_entries(value, u.value);
+                m_stats.merged++;
+                return false;
+            }
+
+            // Too large to merge: later batches go to a new update
+            it->second = m_pending.size();
+            m_pending.push_back(std::move(u));
+            return false;
+        }
+
+        value = std::move(u.value); // Coalesced
+        m_stats.dropped++;
+        return false;
+    }
+
+    m_index.emplace(std::move(key), m_pending.size());
+    m_pending.push_back(std::move(u));
+    return wasempty;
+}
+
+} // namespace tanto
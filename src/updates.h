@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tanto {
+
+constexpr size_t UPDATE_APPEND_MAX = 1024 * 1024; // Pending "append" text
+constexpr size_t UPDATE_ENTRIES_MAX = 4096;        // Merged "entries"
+
+// Property updates for live widgets, pushed from any thread and applied by
+// the GUI thread at most once per frame: a property that changes again
+// before being applied keeps only its latest value, except "append" text
+// which is concatenated (and trimmed to its last UPDATE_APPEND_MAX bytes)
+// and "entries" listings, which are merged by directory up to
+// UPDATE_ENTRIES_MAX entries and queued after each other past it.
+class UpdateQueue {
+public:
+    struct Update {
+        std::string window, id, property;
+        nlohmann::json value;
+    };
+
+    struct Stats {
+        size_t received{0}, applied{0};
+        size_t merged{0};  // Into a pending update
+        size_t dropped{0}; // Replaced by a later value
+    };
+
+    using Notify = std::function<void()>;
+
+public:
+    // Called (from the pushing thread) when the queue stops being empty
+    void set_notify(Notify n);
+    [[nodiscard]] bool empty();
+    [[nodiscard]] Stats stats();
+    [[nodiscard]] std::vector<Update> take();
+    void push(Update u);
+
+    // {["id": "...",] ["window": "...",] "<property>": <value>, ...}
+    // Without "id" the properties apply to the window itself
+    void push(const nlohmann::json& msg);
+
+private:
+    bool enqueue(Update u); // Returns true if it was empty
+
+private:
+    std::vector<Update> m_pending;
+    std::unordered_map<std::string, size_t> m_index; // Into m_pending
+    Stats m_stats;
+    Notify m_notify;
+    std::mutex m_mutex;
+};
+
+} // namespace tanto
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cctype>
 #include <cstdint>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -23,6 +27,31 @@ inline bool starts_with(const std::string& s, std::string_view what) {
     return s.find(what) == 0;
 }
 
+// Numbers and numeric strings, surrounding whitespace is allowed
+inline std::optional<double> to_number(const nlohmann::json& value) {
+    if(value.is_number())
+        return value.get<double>();
+    if(!value.is_string())
+        return std::nullopt;
+
+    std::string_view s = value.get_ref<const std::string&>();
+    auto space = [](char c) {
+        return std::isspace(static_cast<unsigned char>(c));
+    };
+
+    while(!s.empty() && space(s.front()))
+        s.remove_prefix(1);
+    while(!s.empty() && space(s.back()))
+        s.remove_suffix(1);
+    if(s.empty())
+        return std::nullopt;
+
+    std::string str{s};
+    char* end = nullptr;
+    double d = std::strtod(str.c_str(), &end);
+    return *end ? std::nullopt : std::optional{d};
+}
+
 constexpr uint32_t fnv1a_32(std::string_view s) {
     uint32_t h = 2166136261U;
 
@@ -34,6 +63,17 @@ constexpr uint32_t fnv1a_32(std::string_view s) {
     return h;
 }
 
+constexpr uint64_t fnv1a_64(std::string_view s) {
+    uint64_t h = 14695981039346656037ULL;
+
+    for(char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
 namespace string_literals {
 
 constexpr uint32_t operator"" _fnv1a_32(const char* s, size_t size) {
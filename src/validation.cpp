@@ -0,0 +1,100 @@
+#include "validation.h"
+#include "error.h"
+#include "utils.h"
+#include <fmt/core.h>
+
+namespace tanto {
+
+namespace {
+
+[[nodiscard]] bool is_empty(const nlohmann::json& value) {
+    if(value.is_null())
+        return true;
+    if(value.is_string())
+        return value.get_ref<const std::string&>().empty();
+    if(value.is_boolean()) // Checks are "filled" when checked
+        return !value.get<bool>();
+    return false;
+}
+
+} // namespace
+
+const nlohmann::json* find_rule(const types::Widget& w) {
+    auto it = w.properties.find("validate");
+    return it != w.properties.end() && it->second.is_object() ? &it->second
+                                                              : nullptr;
+}
+
+ValidationRule parse_rule(const nlohmann::json& rule) {
+    if(!rule.is_object())
+        reject("Invalid validation rule: '{}'", rule.dump());
+
+    auto check = [&](const char* key, bool (nlohmann::json::*is)()
+                                          const noexcept) {
+        auto it = rule.find(key);
+        if(it == rule.end())
+            return false;
+        if(!((*it).*is)())
+            reject("Invalid '{}' in validation rule: '{}'", key, it->dump());
+        return true;
+    };
+
+    ValidationRule r;
+
+    if(check("required", &nlohmann::json::is_boolean))
+        r.required = rule["required"].get<bool>();
+    if(check("equals", &nlohmann::json::is_string))
+        r.equals = rule["equals"].get<std::string>();
+    if(check("message", &nlohmann::json::is_string))
+        r.message = rule["message"].get<std::string>();
+    if(check("min", &nlohmann::json::is_number))
+        r.min = rule["min"].get<double>();
+    if(check("max", &nlohmann::json::is_number))
+        r.max = rule["max"].get<double>();
+
+    if(check("pattern", &nlohmann::json::is_string)) {
+        auto pattern = rule["pattern"].get<std::string>();
+
+        try { // Once per widget, matching happens on each change
+            r.pattern.emplace(pattern, std::regex::ECMAScript |
+                                           std::regex::optimize);
+        }
+        catch(std::regex_error& e) {
+            reject("Invalid pattern '{}': {}", pattern, e.what());
+        }
+    }
+
+    return r;
+}
+
+std::string check_rule(const ValidationRule& rule, const nlohmann::json& value,
+                       const nlohmann::json& other) {
+    auto error = [&](std::string msg) {
+        return rule.message.empty() ? msg : rule.message;
+    };
+
+    if(is_empty(value))
+        return rule.required ? error("Required") : std::string{};
+
+    if(rule.pattern && value.is_string() &&
+       !std::regex_match(value.get_ref<const std::string&>(), *rule.pattern))
+        return error("Invalid format");
+
+    if(rule.min || rule.max) {
+        std::optional<double> n = utils::to_number(value);
+
+        if(!n)
+            return error("Not a number");
+        if(rule.min && *n < *rule.min)
+            return error(fmt::format("Must be at least {}", *rule.min));
+        if(rule.max && *n > *rule.max)
+            return error(fmt::format("Must be at most {}", *rule.max));
+    }
+
+    if(!rule.equals.empty() && value != other)
+        return error("Doesn't match");
+
+    return std::string{};
+}
+
+} // namespace tanto
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <regex>
+#include <string>
+
+namespace tanto {
+
+// "validate": {"required": true, "pattern": "<regex>", "min": 0, "max": 10,
+//              "equals": "<id>", "message": "<error>"}
+// Ranges apply to numbers and to the number written in an input.
+struct ValidationRule {
+    bool required{false};
+    std::optional<std::regex> pattern; // Matches the whole text
+    std::optional<double> min, max;
+    std::string equals; // Same value as another field
+    std::string message;
+};
+
+// The "validate" object of 'w', nullptr if it has none
+[[nodiscard]] const nlohmann::json* find_rule(const types::Widget& w);
+
+// Throws ParseError on bad patterns and values of the wrong type
+ValidationRule parse_rule(const nlohmann::json& rule);
+
+// Returns the error message, empty if 'value' is valid
+std::string check_rule(const ValidationRule& rule, const nlohmann::json& value,
+                       const nlohmann::json& other = {});
+
+} // namespace tanto
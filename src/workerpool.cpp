@@ -0,0 +1,81 @@
+#include "workerpool.h"
+#include <algorithm>
+
+namespace tanto {
+
+WorkerPool::WorkerPool(size_t n)
+    : m_size{n ? n : std::max(2U, std::thread::hardware_concurrency())} {
+    m_threads.reserve(m_size);
+
+    for(size_t i = 0; i < m_size; i++)
+        m_threads.emplace_back([this]() { this->run(); });
+}
+
+WorkerPool::~WorkerPool() { this->stop(); }
+
+WorkerPool& WorkerPool::instance() {
+    static WorkerPool pool;
+    return pool;
+}
+
+bool WorkerPool::push(Task t) {
+    {
+        std::lock_guard lock{m_mutex};
+        if(m_stopped)
+            return false;
+        m_tasks.push_back(std::move(t));
+    }
+
+    m_cond.notify_one();
+    return true;
+}
+
+void WorkerPool::start() {
+    {
+        std::lock_guard lock{m_mutex};
+        if(!m_stopped)
+            return;
+        m_stopped = false;
+    }
+
+    for(size_t i = 0; i < m_size; i++)
+        m_threads.emplace_back([this]() { this->run(); });
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard lock{m_mutex};
+        if(m_stopped)
+            return;
+        m_stopped = true; // Accepted tasks still run: they may own resources
+    }
+
+    m_cond.notify_all();
+
+    for(std::thread& t : m_threads) {
+        if(t.joinable())
+            t.join();
+    }
+
+    m_threads.clear();
+}
+
+void WorkerPool::run() {
+    for(;;) {
+        Task t;
+
+        {
+            std::unique_lock lock{m_mutex};
+            m_cond.wait(lock, [&]() { return m_stopped || !m_tasks.empty(); });
+            if(m_tasks.empty()) // Stopped
+                return;
+
+            t = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        t();
+    }
+}
+
+} // namespace tanto
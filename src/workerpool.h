@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tanto {
+
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+public:
+    explicit WorkerPool(size_t n = 0);
+    ~WorkerPool();
+    // False while stopped: 't' is dropped, callers release what it owns
+    bool push(Task t);
+    void start(); // Again, after stop()
+    void stop();  // Runs the pending tasks first
+    [[nodiscard]] inline size_t size() const { return m_size; }
+    static WorkerPool& instance();
+
+private:
+    void run();
+
+private:
+    size_t m_size;
+    std::vector<std::thread> m_threads;
+    std::deque<Task> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stopped{false};
+};
+
+} // namespace tanto
@@ -0,0 +1,272 @@
+#include "../src/downloader.h"
+#include "../src/httpcache.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// HttpCache and Downloader against a local HTTP server: fresh hits, 304
+// revalidation, expiry and LRU eviction.
+//   tanto_test_httpcache
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr size_t BIG_BODY = 400 * 1024; // TANTO_HTTP_CACHE is 1 MiB
+
+int g_failures = 0;
+
+void check(bool cond, std::string_view what) {
+    std::printf("%s: %.*s\n", cond ? "ok" : "FAIL",
+                static_cast<int>(what.size()), what.data());
+    if(!cond)
+        g_failures++;
+}
+
+// Answers one request per connection: "/<name>?<headers>" picks the
+// response, ETags are "<name>" and match If-None-Match with a 304
+class Server {
+public:
+    Server() {
+        m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        socklen_t len = sizeof(addr);
+        if(::bind(m_fd, reinterpret_cast<sockaddr*>(&addr), len) == -1 ||
+           ::listen(m_fd, 16) == -1 ||
+           ::getsockname(m_fd, reinterpret_cast<sockaddr*>(&addr), &len) ==
+               -1) {
+            std::perror("server");
+            std::exit(2);
+        }
+
+        m_port = ntohs(addr.sin_port);
+        m_thread = std::thread{[this]() { this->run(); }};
+    }
+
+    ~Server() {
+        m_stopped = true;
+        ::shutdown(m_fd, SHUT_RDWR);
+        ::close(m_fd);
+        m_thread.join();
+    }
+
+    [[nodiscard]] std::string url(std::string_view path) const {
+        return fmt::format("http://127.0.0.1:{}{}", m_port, path);
+    }
+
+    [[nodiscard]] int requests(const std::string& name) {
+        std::lock_guard lock{m_mutex};
+        return m_requests[name];
+    }
+
+    [[nodiscard]] int revalidations(const std::string& name) {
+        std::lock_guard lock{m_mutex};
+        return m_revalidations[name];
+    }
+
+private:
+    void run() {
+        while(!m_stopped) {
+            int c = ::accept(m_fd, nullptr, nullptr);
+            if(c == -1)
+                continue;
+
+            this->answer(c);
+            ::close(c);
+        }
+    }
+
+    void answer(int c) {
+        std::string req;
+        char buf[4096];
+
+        while(req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = ::read(c, buf, sizeof(buf));
+            if(n <= 0)
+                return;
+            req.append(buf, static_cast<size_t>(n));
+        }
+
+        // "GET /<name>?<query> HTTP/1.1"
+        size_t start = req.find(' ') + 2;
+        std::string target = req.substr(start, req.find(' ', start) - start);
+        std::string name = target.substr(0, target.find('?'));
+        std::string query = target.find('?') == std::string::npos
+                                ? std::string{}
+                                : target.substr(target.find('?') + 1);
+
+        bool revalidation = req.find("If-None-Match: \"" + name + "\"") !=
+                            std::string::npos;
+
+        {
+            std::lock_guard lock{m_mutex};
+            m_requests[name]++;
+            if(revalidation)
+                m_revalidations[name]++;
+        }
+
+        std::string headers, body;
+
+        if(query == "always304" || revalidation)
+            headers = "HTTP/1.1 304 Not Modified\r\n";
+        else {
+            body = name.substr(0, 3) == "big" ? std::string(BIG_BODY, 'x')
+                                              : "body of " + name;
+            headers = fmt::format("HTTP/1.1 200 OK\r\n"
+                                  "Content-Length: {}\r\n"
+                                  "ETag: \"{}\"\r\n",
+                                  body.size(), name);
+        }
+
+        if(query == "fresh")
+            headers += "Cache-Control: public, max-age=3600\r\n";
+        else if(query == "short")
+            headers += "Cache-Control: max-age=1\r\n";
+        else if(query == "shared") // For shared caches only
+            headers += "Cache-Control: s-maxage=3600\r\n";
+        else if(query == "expires")
+            headers += "Date: Mon, 01 Jan 2024 00:00:00 GMT\r\n"
+                       "Expires: Mon, 01 Jan 2024 01:00:00 GMT\r\n";
+
+        std::string res = headers + "Connection: close\r\n\r\n" + body;
+        for(size_t off = 0; off < res.size();) {
+            ssize_t n = ::write(c, res.data() + off, res.size() - off);
+            if(n <= 0)
+                return;
+            off += static_cast<size_t>(n);
+        }
+    }
+
+private:
+    int m_fd{-1};
+    uint16_t m_port{0};
+    std::atomic<bool> m_stopped{false};
+    std::mutex m_mutex;
+    std::map<std::string, int> m_requests, m_revalidations;
+    std::thread m_thread;
+};
+
+[[nodiscard]] tanto::Download fetch(const std::string& url) {
+    std::promise<tanto::Download> p;
+    tanto::Downloader::instance().fetch(
+        url, [&](const tanto::Download& d) { p.set_value(d); });
+    return p.get_future().get();
+}
+
+[[nodiscard]] std::string read_file(const std::string& filepath) {
+    std::ifstream f{filepath, std::ios::binary | std::ios::ate};
+    if(!f)
+        return std::string{};
+
+    std::string s(static_cast<size_t>(f.tellg()), '\0');
+    f.seekg(0);
+    f.read(s.data(), static_cast<std::streamsize>(s.size()));
+    return s;
+}
+
+} // namespace
+
+int main() {
+    fs::path dir = fs::temp_directory_path() /
+                   fmt::format("tanto-httpcache-{}", ::getpid());
+    fs::create_directories(dir / "tanto");
+    ::setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+    ::setenv("TANTO_HTTP_CACHE", "1", 1);
+
+    // Left by a crashed process
+    fs::path stale = dir / "tanto" / "0123456789abcdef.00000000.part";
+    std::ofstream{stale} << "partial";
+    fs::last_write_time(stale, fs::file_time_type::clock::now() -
+                                   std::chrono::hours{2});
+
+    Server server;
+    tanto::HttpCache& cache = tanto::HttpCache::instance();
+    check(cache.enabled(), "cache enabled");
+
+    // Hit
+    std::string fresh = server.url("/a?fresh");
+    tanto::Download d = fetch(fresh);
+    check(d.ok() && read_file(d.filepath) == "body of a", "download");
+    check(!fs::exists(stale), "stale part removed");
+
+    d = fetch(fresh);
+    check(d.ok() && read_file(d.filepath) == "body of a" &&
+              server.requests("a") == 1,
+          "fresh entry served from cache");
+
+    // Revalidation
+    std::string revalidated = server.url("/b");
+    d = fetch(revalidated);
+    d = fetch(revalidated);
+    check(d.ok() && read_file(d.filepath) == "body of b" &&
+              server.requests("b") == 2 && server.revalidations("b") == 1,
+          "304 keeps the cached body");
+
+    d = fetch(server.url("/c?always304"));
+    check(!d.ok() && !fs::exists(cache.body_path(server.url("/c?always304"))),
+          "304 without a cached entry fails");
+
+    // Expiry
+    std::string expiring = server.url("/e?short");
+    d = fetch(expiring);
+    std::this_thread::sleep_for(std::chrono::milliseconds{2100});
+    d = fetch(expiring);
+    check(d.ok() && server.revalidations("e") == 1, "max-age expires");
+
+    d = fetch(server.url("/s?shared"));
+    d = fetch(server.url("/s?shared"));
+    check(server.requests("s") == 2, "s-maxage is ignored");
+
+    d = fetch(server.url("/x?expires"));
+    d = fetch(server.url("/x?expires"));
+    check(d.ok() && server.requests("x") == 1, "Expires relative to Date");
+
+    // Eviction, least recently used first
+    std::vector<std::string> big;
+    for(int i = 0; i < 3; i++) {
+        big.push_back(server.url(fmt::format("/big{}?fresh", i)));
+        d = fetch(big.back());
+        check(d.ok(), fmt::format("big body {}", i));
+    }
+
+    check(!cache.lookup(big[0]) && !fs::exists(cache.body_path(big[0])),
+          "least recently used body evicted");
+    check(cache.lookup(big[1]) && cache.lookup(big[2]),
+          "recent bodies kept");
+
+    d = fetch(big[0]);
+    check(d.ok() && read_file(d.filepath).size() == BIG_BODY &&
+              server.requests("big0") == 2,
+          "evicted body downloaded again");
+
+    uintmax_t total = 0;
+    bool parts = false;
+    for(const auto& de : fs::directory_iterator{dir / "tanto"}) {
+        total += de.file_size();
+        parts |= de.path().extension() == ".part";
+    }
+    check(total <= 1024 * 1024, "cache within its capacity");
+    check(!parts, "no temporary files left");
+
+    fs::remove_all(dir);
+    return g_failures ? 1 : 0;
+}